@@ -0,0 +1,114 @@
+#include "block_cache.h"
+#include <algorithm>
+
+BlockCache::BlockCache(size_t capacity_bytes, size_t block_size)
+    : capacity_bytes_(capacity_bytes)
+{
+    const size_t capacity_blocks = std::max<size_t>(capacity_bytes / std::max<size_t>(block_size, 1), 1);
+    size_t counter_count = 64;
+    while (counter_count < 8 * capacity_blocks)
+    {
+        counter_count *= 2;
+    }
+    frequencies_.assign(counter_count, 0);
+    sample_size_ = 10 * capacity_blocks;
+}
+
+BlockCache::Block BlockCache::Find(uint64_t block_index)
+{
+    std::lock_guard guard(mutex_);
+    RecordRequest(block_index);
+    const auto entry = entries_.find(block_index);
+    if (entry == entries_.end())
+    {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    recency_.splice(recency_.begin(), recency_, entry->second.position);
+    return entry->second.block;
+}
+
+void BlockCache::Insert(uint64_t block_index, Block block)
+{
+    std::lock_guard guard(mutex_);
+    if (entries_.count(block_index) > 0)
+    {
+        return;
+    }
+    if (block->size() > capacity_bytes_)
+    {
+        ++stats_.rejected;
+        return;
+    }
+    const int frequency = EstimateFrequency(block_index);
+    // victims are only evicted once the new block wins against all of them
+    size_t freed_bytes = 0;
+    size_t victim_count = 0;
+    for (auto victim = recency_.rbegin(); bytes_ - freed_bytes + block->size() > capacity_bytes_; ++victim, ++victim_count)
+    {
+        if (frequency <= EstimateFrequency(*victim))
+        {
+            ++stats_.rejected;
+            return;
+        }
+        freed_bytes += entries_.at(*victim).block->size();
+    }
+    for (; victim_count > 0; --victim_count)
+    {
+        bytes_ -= entries_.at(recency_.back()).block->size();
+        entries_.erase(recency_.back());
+        recency_.pop_back();
+    }
+    bytes_ += block->size();
+    recency_.push_front(block_index);
+    entries_.emplace(block_index, Entry{std::move(block), recency_.begin()});
+}
+
+BlockCacheStats BlockCache::GetStats() const
+{
+    std::lock_guard guard(mutex_);
+    auto stats = stats_;
+    stats.bytes = bytes_;
+    return stats;
+}
+
+size_t BlockCache::GetCounterIndex(uint64_t block_index, int row) const
+{
+    // splitmix64 finalizer with a different seed per row
+    uint64_t hash = block_index + 0x9E3779B97F4A7C15ull * (row + 1);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+    return hash & (frequencies_.size() - 1);
+}
+
+void BlockCache::RecordRequest(uint64_t block_index)
+{
+    for (int row = 0; row < SKETCH_DEPTH; ++row)
+    {
+        auto &counter = frequencies_[GetCounterIndex(block_index, row)];
+        if (counter < 255)
+        {
+            ++counter;
+        }
+    }
+    if (++requests_ >= sample_size_)
+    {
+        for (auto &counter : frequencies_)
+        {
+            counter /= 2;
+        }
+        requests_ = 0;
+    }
+}
+
+int BlockCache::EstimateFrequency(uint64_t block_index) const
+{
+    int frequency = 255;
+    for (int row = 0; row < SKETCH_DEPTH; ++row)
+    {
+        frequency = std::min<int>(frequency, frequencies_[GetCounterIndex(block_index, row)]);
+    }
+    return frequency;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct BlockCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // missed blocks the admission policy did not let in
+    uint64_t rejected = 0;
+    size_t bytes = 0;
+};
+
+// Bounded cache of file blocks with LRU eviction. A missed block only replaces the LRU victim when it was
+// requested more often recently (TinyLFU admission), so a scan of one long list cannot flush the hot blocks
+class BlockCache
+{
+public:
+    using Block = std::shared_ptr<const std::string>;
+
+    BlockCache(size_t capacity_bytes, size_t block_size);
+
+    // nullptr on a miss. Every call counts as a request for the admission policy
+    Block Find(uint64_t block_index);
+
+    void Insert(uint64_t block_index, Block block);
+
+    BlockCacheStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        Block block;
+        std::list<uint64_t>::iterator position;
+    };
+
+    static const int SKETCH_DEPTH = 4;
+
+    const size_t capacity_bytes_;
+    size_t bytes_ = 0;
+    std::list<uint64_t> recency_; // most recent first
+    std::unordered_map<uint64_t, Entry> entries_;
+    // count-min sketch of recent requests, halved every sample_size_ requests so old popularity fades
+    std::vector<uint8_t> frequencies_;
+    uint64_t sample_size_;
+    uint64_t requests_ = 0;
+    BlockCacheStats stats_;
+    mutable std::mutex mutex_;
+
+    size_t GetCounterIndex(uint64_t block_index, int row) const;
+    void RecordRequest(uint64_t block_index);
+    int EstimateFrequency(uint64_t block_index) const;
+};
@@ -0,0 +1,466 @@
+#include "cold_tier_file.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // size and checksum of the payload, whose first byte is the record type
+    const size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+    // Replay reads the file in chunks of at least this many bytes
+    const size_t REPLAY_CHUNK_SIZE = 1 << 20;
+
+    void ThrowSystemError(const char *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    [[noreturn]] void ThrowCorrupt()
+    {
+        using namespace std::string_literals;
+        throw std::runtime_error("Cold tier file is corrupt"s);
+    }
+
+    // FNV-1a, as in the write-ahead log
+    uint32_t ComputeChecksum(std::string_view data)
+    {
+        uint32_t hash = 2166136261u;
+        for (const char c : data)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    void AppendVarint(uint32_t value, std::string &out)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void AppendDouble(double value, std::string &out)
+    {
+        char bytes[sizeof(double)];
+        std::memcpy(bytes, &value, sizeof(double));
+        out.append(bytes, sizeof(double));
+    }
+
+    uint32_t ReadVarint(std::string_view data, size_t &position)
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (position >= data.size())
+            {
+                ThrowCorrupt();
+            }
+            const auto byte = static_cast<uint8_t>(data[position++]);
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+        ThrowCorrupt();
+    }
+
+    double ReadDouble(std::string_view data, size_t &position)
+    {
+        if (data.size() - position < sizeof(double))
+        {
+            ThrowCorrupt();
+        }
+        double value;
+        std::memcpy(&value, data.data() + position, sizeof(double));
+        position += sizeof(double);
+        return value;
+    }
+
+    std::string_view ReadString(std::string_view data, size_t &position)
+    {
+        const size_t size = ReadVarint(data, position);
+        if (data.size() - position < size)
+        {
+            ThrowCorrupt();
+        }
+        const auto text = data.substr(position, size);
+        position += size;
+        return text;
+    }
+
+    // Stops early only at the end of the file
+    size_t ReadAt(int fd, char *buffer, size_t size, uint64_t offset)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            const auto result = pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ThrowSystemError("pread");
+            }
+            if (result == 0)
+            {
+                break;
+            }
+            done += result;
+        }
+        return done;
+    }
+}
+
+ColdTierFile::ColdTierFile(const std::string &path, size_t cache_bytes)
+    : fd_(open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+      cache_(cache_bytes, BLOCK_SIZE)
+{
+    if (fd_ < 0)
+    {
+        ThrowSystemError("open");
+    }
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) < 0)
+    {
+        const int error = errno;
+        close(fd_);
+        errno = error;
+        ThrowSystemError("fstat");
+    }
+    size_ = file_stat.st_size;
+}
+
+ColdTierFile::~ColdTierFile()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+        // the next Replay cuts off what was not written in full
+    }
+    close(fd_);
+}
+
+void ColdTierFile::Replay(const std::function<void(const Record &)> &handle_record)
+{
+    std::string chunk;
+    uint64_t chunk_offset = 0;
+    // the bytes [offset, offset + size) of the file, nullopt past its end
+    const auto view = [&](uint64_t offset, size_t size) -> std::optional<std::string_view>
+    {
+        if (offset < chunk_offset || offset + size > chunk_offset + chunk.size())
+        {
+            chunk.resize(std::max(size, REPLAY_CHUNK_SIZE));
+            chunk.resize(ReadAt(fd_, chunk.data(), chunk.size(), offset));
+            chunk_offset = offset;
+            if (chunk.size() < size)
+            {
+                return std::nullopt;
+            }
+        }
+        return std::string_view(chunk).substr(offset - chunk_offset, size);
+    };
+
+    uint64_t offset = 0;
+    while (size_ - offset >= HEADER_SIZE)
+    {
+        const auto header = view(offset, HEADER_SIZE);
+        uint32_t payload_size = 0;
+        uint32_t checksum = 0;
+        std::memcpy(&payload_size, header->data(), sizeof(payload_size));
+        std::memcpy(&checksum, header->data() + sizeof(payload_size), sizeof(checksum));
+        if (payload_size == 0 || size_ - offset - HEADER_SIZE < payload_size)
+        {
+            break;
+        }
+        const auto payload = view(offset + HEADER_SIZE, payload_size);
+        if (!payload || ComputeChecksum(*payload) != checksum)
+        {
+            break;
+        }
+
+        Record record;
+        record.type = static_cast<RecordType>((*payload)[0]);
+        record.offset = offset;
+        const uint64_t payload_offset = offset + HEADER_SIZE;
+        size_t position = 1;
+        switch (record.type)
+        {
+        case RecordType::DOCUMENT:
+        {
+            record.document_id = static_cast<int>(ReadVarint(*payload, position));
+            const uint32_t rating = ReadVarint(*payload, position);
+            record.rating = static_cast<int>(rating >> 1) ^ -static_cast<int>(rating & 1);
+            if (position >= payload->size())
+            {
+                ThrowCorrupt();
+            }
+            record.status = static_cast<DocumentStatus>((*payload)[position++]);
+            record.words.count = ReadVarint(*payload, position);
+            record.words.offset = payload_offset + position;
+            for (uint32_t i = 0; i < record.words.count; ++i)
+            {
+                ReadString(*payload, position);
+                ReadDouble(*payload, position);
+            }
+            record.words.size = static_cast<uint32_t>(payload_offset + position - record.words.offset);
+            const auto text = ReadString(*payload, position);
+            record.text = {payload_offset + (text.data() - payload->data()), static_cast<uint32_t>(text.size()), 0};
+            break;
+        }
+        case RecordType::POSTINGS:
+            record.term = ReadString(*payload, position);
+            record.replaced_lists = ReadVarint(*payload, position);
+            record.postings.count = ReadVarint(*payload, position);
+            record.postings.offset = payload_offset + position;
+            record.postings.size = static_cast<uint32_t>(payload->size() - position);
+            break;
+        case RecordType::REMOVAL:
+            record.document_id = static_cast<int>(ReadVarint(*payload, position));
+            break;
+        default:
+            ThrowCorrupt();
+        }
+        handle_record(record);
+        offset += HEADER_SIZE + payload_size;
+    }
+    if (offset < size_)
+    {
+        if (ftruncate(fd_, static_cast<off_t>(offset)) < 0)
+        {
+            ThrowSystemError("ftruncate");
+        }
+        size_ = offset;
+    }
+}
+
+ColdTierFile::Record ColdTierFile::AppendDocument(int document_id, int rating, DocumentStatus status,
+                                                  const std::map<std::string_view, double> &words, std::string_view text)
+{
+    Record record;
+    record.type = RecordType::DOCUMENT;
+    record.document_id = document_id;
+    record.rating = rating;
+    record.status = status;
+    const uint64_t payload_offset = size_ + pending_.size() + HEADER_SIZE;
+
+    std::string payload(1, static_cast<char>(RecordType::DOCUMENT));
+    AppendVarint(static_cast<uint32_t>(document_id), payload);
+    AppendVarint((static_cast<uint32_t>(rating) << 1) ^ static_cast<uint32_t>(rating >> 31), payload);
+    payload.push_back(static_cast<char>(status));
+    AppendVarint(static_cast<uint32_t>(words.size()), payload);
+    record.words = {payload_offset + payload.size(), 0, static_cast<uint32_t>(words.size())};
+    for (const auto &[word, term_freq] : words)
+    {
+        AppendVarint(static_cast<uint32_t>(word.size()), payload);
+        payload.append(word);
+        AppendDouble(term_freq, payload);
+    }
+    record.words.size = static_cast<uint32_t>(payload_offset + payload.size() - record.words.offset);
+    AppendVarint(static_cast<uint32_t>(text.size()), payload);
+    record.text = {payload_offset + payload.size(), static_cast<uint32_t>(text.size()), 0};
+    payload.append(text);
+    record.offset = AppendRecord(payload);
+    return record;
+}
+
+ColdTierFile::Extent ColdTierFile::AppendPostings(std::string_view term, const FlatPostings &postings, uint32_t replaced_lists)
+{
+    const uint64_t payload_offset = size_ + pending_.size() + HEADER_SIZE;
+    std::string payload(1, static_cast<char>(RecordType::POSTINGS));
+    AppendVarint(static_cast<uint32_t>(term.size()), payload);
+    payload.append(term);
+    AppendVarint(replaced_lists, payload);
+    AppendVarint(static_cast<uint32_t>(postings.size()), payload);
+    Extent extent{payload_offset + payload.size(), 0, static_cast<uint32_t>(postings.size())};
+    const size_t start = payload.size();
+    int previous_id = 0;
+    for (const auto &[document_id, term_freq] : postings)
+    {
+        AppendVarint(static_cast<uint32_t>(document_id - previous_id), payload);
+        previous_id = document_id;
+        AppendDouble(term_freq, payload);
+    }
+    extent.size = static_cast<uint32_t>(payload.size() - start);
+    AppendRecord(payload);
+    return extent;
+}
+
+uint64_t ColdTierFile::AppendRemoval(int document_id)
+{
+    std::string payload(1, static_cast<char>(RecordType::REMOVAL));
+    AppendVarint(static_cast<uint32_t>(document_id), payload);
+    return AppendRecord(payload);
+}
+
+uint64_t ColdTierFile::AppendRecord(const std::string &payload)
+{
+    const uint64_t offset = size_ + pending_.size();
+    const auto payload_size = static_cast<uint32_t>(payload.size());
+    const uint32_t checksum = ComputeChecksum(payload);
+    pending_.append(reinterpret_cast<const char *>(&payload_size), sizeof(payload_size));
+    pending_.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    pending_.append(payload);
+    if (pending_.size() >= MAX_READ_BLOCKS * BLOCK_SIZE)
+    {
+        Flush();
+    }
+    return offset;
+}
+
+void ColdTierFile::Flush()
+{
+    std::string_view data = pending_;
+    while (!data.empty())
+    {
+        const auto written = write(fd_, data.data(), data.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ThrowSystemError("write");
+        }
+        data.remove_prefix(written);
+        size_ += written;
+    }
+    pending_.clear();
+}
+
+FlatPostings ColdTierFile::ReadPostings(const Extent &extent) const
+{
+    const auto bytes = ReadBytes(extent.offset, extent.size);
+    FlatPostings postings;
+    postings.reserve(extent.count);
+    size_t position = 0;
+    int document_id = 0;
+    while (position < bytes.size())
+    {
+        document_id += static_cast<int>(ReadVarint(bytes, position));
+        postings.emplace_back(document_id, ReadDouble(bytes, position));
+    }
+    return postings;
+}
+
+std::vector<std::pair<std::string, double>> ColdTierFile::ReadWords(const Extent &extent) const
+{
+    const auto bytes = ReadBytes(extent.offset, extent.size);
+    std::vector<std::pair<std::string, double>> words;
+    words.reserve(extent.count);
+    size_t position = 0;
+    while (position < bytes.size())
+    {
+        std::string word{ReadString(bytes, position)};
+        words.emplace_back(std::move(word), ReadDouble(bytes, position));
+    }
+    return words;
+}
+
+std::string ColdTierFile::ReadText(const Extent &extent) const
+{
+    return ReadBytes(extent.offset, extent.size);
+}
+
+BlockCacheStats ColdTierFile::GetCacheStats() const
+{
+    return cache_.GetStats();
+}
+
+size_t ColdTierFile::GetMemoryUsage() const
+{
+    return cache_.GetStats().bytes + pending_.capacity();
+}
+
+std::string ColdTierFile::ReadBytes(uint64_t offset, size_t size) const
+{
+    using namespace std::string_literals;
+    if (size == 0)
+    {
+        return {};
+    }
+    // a record is written out whole, so it is either in the file or still buffered
+    if (offset >= size_)
+    {
+        if (offset - size_ + size > pending_.size())
+        {
+            throw std::runtime_error("Cold tier file is shorter than its index"s);
+        }
+        return pending_.substr(offset - size_, size);
+    }
+    const uint64_t first_block = offset / BLOCK_SIZE;
+    const uint64_t block_count = (offset + size - 1) / BLOCK_SIZE - first_block + 1;
+    if (block_count >= READAHEAD_BLOCKS)
+    {
+        posix_fadvise(fd_, static_cast<off_t>(first_block * BLOCK_SIZE), static_cast<off_t>(block_count * BLOCK_SIZE), POSIX_FADV_WILLNEED);
+    }
+
+    std::vector<BlockCache::Block> blocks(block_count);
+    for (uint64_t i = 0; i < block_count; ++i)
+    {
+        blocks[i] = cache_.Find(first_block + i);
+    }
+    // consecutive misses are fetched together
+    for (uint64_t i = 0; i < block_count;)
+    {
+        if (blocks[i])
+        {
+            ++i;
+            continue;
+        }
+        uint64_t run_end = i + 1;
+        while (run_end < block_count && run_end - i < MAX_READ_BLOCKS && !blocks[run_end])
+        {
+            ++run_end;
+        }
+        std::string buffer((run_end - i) * BLOCK_SIZE, '\0');
+        buffer.resize(ReadAt(fd_, buffer.data(), buffer.size(), (first_block + i) * BLOCK_SIZE));
+        for (uint64_t block = i; block < run_end; ++block)
+        {
+            const size_t block_offset = (block - i) * BLOCK_SIZE;
+            if (block_offset >= buffer.size())
+            {
+                throw std::runtime_error("Cold tier file is shorter than its index"s);
+            }
+            blocks[block] = std::make_shared<const std::string>(buffer.substr(block_offset, BLOCK_SIZE));
+            // the last block of the file still grows with the next records
+            if (blocks[block]->size() == BLOCK_SIZE)
+            {
+                cache_.Insert(first_block + block, blocks[block]);
+            }
+        }
+        i = run_end;
+    }
+
+    std::string bytes;
+    bytes.reserve(size);
+    for (uint64_t i = 0; i < block_count && bytes.size() < size; ++i)
+    {
+        const size_t skip = i == 0 ? offset % BLOCK_SIZE : 0;
+        if (skip > blocks[i]->size())
+        {
+            break;
+        }
+        bytes.append(*blocks[i], skip, size - bytes.size());
+    }
+    if (bytes.size() != size)
+    {
+        throw std::runtime_error("Cold tier file is shorter than its index"s);
+    }
+    return bytes;
+}
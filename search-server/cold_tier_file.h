@@ -0,0 +1,100 @@
+#pragma once
+#include "block_cache.h"
+#include "document.h"
+#include "posting_lists.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Append-only file of the cold tier, read back with pread through a BlockCache. It holds the forward index entry and
+// text of every document, the posting lists moved out of memory and the removals. Records are framed like those of
+// the write-ahead log, with their size and checksum, so an existing file is replayed when it is opened again.
+// A posting list is stored as varint id gaps, each followed by the term frequency as it is in memory
+class ColdTierFile
+{
+public:
+    struct Extent
+    {
+        uint64_t offset = 0;
+        uint32_t size = 0;  // bytes
+        uint32_t count = 0; // postings or words
+    };
+
+    enum class RecordType : uint8_t
+    {
+        DOCUMENT = 1,
+        POSTINGS = 2,
+        REMOVAL = 3,
+    };
+
+    struct Record
+    {
+        RecordType type = RecordType::DOCUMENT;
+        uint64_t offset = 0; // where the record starts, which orders it against the others
+        int document_id = 0; // DOCUMENT and REMOVAL
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        Extent words; // DOCUMENT: the forward index entry
+        Extent text;
+        std::string_view term; // POSTINGS, valid during the call only
+        Extent postings;
+        uint32_t replaced_lists = 0; // POSTINGS: how many of the latest lists of the term this one merges
+    };
+
+    static const size_t BLOCK_SIZE = 4096;
+
+    // Creates the file or opens an existing one, whose records are read by Replay
+    ColdTierFile(const std::string &path, size_t cache_bytes);
+
+    // Writes out the buffered records
+    ~ColdTierFile();
+
+    ColdTierFile(const ColdTierFile &) = delete;
+    ColdTierFile &operator=(const ColdTierFile &) = delete;
+
+    // Calls handle_record for every intact record in file order. A torn tail left by a crash in the middle of a write
+    // is cut off, so the next record is appended right after the last intact one. Called before anything is appended
+    void Replay(const std::function<void(const Record &)> &handle_record);
+
+    // The Append functions only buffer the record; Read sees it right away
+    Record AppendDocument(int document_id, int rating, DocumentStatus status, const std::map<std::string_view, double> &words,
+                          std::string_view text);
+
+    Extent AppendPostings(std::string_view term, const FlatPostings &postings, uint32_t replaced_lists);
+
+    // Returns the offset of the record: the postings of the document in older lists are no longer valid
+    uint64_t AppendRemoval(int document_id);
+
+    void Flush();
+
+    FlatPostings ReadPostings(const Extent &extent) const;
+
+    std::vector<std::pair<std::string, double>> ReadWords(const Extent &extent) const;
+
+    std::string ReadText(const Extent &extent) const;
+
+    BlockCacheStats GetCacheStats() const;
+
+    // Heap bytes of the block cache and the buffered records
+    size_t GetMemoryUsage() const;
+
+private:
+    // Lists of at least this many blocks are announced to the kernel before they are read
+    static const size_t READAHEAD_BLOCKS = 8;
+    // Longest run of missed blocks fetched with one pread
+    static const size_t MAX_READ_BLOCKS = 64;
+
+    int fd_;
+    uint64_t size_ = 0; // written to the file, pending_ follows
+    std::string pending_;
+    mutable BlockCache cache_;
+
+    // The payload starts with the record type. Returns the offset of the record
+    uint64_t AppendRecord(const std::string &payload);
+    std::string ReadBytes(uint64_t offset, size_t size) const;
+};
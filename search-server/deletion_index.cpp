@@ -0,0 +1,184 @@
+#include "deletion_index.h"
+#include "memory_usage.h"
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+namespace
+{
+    // The code points of a UTF-8 text; a byte that is not a continuation starts a new one
+    std::vector<std::string_view> SplitCodePoints(std::string_view text)
+    {
+        std::vector<std::string_view> code_points;
+        size_t start = 0;
+        for (size_t pos = 1; pos <= text.size(); ++pos)
+        {
+            if (pos == text.size() || (static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80)
+            {
+                code_points.push_back(text.substr(start, pos - start));
+                start = pos;
+            }
+        }
+        return code_points;
+    }
+}
+
+DeletionIndex::DeletionIndex(int max_edit_distance)
+    : max_edit_distance_(max_edit_distance)
+{
+}
+
+void DeletionIndex::AddTerm(std::string_view term)
+{
+    for (const auto &deletion : GenerateDeletes(term))
+    {
+        deletes_to_terms_[deletion].push_back(term);
+    }
+}
+
+void DeletionIndex::RemoveTerm(std::string_view term)
+{
+    for (const auto &deletion : GenerateDeletes(term))
+    {
+        const auto terms = deletes_to_terms_.find(deletion);
+        if (terms == deletes_to_terms_.end())
+        {
+            continue;
+        }
+        auto &views = terms->second;
+        views.erase(std::remove(views.begin(), views.end(), term), views.end());
+        if (views.empty())
+        {
+            deletes_to_terms_.erase(terms);
+        }
+    }
+}
+
+std::vector<std::pair<std::string_view, int>> DeletionIndex::FindCandidates(std::string_view word) const
+{
+    std::set<std::string_view> seen;
+    std::vector<std::pair<std::string_view, int>> candidates;
+    for (const auto &deletion : GenerateDeletes(word))
+    {
+        const auto terms = deletes_to_terms_.find(deletion);
+        if (terms == deletes_to_terms_.end())
+        {
+            continue;
+        }
+        for (const auto term : terms->second)
+        {
+            if (!seen.insert(term).second)
+            {
+                continue;
+            }
+            const int distance = ComputeEditDistance(word, term, max_edit_distance_);
+            if (distance <= max_edit_distance_)
+            {
+                candidates.push_back({term, distance});
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto &lhs, const auto &rhs)
+              { return lhs.second < rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first); });
+    return candidates;
+}
+
+int DeletionIndex::GetMaxEditDistance() const
+{
+    return max_edit_distance_;
+}
+
+size_t DeletionIndex::GetMemoryUsage() const
+{
+    size_t bytes = deletes_to_terms_.size() * GetUnorderedMapNodeSize<std::string, std::vector<std::string_view>>() +
+                   deletes_to_terms_.bucket_count() * sizeof(void *);
+    for (const auto &[deletion, terms] : deletes_to_terms_)
+    {
+        bytes += GetBufferMemory(deletion) + GetBufferMemory(terms);
+    }
+    return bytes;
+}
+
+size_t DeletionIndex::EstimateTermMemory(std::string_view term) const
+{
+    // node, bucket pointer and a single-term vector
+    const size_t entry_memory = GetUnorderedMapNodeSize<std::string, std::vector<std::string_view>>() + sizeof(void *) +
+                                sizeof(std::string_view);
+    // a deletion drops at least one byte, so term.size() - distance bounds the variant length
+    const size_t code_point_count = SplitCodePoints(term).size();
+    size_t bytes = 0;
+    size_t variant_count = 1; // code_point_count choose distance
+    for (size_t distance = 0; distance <= static_cast<size_t>(max_edit_distance_) && distance <= code_point_count; ++distance)
+    {
+        const size_t length = term.size() - distance;
+        const size_t text_memory = length > std::string().capacity() ? length + 1 : 0;
+        bytes += variant_count * (entry_memory + text_memory);
+        variant_count = variant_count * (code_point_count - distance) / (distance + 1);
+    }
+    return bytes;
+}
+
+// The word itself and every variant with 1..max_edit_distance_ code points removed
+std::vector<std::string> DeletionIndex::GenerateDeletes(std::string_view word) const
+{
+    std::set<std::string> deletes{std::string{word}};
+    std::vector<std::string> current{std::string{word}};
+    for (int distance = 1; distance <= max_edit_distance_; ++distance)
+    {
+        std::vector<std::string> next;
+        for (const auto &variant : current)
+        {
+            size_t start = 0;
+            for (const auto code_point : SplitCodePoints(variant))
+            {
+                auto deletion = variant.substr(0, start) + variant.substr(start + code_point.size());
+                start += code_point.size();
+                if (deletes.insert(deletion).second)
+                {
+                    next.push_back(std::move(deletion));
+                }
+            }
+        }
+        current = std::move(next);
+    }
+    return {deletes.begin(), deletes.end()};
+}
+
+int ComputeEditDistance(std::string_view lhs_text, std::string_view rhs_text, int max_distance)
+{
+    const auto lhs = SplitCodePoints(lhs_text);
+    const auto rhs = SplitCodePoints(rhs_text);
+    if (std::abs(static_cast<int>(lhs.size()) - static_cast<int>(rhs.size())) > max_distance)
+    {
+        return max_distance + 1;
+    }
+    const size_t columns = rhs.size() + 1;
+    // three rows are enough: the transposition looks two rows back
+    std::vector<int> before_previous(columns), previous(columns), current(columns);
+    for (size_t j = 0; j < columns; ++j)
+    {
+        previous[j] = static_cast<int>(j);
+    }
+    for (size_t i = 1; i <= lhs.size(); ++i)
+    {
+        current[0] = static_cast<int>(i);
+        int row_min = current[0];
+        for (size_t j = 1; j < columns; ++j)
+        {
+            const int cost = lhs[i - 1] == rhs[j - 1] ? 0 : 1;
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1])
+            {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = std::min(row_min, current[j]);
+        }
+        if (row_min > max_distance)
+        {
+            return max_distance + 1;
+        }
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[rhs.size()], max_distance + 1);
+}
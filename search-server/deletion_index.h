@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// SymSpell-style index: every term is stored under all its variants with up to max_edit_distance
+// characters (UTF-8 code points) deleted, so a misspelled word is looked up through its own deletions
+// instead of a scan over the vocabulary
+class DeletionIndex
+{
+public:
+    explicit DeletionIndex(int max_edit_distance);
+
+    // The index keeps the view, the term has to outlive it
+    void AddTerm(std::string_view term);
+
+    // Drops a term added before, so it is no longer offered as a candidate
+    void RemoveTerm(std::string_view term);
+
+    // Terms within max_edit_distance of the word with their distances, nearest first
+    std::vector<std::pair<std::string_view, int>> FindCandidates(std::string_view word) const;
+
+    int GetMaxEditDistance() const;
+
+    // Heap bytes of the deletion table
+    size_t GetMemoryUsage() const;
+
+    // Upper bound of the bytes AddTerm adds: every deletion is taken to open an entry of its own
+    size_t EstimateTermMemory(std::string_view term) const;
+
+private:
+    int max_edit_distance_;
+    std::unordered_map<std::string, std::vector<std::string_view>> deletes_to_terms_;
+
+    std::vector<std::string> GenerateDeletes(std::string_view word) const;
+};
+
+// Optimal string alignment distance over UTF-8 code points (adjacent transposition costs 1),
+// max_distance + 1 if it is larger
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
@@ -0,0 +1,151 @@
+#include "document_bitmap.h"
+#include "memory_usage.h"
+#include <algorithm>
+
+void DocumentBitmap::Insert(int document_id)
+{
+    auto &chunk = chunks_[document_id >> CHUNK_BITS];
+    const auto low = static_cast<uint16_t>(document_id);
+    if (chunk.bits.empty())
+    {
+        auto pos = std::lower_bound(chunk.array.begin(), chunk.array.end(), low);
+        if (pos != chunk.array.end() && *pos == low)
+        {
+            return;
+        }
+        chunk.array.insert(pos, low);
+    }
+    else
+    {
+        uint64_t &word = chunk.bits[low / 64];
+        const uint64_t mask = uint64_t{1} << (low % 64);
+        if (word & mask)
+        {
+            return;
+        }
+        word |= mask;
+    }
+    ++chunk.size;
+    ++size_;
+    if (chunk.bits.empty() && chunk.size > MAX_ARRAY_SIZE)
+    {
+        ConvertToBitset(chunk);
+    }
+}
+
+void DocumentBitmap::Erase(int document_id)
+{
+    auto chunk_it = chunks_.find(document_id >> CHUNK_BITS);
+    if (chunk_it == chunks_.end())
+    {
+        return;
+    }
+    auto &chunk = chunk_it->second;
+    const auto low = static_cast<uint16_t>(document_id);
+    if (chunk.bits.empty())
+    {
+        auto pos = std::lower_bound(chunk.array.begin(), chunk.array.end(), low);
+        if (pos == chunk.array.end() || *pos != low)
+        {
+            return;
+        }
+        chunk.array.erase(pos);
+    }
+    else
+    {
+        uint64_t &word = chunk.bits[low / 64];
+        const uint64_t mask = uint64_t{1} << (low % 64);
+        if ((word & mask) == 0)
+        {
+            return;
+        }
+        word &= ~mask;
+    }
+    --chunk.size;
+    --size_;
+    if (chunk.size == 0)
+    {
+        chunks_.erase(chunk_it);
+    }
+    else if (!chunk.bits.empty() && chunk.size < MIN_BITSET_SIZE)
+    {
+        ConvertToArray(chunk);
+    }
+}
+
+bool DocumentBitmap::Contains(int document_id) const
+{
+    const auto chunk_it = chunks_.find(document_id >> CHUNK_BITS);
+    if (chunk_it == chunks_.end())
+    {
+        return false;
+    }
+    const auto &chunk = chunk_it->second;
+    const auto low = static_cast<uint16_t>(document_id);
+    if (chunk.bits.empty())
+    {
+        return std::binary_search(chunk.array.begin(), chunk.array.end(), low);
+    }
+    return (chunk.bits[low / 64] >> (low % 64)) & 1;
+}
+
+size_t DocumentBitmap::Size() const
+{
+    return size_;
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const
+{
+    size_t bytes = chunks_.size() * GetMapNodeSize<int, Chunk>();
+    for (const auto &[_, chunk] : chunks_)
+    {
+        bytes += GetBufferMemory(chunk.array) + GetBufferMemory(chunk.bits);
+    }
+    return bytes;
+}
+
+bool DocumentBitmap::Empty() const
+{
+    return size_ == 0;
+}
+
+DocumentBitmap DocumentBitmap::Intersect(const DocumentBitmap &other) const
+{
+    const DocumentBitmap &smaller = size_ <= other.size_ ? *this : other;
+    const DocumentBitmap &larger = size_ <= other.size_ ? other : *this;
+    DocumentBitmap result;
+    smaller.ForEach([&](int document_id)
+                    {
+        if (larger.Contains(document_id)) {
+            result.Insert(document_id);
+        } });
+    return result;
+}
+
+void DocumentBitmap::ConvertToBitset(Chunk &chunk)
+{
+    chunk.bits.assign(CHUNK_WORDS, 0);
+    for (const uint16_t low : chunk.array)
+    {
+        chunk.bits[low / 64] |= uint64_t{1} << (low % 64);
+    }
+    chunk.array.clear();
+    chunk.array.shrink_to_fit();
+}
+
+void DocumentBitmap::ConvertToArray(Chunk &chunk)
+{
+    chunk.array.reserve(chunk.size);
+    for (size_t word = 0; word < CHUNK_WORDS; ++word)
+    {
+        for (size_t bit = 0; bit < 64; ++bit)
+        {
+            if ((chunk.bits[word] >> bit) & 1)
+            {
+                chunk.array.push_back(static_cast<uint16_t>(word * 64 + bit));
+            }
+        }
+    }
+    chunk.bits.clear();
+    chunk.bits.shrink_to_fit();
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Roaring-style set of document ids: ids are grouped into chunks of 2^16 values,
+// a sparse chunk keeps a sorted array of low halves, a dense one switches to a bitset
+class DocumentBitmap
+{
+public:
+    void Insert(int document_id);
+
+    void Erase(int document_id);
+
+    bool Contains(int document_id) const;
+
+    size_t Size() const;
+
+    bool Empty() const;
+
+    DocumentBitmap Intersect(const DocumentBitmap &other) const;
+
+    // Heap bytes of the chunks
+    size_t GetMemoryUsage() const;
+
+    // Visits ids in ascending order
+    template <typename Visitor>
+    void ForEach(Visitor visit) const;
+
+    // ForEach restricted to the ids in [first_id, last_id)
+    template <typename Visitor>
+    void ForEachInRange(int first_id, int last_id, Visitor visit) const;
+
+private:
+    struct Chunk
+    {
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+        size_t size = 0;
+    };
+
+    static const size_t CHUNK_BITS = 16;
+    static const size_t CHUNK_WORDS = (1 << CHUNK_BITS) / 64;
+    static const size_t MAX_ARRAY_SIZE = 4096;
+    static const size_t MIN_BITSET_SIZE = 2048;
+
+    std::map<int, Chunk> chunks_;
+    size_t size_ = 0;
+
+    static void ConvertToBitset(Chunk &chunk);
+    static void ConvertToArray(Chunk &chunk);
+};
+
+template <typename Visitor>
+void DocumentBitmap::ForEach(Visitor visit) const
+{
+    ForEachInRange(0, std::numeric_limits<int>::max(), visit);
+}
+
+template <typename Visitor>
+void DocumentBitmap::ForEachInRange(int first_id, int last_id, Visitor visit) const
+{
+    if (first_id >= last_id)
+    {
+        return;
+    }
+    const int last_key = (last_id - 1) >> CHUNK_BITS;
+    for (auto chunk_it = chunks_.lower_bound(first_id >> CHUNK_BITS); chunk_it != chunks_.end() && chunk_it->first <= last_key; ++chunk_it)
+    {
+        const auto &[key, chunk] = *chunk_it;
+        const int high = key << CHUNK_BITS;
+        // the bounds within the chunk, the last one inclusive
+        const size_t first_low = std::max(first_id, high) - high;
+        const size_t last_low = std::min<int64_t>(int64_t{last_id} - 1, high + ((1 << CHUNK_BITS) - 1)) - high;
+        if (chunk.bits.empty())
+        {
+            for (auto low = std::lower_bound(chunk.array.begin(), chunk.array.end(), first_low); low != chunk.array.end() && *low <= last_low; ++low)
+            {
+                visit(high | *low);
+            }
+            continue;
+        }
+        for (size_t word = first_low / 64; word <= last_low / 64; ++word)
+        {
+            uint64_t bits = chunk.bits[word];
+            if (word == first_low / 64)
+            {
+                bits &= ~uint64_t{0} << (first_low % 64);
+            }
+            if (word == last_low / 64 && last_low % 64 != 63)
+            {
+                bits &= (uint64_t{1} << (last_low % 64 + 1)) - 1;
+            }
+            for (; bits != 0; bits &= bits - 1)
+            {
+                int bit = 0;
+                while (((bits >> bit) & 1) == 0)
+                {
+                    ++bit;
+                }
+                visit(high | static_cast<int>(word * 64 + bit));
+            }
+        }
+    }
+}
@@ -0,0 +1,357 @@
+#include "durable_search_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const char ADD_RECORD = 'A';
+    const char REMOVE_RECORD = 'R';
+    // first record of a snapshot: the first log segment that is not folded into it
+    const char SNAPSHOT_RECORD = 'S';
+
+    const std::string SEGMENT_PREFIX = "wal-";
+    const std::string SNAPSHOT_NAME = "snapshot";
+    const std::string SNAPSHOT_TEMP_NAME = "snapshot.tmp";
+
+    template <typename Value>
+    void Put(std::string &record, Value value)
+    {
+        record.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    class RecordReader
+    {
+    public:
+        explicit RecordReader(std::string_view record)
+            : record_(record)
+        {
+        }
+
+        template <typename Value>
+        Value Get()
+        {
+            Value value;
+            std::memcpy(&value, GetBytes(sizeof(value)).data(), sizeof(value));
+            return value;
+        }
+
+        std::string_view GetBytes(size_t size)
+        {
+            using namespace std::string_literals;
+            if (record_.size() < size)
+            {
+                throw std::runtime_error("Log record is truncated"s);
+            }
+            const auto bytes = record_.substr(0, size);
+            record_.remove_prefix(size);
+            return bytes;
+        }
+
+    private:
+        std::string_view record_;
+    };
+
+    std::string EncodeAdd(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int> &ratings)
+    {
+        std::string record;
+        Put(record, ADD_RECORD);
+        Put(record, document_id);
+        Put(record, static_cast<int>(status));
+        Put(record, static_cast<uint32_t>(ratings.size()));
+        for (const int rating : ratings)
+        {
+            Put(record, rating);
+        }
+        Put(record, static_cast<uint32_t>(document.size()));
+        record.append(document);
+        return record;
+    }
+
+    std::string EncodeRemove(int document_id)
+    {
+        std::string record;
+        Put(record, REMOVE_RECORD);
+        Put(record, document_id);
+        return record;
+    }
+
+    // makes created, renamed and deleted files in the directory durable
+    void SyncDirectory(const std::string &directory)
+    {
+        const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "open");
+        }
+        const int result = fsync(fd);
+        const int error = errno;
+        close(fd);
+        if (result < 0)
+        {
+            throw std::system_error(error, std::generic_category(), "fsync");
+        }
+    }
+}
+
+DurableSearchServer::DurableSearchServer(const std::string &directory, const std::string &stop_words_text, uint64_t compaction_threshold)
+    : directory_(directory),
+      compaction_threshold_(compaction_threshold),
+      server_(stop_words_text)
+{
+    Recover();
+    compaction_thread_ = std::thread([this]
+                                     { CompactionLoop(); });
+}
+
+DurableSearchServer::~DurableSearchServer()
+{
+    {
+        std::lock_guard guard(compaction_request_mutex_);
+        is_stopping_ = true;
+    }
+    compaction_request_.notify_one();
+    compaction_thread_.join();
+}
+
+void DurableSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                                      const std::vector<int> &ratings)
+{
+    const auto record = EncodeAdd(document_id, document, status, ratings);
+    std::unique_lock lock(mutex_);
+    ThrowIfLogFailed();
+    server_.AddDocument(document_id, document, status, ratings);
+    LogMutation(record, std::move(lock));
+}
+
+void DurableSearchServer::RemoveDocument(int document_id)
+{
+    std::unique_lock lock(mutex_);
+    if (server_.documents_.count(document_id) == 0)
+    {
+        return;
+    }
+    ThrowIfLogFailed();
+    server_.RemoveDocument(document_id);
+    LogMutation(EncodeRemove(document_id), std::move(lock));
+}
+
+void DurableSearchServer::ThrowIfLogFailed() const
+{
+    using namespace std::string_literals;
+    // the memory would drift from what the recovery rebuilds
+    if (is_log_failed_ || log_->HasFailed())
+    {
+        throw std::runtime_error("Write-ahead log failed, changes are rejected until a compaction succeeds"s);
+    }
+}
+
+void DurableSearchServer::LogMutation(const std::string &record, std::unique_lock<std::shared_mutex> lock)
+{
+    const auto log = log_;
+    const auto sequence = log->Append(record);
+    lock.unlock();
+    // writers arriving meanwhile append and wait too, the next fsync covers them all
+    log->WaitDurable(sequence);
+    if (log->GetSize() >= compaction_threshold_)
+    {
+        {
+            std::lock_guard guard(compaction_request_mutex_);
+            is_compaction_requested_ = true;
+        }
+        compaction_request_.notify_one();
+    }
+}
+
+std::vector<Document> DurableSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const
+{
+    std::shared_lock lock(mutex_);
+    return server_.FindTopDocuments(raw_query, status);
+}
+
+std::vector<Document> DurableSearchServer::FindTopDocuments(const std::string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> DurableSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                             int document_id) const
+{
+    std::shared_lock lock(mutex_);
+    return server_.MatchDocument(raw_query, document_id);
+}
+
+int DurableSearchServer::GetDocumentCount() const
+{
+    std::shared_lock lock(mutex_);
+    return server_.GetDocumentCount();
+}
+
+void DurableSearchServer::Compact()
+{
+    std::lock_guard compaction_guard(compaction_mutex_);
+    const auto temp_path = directory_ + "/" + SNAPSHOT_TEMP_NAME;
+    std::filesystem::remove(temp_path);
+    uint64_t first_segment = 0;
+    std::vector<std::tuple<int, std::string, DocumentStatus, int>> documents;
+    {
+        // the log is switched and the documents copied in one step, so the snapshot and the new segment meet exactly
+        std::unique_lock lock(mutex_);
+        is_log_failed_ = is_log_failed_ || log_->HasFailed();
+        first_segment = log_segment_ + 1;
+        log_ = std::make_shared<WriteAheadLog>(GetSegmentPath(first_segment));
+        log_segment_ = first_segment;
+        documents.reserve(server_.documents_.size());
+        for (const auto &[document_id, document] : server_.documents_)
+        {
+            documents.emplace_back(document_id, std::string(document.text), document.status, document.rating);
+        }
+    }
+    {
+        WriteAheadLog snapshot(temp_path);
+        std::string record;
+        Put(record, SNAPSHOT_RECORD);
+        Put(record, first_segment);
+        snapshot.Append(record);
+        for (const auto &[document_id, text, status, rating] : documents)
+        {
+            // the average rating alone gives the same average back
+            snapshot.Append(EncodeAdd(document_id, text, status, {rating}));
+        }
+        snapshot.Flush();
+    }
+    std::filesystem::rename(temp_path, directory_ + "/" + SNAPSHOT_NAME);
+    SyncDirectory(directory_);
+    {
+        std::unique_lock lock(mutex_);
+        is_log_failed_ = false;
+    }
+
+    for (const auto segment : ListSegments())
+    {
+        if (segment < first_segment)
+        {
+            std::filesystem::remove(GetSegmentPath(segment));
+        }
+    }
+    SyncDirectory(directory_);
+}
+
+void DurableSearchServer::Recover()
+{
+    std::filesystem::create_directories(directory_);
+    // a compaction interrupted before the rename
+    std::filesystem::remove(directory_ + "/" + SNAPSHOT_TEMP_NAME);
+
+    uint64_t first_segment = 0;
+    WriteAheadLog::Replay(directory_ + "/" + SNAPSHOT_NAME, [this, &first_segment](std::string_view record)
+                          {
+        if (!record.empty() && record.front() == SNAPSHOT_RECORD) {
+            RecordReader reader(record.substr(1));
+            first_segment = reader.Get<uint64_t>();
+        } else {
+            ApplyRecord(record);
+        } });
+
+    log_segment_ = first_segment;
+    for (const auto segment : ListSegments())
+    {
+        if (segment < first_segment)
+        {
+            // already in the snapshot, the compaction stopped before deleting it
+            std::filesystem::remove(GetSegmentPath(segment));
+            continue;
+        }
+        WriteAheadLog::Replay(GetSegmentPath(segment), [this](std::string_view record)
+                              { ApplyRecord(record); });
+        log_segment_ = segment + 1;
+    }
+    log_ = std::make_shared<WriteAheadLog>(GetSegmentPath(log_segment_));
+    SyncDirectory(directory_);
+}
+
+void DurableSearchServer::ApplyRecord(std::string_view record)
+{
+    using namespace std::string_literals;
+    RecordReader reader(record);
+    const char type = reader.Get<char>();
+    if (type == ADD_RECORD)
+    {
+        const int document_id = reader.Get<int>();
+        const auto status = static_cast<DocumentStatus>(reader.Get<int>());
+        std::vector<int> ratings(reader.Get<uint32_t>());
+        for (int &rating : ratings)
+        {
+            rating = reader.Get<int>();
+        }
+        const auto document = reader.GetBytes(reader.Get<uint32_t>());
+        server_.AddDocument(document_id, document, status, ratings);
+    }
+    else if (type == REMOVE_RECORD)
+    {
+        server_.RemoveDocument(reader.Get<int>());
+    }
+    else
+    {
+        throw std::runtime_error("Unknown log record type "s + type);
+    }
+}
+
+std::string DurableSearchServer::GetSegmentPath(uint64_t segment) const
+{
+    return directory_ + "/" + SEGMENT_PREFIX + std::to_string(segment);
+}
+
+std::vector<uint64_t> DurableSearchServer::ListSegments() const
+{
+    std::vector<uint64_t> segments;
+    for (const auto &entry : std::filesystem::directory_iterator(directory_))
+    {
+        const auto name = entry.path().filename().string();
+        if (name.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) != 0)
+        {
+            continue;
+        }
+        uint64_t segment = 0;
+        const auto [end, error] = std::from_chars(name.data() + SEGMENT_PREFIX.size(), name.data() + name.size(), segment);
+        if (error == std::errc() && end == name.data() + name.size())
+        {
+            segments.push_back(segment);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void DurableSearchServer::CompactionLoop()
+{
+    std::unique_lock lock(compaction_request_mutex_);
+    while (true)
+    {
+        compaction_request_.wait(lock, [this]
+                                 { return is_stopping_ || is_compaction_requested_; });
+        if (is_stopping_)
+        {
+            return;
+        }
+        is_compaction_requested_ = false;
+        lock.unlock();
+        try
+        {
+            Compact();
+        }
+        catch (const std::exception &)
+        {
+            // the log segments are kept, so nothing is lost; the next request tries again
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "search_server.h"
+#include "write_ahead_log.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SearchServer whose changes survive a restart. AddDocument and RemoveDocument are logged to
+// <directory>/wal-<N> and return once the record is on disk; concurrent writers share one fsync.
+// A change is applied in memory before its record is durable, so queries may see it while the writer still waits,
+// and it stays visible if the write fails and the writer gets an exception. After such a failure every further
+// change is rejected with runtime_error, untouched, until Compact succeeds: it persists the index as queries see it
+// and starts a fresh log segment.
+// When the current log segment outgrows compaction_threshold bytes, a background thread writes the whole
+// index to <directory>/snapshot and drops the segments it covers. The constructor loads the snapshot and replays the newer segments
+class DurableSearchServer
+{
+public:
+    DurableSearchServer(const std::string &directory, const std::string &stop_words_text, uint64_t compaction_threshold = 64 << 20);
+
+    ~DurableSearchServer();
+
+    DurableSearchServer(const DurableSearchServer &) = delete;
+    DurableSearchServer &operator=(const DurableSearchServer &) = delete;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
+                                                                            int document_id) const;
+
+    int GetDocumentCount() const;
+
+    // Writes a snapshot now; the log segments it covers are deleted
+    void Compact();
+
+private:
+    const std::string directory_;
+    const uint64_t compaction_threshold_;
+    SearchServer server_;
+    // queries share it; mutations and the log switch of Compact hold it exclusively, so the log order is the apply order
+    mutable std::shared_mutex mutex_;
+    std::shared_ptr<WriteAheadLog> log_;
+    uint64_t log_segment_ = 0;
+    // a failed log was rotated away but no snapshot has covered it yet
+    bool is_log_failed_ = false;
+
+    std::mutex compaction_mutex_;
+    std::mutex compaction_request_mutex_;
+    std::condition_variable compaction_request_;
+    bool is_compaction_requested_ = false;
+    bool is_stopping_ = false;
+    // started last, stopped first
+    std::thread compaction_thread_;
+
+    void Recover();
+    void ApplyRecord(std::string_view record);
+    void ThrowIfLogFailed() const;
+    void LogMutation(const std::string &record, std::unique_lock<std::shared_mutex> lock);
+    std::string GetSegmentPath(uint64_t segment) const;
+    std::vector<uint64_t> ListSegments() const;
+    void CompactionLoop();
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> DurableSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    std::shared_lock lock(mutex_);
+    return server_.FindTopDocuments(raw_query, document_predicate);
+}
@@ -0,0 +1,122 @@
+#include "execution_cost_model.h"
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const size_t MIN_CALIBRATION_SIZE = 256;
+    const size_t MAX_CALIBRATION_SIZE = 1 << 17;
+    const int CALIBRATION_RUNS = 3;
+
+    std::once_flag calibration_flag;
+    size_t calibrated_threshold = 0;
+
+    template <typename Func>
+    std::chrono::nanoseconds MeasureBest(Func func)
+    {
+        auto best = std::chrono::nanoseconds::max();
+        for (int run = 0; run < CALIBRATION_RUNS; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            func();
+            best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+        }
+        return best;
+    }
+}
+
+const ExecutionCostModel &ExecutionCostModel::Instance()
+{
+    Calibrate();
+    static const ExecutionCostModel model(calibrated_threshold);
+    return model;
+}
+
+void ExecutionCostModel::Calibrate()
+{
+    std::call_once(calibration_flag, []
+                   { calibrated_threshold = MeasureParallelThreshold(); });
+}
+
+void ExecutionCostModel::Calibrate(size_t parallel_threshold)
+{
+    using namespace std::string_literals;
+    std::call_once(calibration_flag, [parallel_threshold]
+                   { calibrated_threshold = std::max<size_t>(parallel_threshold, 1); });
+    if (calibrated_threshold != std::max<size_t>(parallel_threshold, 1))
+    {
+        throw std::logic_error("The execution cost model is already calibrated with another threshold"s);
+    }
+}
+
+bool ExecutionCostModel::PreferParallel(size_t postings_to_visit) const
+{
+    return postings_to_visit >= parallel_threshold_;
+}
+
+size_t ExecutionCostModel::ChooseParallelism(size_t postings_to_visit) const
+{
+    if (!PreferParallel(postings_to_visit))
+    {
+        return 1;
+    }
+    const size_t thread_count = std::max(2u, std::thread::hardware_concurrency());
+    return std::min(thread_count, postings_to_visit / parallel_threshold_ + 1);
+}
+
+size_t ExecutionCostModel::GetParallelThreshold() const
+{
+    return parallel_threshold_;
+}
+
+ExecutionCostModel::ExecutionCostModel(size_t parallel_threshold)
+    : parallel_threshold_(parallel_threshold)
+{
+}
+
+// Doubles a synthetic posting list until the walk split into id ranges under par, as FindAllDocuments
+// does it, is faster than the single walk under seq. Stays at "never parallel" if that does not happen
+size_t ExecutionCostModel::MeasureParallelThreshold()
+{
+    const int partition_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::map<int, double> postings;
+    for (size_t size = MIN_CALIBRATION_SIZE; size <= MAX_CALIBRATION_SIZE; size *= 2)
+    {
+        for (int document_id = static_cast<int>(postings.size()); document_id < static_cast<int>(size); ++document_id)
+        {
+            postings.emplace(document_id, 1.0 / (document_id + 1));
+        }
+        const auto sequential = MeasureBest([&postings]
+                                            {
+            std::map<int, double> document_to_relevance;
+            for (const auto [document_id, term_freq] : postings) {
+                document_to_relevance[document_id] += term_freq;
+            } });
+        const auto parallel = MeasureBest([&postings, partition_count, size]
+                                          {
+            std::vector<int> ranges(partition_count);
+            std::iota(ranges.begin(), ranges.end(), 0);
+            const int width = static_cast<int>(size) / partition_count + 1;
+            std::vector<std::map<int, double>> range_relevance(partition_count);
+            std::for_each(std::execution::par, ranges.begin(), ranges.end(), [&](int range) {
+                auto &document_to_relevance = range_relevance[range];
+                for (auto posting = postings.lower_bound(range * width); posting != postings.end() && posting->first < (range + 1) * width; ++posting) {
+                    document_to_relevance[posting->first] += posting->second;
+                }
+            }); });
+        if (parallel < sequential)
+        {
+            return size;
+        }
+    }
+    return std::numeric_limits<size_t>::max();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+// Policy tag: the server estimates the work of the call and picks seq or par itself
+struct AutomaticExecutionPolicy
+{
+};
+
+inline constexpr AutomaticExecutionPolicy automatic_execution{};
+
+// Posting count from which par beats seq on this machine, and the degree of parallelism above it.
+// Measured by a microbenchmark of the same accumulation FindAllDocuments does, on the first
+// automatic call unless Calibrate runs before
+class ExecutionCostModel
+{
+public:
+    static const ExecutionCostModel &Instance();
+
+    // Measures the threshold now unless that already happened, so the measurement (up to about
+    // half a second) is not paid by the first query
+    static void Calibrate();
+
+    // Takes a threshold measured earlier, e.g. GetParallelThreshold of a previous run, instead of measuring.
+    // Throws logic_error if a different threshold is already in use
+    static void Calibrate(size_t parallel_threshold);
+
+    bool PreferParallel(size_t postings_to_visit) const;
+
+    // Id ranges par should split the postings into: 1 (run seq) below the threshold, then
+    // one more per threshold's worth of postings, at most one per hardware thread
+    size_t ChooseParallelism(size_t postings_to_visit) const;
+
+    size_t GetParallelThreshold() const;
+
+private:
+    explicit ExecutionCostModel(size_t parallel_threshold);
+
+    size_t parallel_threshold_;
+
+    static size_t MeasureParallelThreshold();
+};
@@ -0,0 +1,107 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(2 * HALF_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * HALF_BUCKET_COUNT)
+{
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency)
+{
+    const uint64_t value = std::max<int64_t>(0, latency.count());
+    ++counts_[GetBucket(value)];
+    ++total_;
+    max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other)
+{
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket)
+    {
+        counts_[bucket] += other.counts_[bucket];
+    }
+    total_ += other.total_;
+    max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::GetTotal() const
+{
+    return total_;
+}
+
+double LatencyHistogram::GetPercentile(double fraction) const
+{
+    if (total_ == 0)
+    {
+        return 0.0;
+    }
+    if (fraction >= 1.0)
+    {
+        return max_ / 1000.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * total_)));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket)
+    {
+        seen += counts_[bucket];
+        if (seen >= rank)
+        {
+            return std::min(GetBucketUpperEdge(bucket), max_) / 1000.0;
+        }
+    }
+    return max_ / 1000.0;
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value)
+{
+    if (value < 2 * HALF_BUCKET_COUNT)
+    {
+        return value;
+    }
+    const int shift = 63 - __builtin_clzll(value) - (SUB_BUCKET_BITS - 1);
+    return 2 * HALF_BUCKET_COUNT + (shift - 1) * HALF_BUCKET_COUNT + ((value >> shift) - HALF_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperEdge(size_t bucket)
+{
+    if (bucket < 2 * HALF_BUCKET_COUNT)
+    {
+        return bucket;
+    }
+    const int shift = (bucket - 2 * HALF_BUCKET_COUNT) / HALF_BUCKET_COUNT + 1;
+    const uint64_t mantissa = (bucket - 2 * HALF_BUCKET_COUNT) % HALF_BUCKET_COUNT + HALF_BUCKET_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+std::vector<std::chrono::nanoseconds> BuildReplaySchedule(const std::vector<std::chrono::nanoseconds> &offsets, double rate,
+                                                          int repeat, uint64_t seed)
+{
+    std::vector<std::chrono::nanoseconds> schedule;
+    if (offsets.empty())
+    {
+        return schedule;
+    }
+    if (rate > 0.0)
+    {
+        std::mt19937_64 generator(seed);
+        std::exponential_distribution<double> gap(rate);
+        double offset = 0.0;
+        for (size_t i = 0; i < offsets.size() * repeat; ++i)
+        {
+            schedule.push_back(std::chrono::nanoseconds(static_cast<int64_t>(offset * 1e9)));
+            offset += gap(generator);
+        }
+        return schedule;
+    }
+    const auto span = offsets.back() + offsets.back() / std::max<size_t>(1, offsets.size() - 1);
+    for (int pass = 0; pass < repeat; ++pass)
+    {
+        for (const auto offset : offsets)
+        {
+            schedule.push_back(span * pass + offset);
+        }
+    }
+    return schedule;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear buckets: exact below 128 ns, then 64 buckets per power of two (under 1.6% error)
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Record(std::chrono::nanoseconds latency);
+
+    void Merge(const LatencyHistogram &other);
+
+    uint64_t GetTotal() const;
+
+    // Upper edge of the bucket holding the percentile, never above the largest recorded value; in microseconds
+    double GetPercentile(double fraction) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const uint64_t HALF_BUCKET_COUNT = uint64_t{1} << (SUB_BUCKET_BITS - 1);
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+    uint64_t max_ = 0;
+
+    static size_t GetBucket(uint64_t value);
+
+    static uint64_t GetBucketUpperEdge(size_t bucket);
+};
+
+// Start time of every query of a replay relative to its beginning. With a positive rate the arrivals are Poisson
+// with that mean number of queries per second, otherwise the recorded offsets are replayed repeat times,
+// one mean gap apart so a pass does not start on top of the last query of the previous one
+std::vector<std::chrono::nanoseconds> BuildReplaySchedule(const std::vector<std::chrono::nanoseconds> &offsets, double rate,
+                                                          int repeat, uint64_t seed = 42);
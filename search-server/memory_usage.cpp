@@ -0,0 +1,39 @@
+#include "memory_usage.h"
+
+size_t MemoryStats::GetTotal() const
+{
+    return word_to_document_freqs + ids_to_word_freq + documents + document_ids + storage + word_to_document_ids +
+           status_to_documents + rating_to_documents + impact_postings + fuzzy_index + term_dictionary + positional_index + standing_queries + cold_tier + stop_words;
+}
+
+std::ostream &operator<<(std::ostream &out, const MemoryStats &stats)
+{
+    using namespace std::string_literals;
+    const std::pair<const char *, size_t> structures[] = {
+        {"word_to_document_freqs", stats.word_to_document_freqs},
+        {"ids_to_word_freq", stats.ids_to_word_freq},
+        {"documents", stats.documents},
+        {"document_ids", stats.document_ids},
+        {"storage", stats.storage},
+        {"word_to_document_ids", stats.word_to_document_ids},
+        {"status_to_documents", stats.status_to_documents},
+        {"rating_to_documents", stats.rating_to_documents},
+        {"impact_postings", stats.impact_postings},
+        {"fuzzy_index", stats.fuzzy_index},
+        {"term_dictionary", stats.term_dictionary},
+        {"positional_index", stats.positional_index},
+        {"standing_queries", stats.standing_queries},
+        {"cold_tier", stats.cold_tier},
+        {"stop_words", stats.stop_words},
+    };
+    for (const auto &[name, bytes] : structures)
+    {
+        out << name << ": "s << bytes << " bytes"s << std::endl;
+    }
+    out << "total: "s << stats.GetTotal() << " bytes"s << std::endl;
+    for (const auto &term : stats.largest_terms)
+    {
+        out << "term "s << term.word << ": "s << term.document_count << " documents, "s << term.bytes << " bytes"s << std::endl;
+    }
+    return out;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Allocator that adds up single-object allocations, which are the nodes of node-based containers.
+// Bucket arrays and other buffers are allocated as arrays and are not counted
+template <typename T>
+class NodeSizeProbe
+{
+public:
+    using value_type = T;
+
+    explicit NodeSizeProbe(size_t *node_bytes)
+        : node_bytes_(node_bytes)
+    {
+    }
+
+    template <typename U>
+    NodeSizeProbe(const NodeSizeProbe<U> &other)
+        : node_bytes_(other.node_bytes_)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        if (count == 1)
+        {
+            *node_bytes_ += sizeof(T);
+        }
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T *pointer, size_t count)
+    {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    template <typename U>
+    bool operator==(const NodeSizeProbe<U> &other) const
+    {
+        return node_bytes_ == other.node_bytes_;
+    }
+
+    template <typename U>
+    bool operator!=(const NodeSizeProbe<U> &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    template <typename U>
+    friend class NodeSizeProbe;
+
+    size_t *node_bytes_;
+};
+
+// Bytes std::allocator hands out for one element of std::map<Key, Value, Compare>
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+size_t GetMapNodeSize()
+{
+    static const size_t node_size = []
+    {
+        size_t node_bytes = 0;
+        using Allocator = NodeSizeProbe<std::pair<const Key, Value>>;
+        std::map<Key, Value, Compare, Allocator> probe{Allocator(&node_bytes)};
+        probe.emplace(Key{}, Value{});
+        return node_bytes;
+    }();
+    return node_size;
+}
+
+template <typename Key, typename Compare = std::less<Key>>
+size_t GetSetNodeSize()
+{
+    static const size_t node_size = []
+    {
+        size_t node_bytes = 0;
+        using Allocator = NodeSizeProbe<Key>;
+        std::set<Key, Compare, Allocator> probe{Allocator(&node_bytes)};
+        probe.emplace();
+        return node_bytes;
+    }();
+    return node_size;
+}
+
+template <typename Key, typename Value>
+size_t GetUnorderedMapNodeSize()
+{
+    static const size_t node_size = []
+    {
+        size_t node_bytes = 0;
+        using Allocator = NodeSizeProbe<std::pair<const Key, Value>>;
+        std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>, Allocator> probe{Allocator(&node_bytes)};
+        probe.emplace(Key{}, Value{});
+        return node_bytes;
+    }();
+    return node_size;
+}
+
+template <typename T>
+size_t GetBufferMemory(const std::vector<T> &values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+// Bytes a vector adds to its buffer when it grows by added elements: libstdc++ reallocates
+// to the size plus the larger of the size and the growth
+template <typename T>
+size_t GetBufferGrowth(const std::vector<T> &values, size_t added)
+{
+    if (values.size() + added <= values.capacity())
+    {
+        return 0;
+    }
+    return (values.size() + std::max(values.size(), added) - values.capacity()) * sizeof(T);
+}
+
+// Short strings live inside the object and take no heap memory
+inline size_t GetBufferMemory(const std::string &text)
+{
+    return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+}
+
+// Blocks and block map as libstdc++ lays them out: blocks of 512 bytes, a map of at least 8 pointers
+template <typename T>
+size_t GetDequeMemory(const std::deque<T> &values)
+{
+    const size_t block_size = sizeof(T) < 512 ? 512 / sizeof(T) : 1;
+    const size_t block_count = values.size() / block_size + 1;
+    return block_count * block_size * sizeof(T) + std::max<size_t>(8, block_count + 2) * sizeof(T *);
+}
+
+struct TermMemoryStats
+{
+    std::string_view word;
+    size_t document_count = 0;
+    size_t bytes = 0;
+};
+
+// Bytes requested from the allocator, without the allocator's own per-allocation overhead
+struct MemoryStats
+{
+    size_t word_to_document_freqs = 0;
+    size_t ids_to_word_freq = 0;
+    size_t documents = 0;
+    size_t document_ids = 0;
+    size_t storage = 0;
+    size_t word_to_document_ids = 0;
+    size_t status_to_documents = 0;
+    size_t rating_to_documents = 0;
+    size_t impact_postings = 0;
+    size_t fuzzy_index = 0;
+    // front-coded terms, trigram lists and the terms waiting to be merged
+    size_t term_dictionary = 0;
+    size_t positional_index = 0;
+    // the registered queries and the word to query map
+    size_t standing_queries = 0;
+    // dictionary of the cold terms, the removals, the block cache and the buffered records of the cold tier file
+    size_t cold_tier = 0;
+    size_t stop_words = 0;
+    // every posting structure of the term, largest first
+    std::vector<TermMemoryStats> largest_terms;
+
+    size_t GetTotal() const;
+};
+
+std::ostream &operator<<(std::ostream &out, const MemoryStats &stats);
+
+// AddDocument would grow the index past the memory budget
+class MemoryBudgetExceeded : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
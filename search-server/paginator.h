@@ -1,4 +1,9 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include "document.h"
 
@@ -28,38 +33,98 @@ class IteratorRange  {
     size_t size_;
 }; 
 
+// Pages are built one at a time while iterating; random access iterators find the page end in O(1)
 template <typename Iterator>
-class Paginator  {  
+class Paginator  {
 public:
-    Paginator(Iterator begin, Iterator end, size_t size) {
-        bool isbiggerthensize = 1;
-        auto tempbegin = begin;
-        while (isbiggerthensize) {
-        if (distance(tempbegin, end) <= static_cast <int> (size)) {
-                pages.push_back(IteratorRange<Iterator>{tempbegin, end, static_cast<size_t>(distance(tempbegin, end))});
-                isbiggerthensize = 0;
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator(Iterator page_begin, Iterator end, size_t page_size)
+                :page_begin_(page_begin),
+                 page_end_(page_begin),
+                 end_(end),
+                 page_size_(page_size)
+        {
+            FindPageEnd();
         }
-        else {
-            
-            advance(tempbegin, size);
-            pages.push_back(IteratorRange<Iterator>{begin,tempbegin, size});
 
+        IteratorRange<Iterator> operator*() const {
+            return {page_begin_, page_end_, size_};
         }
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            FindPageEnd();
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator page_begin_;
+        Iterator page_end_;
+        Iterator end_;
+        size_t page_size_;
+        size_t size_ = 0;
+
+        void FindPageEnd() {
+            using Category = typename std::iterator_traits<Iterator>::iterator_category;
+            if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+                size_ = std::min(page_size_, static_cast<size_t>(end_ - page_begin_));
+                page_end_ = page_begin_ + size_;
+            }
+            else {
+                page_end_ = page_begin_;
+                size_ = 0;
+                while (size_ < page_size_ && page_end_ != end_) {
+                    ++page_end_;
+                    ++size_;
+                }
+            }
+        }
+    };
+
+    Paginator(Iterator begin, Iterator end, size_t size)
+                :begin_(begin),
+                 end_(end),
+                 page_size_(size)
+    {
+        using namespace std::string_literals;
+        if (size == 0) {
+            throw std::invalid_argument("Page size must be positive"s);
         }
     }
 
-        auto begin() const {
-        return pages.begin();
+       auto begin() const {
+        return PageIterator(begin_, end_, page_size_);
        }
 
        auto end() const {
-        return pages.end();
+        return PageIterator(end_, end_, page_size_);
        }
 
-    
-
 private:
-std::vector <IteratorRange<Iterator>> pages;
+Iterator begin_;
+Iterator end_;
+size_t page_size_;
 
 };
 
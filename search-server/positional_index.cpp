@@ -0,0 +1,190 @@
+#include "positional_index.h"
+#include "memory_usage.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    void AppendVarint(uint32_t value, std::vector<uint8_t> &out)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+void PositionalIndex::Add(std::string_view word, int document_id, const std::vector<int> &positions)
+{
+    std::vector<uint8_t> encoded;
+    int previous = 0;
+    for (const int position : positions)
+    {
+        AppendVarint(static_cast<uint32_t>(position - previous), encoded);
+        previous = position;
+    }
+
+    auto &postings = word_to_postings_[word];
+    const auto it = std::lower_bound(postings.document_ids.begin(), postings.document_ids.end(), document_id);
+    const auto index = it - postings.document_ids.begin();
+    if (it != postings.document_ids.end() && *it == document_id)
+    {
+        Remove(word, document_id);
+        Add(word, document_id, positions);
+        return;
+    }
+    const uint32_t start = postings.offsets[index];
+    const auto length = static_cast<uint32_t>(encoded.size());
+    postings.positions.insert(postings.positions.begin() + start, encoded.begin(), encoded.end());
+    postings.document_ids.insert(it, document_id);
+    postings.offsets.insert(postings.offsets.begin() + index + 1, start + length);
+    for (auto offset = postings.offsets.begin() + index + 2; offset != postings.offsets.end(); ++offset)
+    {
+        *offset += length;
+    }
+}
+
+void PositionalIndex::Remove(std::string_view word, int document_id)
+{
+    const auto postings_it = word_to_postings_.find(word);
+    if (postings_it == word_to_postings_.end())
+    {
+        return;
+    }
+    auto &postings = postings_it->second;
+    const auto it = std::lower_bound(postings.document_ids.begin(), postings.document_ids.end(), document_id);
+    if (it == postings.document_ids.end() || *it != document_id)
+    {
+        return;
+    }
+    const auto index = it - postings.document_ids.begin();
+    const uint32_t start = postings.offsets[index];
+    const uint32_t length = postings.offsets[index + 1] - start;
+    postings.positions.erase(postings.positions.begin() + start, postings.positions.begin() + start + length);
+    postings.document_ids.erase(it);
+    postings.offsets.erase(postings.offsets.begin() + index + 1);
+    for (auto offset = postings.offsets.begin() + index + 1; offset != postings.offsets.end(); ++offset)
+    {
+        *offset -= length;
+    }
+    if (postings.document_ids.empty())
+    {
+        word_to_postings_.erase(postings_it);
+    }
+}
+
+std::vector<int> PositionalIndex::GetPositions(std::string_view word, int document_id) const
+{
+    const auto postings_it = word_to_postings_.find(word);
+    if (postings_it == word_to_postings_.end())
+    {
+        return {};
+    }
+    const auto &postings = postings_it->second;
+    const auto it = std::lower_bound(postings.document_ids.begin(), postings.document_ids.end(), document_id);
+    if (it == postings.document_ids.end() || *it != document_id)
+    {
+        return {};
+    }
+    const auto index = it - postings.document_ids.begin();
+    std::vector<int> positions;
+    int position = 0;
+    uint32_t gap = 0;
+    int shift = 0;
+    for (uint32_t i = postings.offsets[index]; i < postings.offsets[index + 1]; ++i)
+    {
+        gap |= static_cast<uint32_t>(postings.positions[i] & 0x7F) << shift;
+        shift += 7;
+        if ((postings.positions[i] & 0x80) == 0)
+        {
+            position += static_cast<int>(gap);
+            positions.push_back(position);
+            gap = 0;
+            shift = 0;
+        }
+    }
+    return positions;
+}
+
+size_t PositionalIndex::GetMemoryUsage() const
+{
+    size_t bytes = word_to_postings_.size() * GetMapNodeSize<std::string_view, Postings>();
+    for (const auto &[word, postings] : word_to_postings_)
+    {
+        bytes += GetBufferMemory(postings.document_ids) + GetBufferMemory(postings.offsets) +
+                 GetBufferMemory(postings.positions);
+    }
+    return bytes;
+}
+
+size_t PositionalIndex::EstimateAddMemory(std::string_view word, size_t position_count) const
+{
+    static const Postings new_postings;
+    const auto postings_it = word_to_postings_.find(word);
+    const auto &postings = postings_it == word_to_postings_.end() ? new_postings : postings_it->second;
+    size_t bytes = GetBufferGrowth(postings.document_ids, 1) + GetBufferGrowth(postings.offsets, 1) +
+                   GetBufferGrowth(postings.positions, position_count);
+    if (postings_it == word_to_postings_.end())
+    {
+        bytes += GetMapNodeSize<std::string_view, Postings>() + GetBufferMemory(new_postings.offsets);
+    }
+    return bytes;
+}
+
+bool ContainsPhrase(const std::vector<std::vector<int>> &positions, const std::vector<int> &offsets)
+{
+    if (positions.empty())
+    {
+        return true;
+    }
+    // Anchor on the rarest word and probe the others
+    size_t anchor = 0;
+    for (size_t i = 1; i < positions.size(); ++i)
+    {
+        if (positions[i].size() < positions[anchor].size())
+        {
+            anchor = i;
+        }
+    }
+    for (const int anchor_position : positions[anchor])
+    {
+        const int start = anchor_position - offsets[anchor];
+        bool matches = true;
+        for (size_t i = 0; i < positions.size() && matches; ++i)
+        {
+            matches = i == anchor || std::binary_search(positions[i].begin(), positions[i].end(), start + offsets[i]);
+        }
+        if (matches)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ComputeMinimalSpan(const std::vector<std::vector<int>> &positions)
+{
+    std::vector<size_t> cursors(positions.size(), 0);
+    int best = std::numeric_limits<int>::max();
+    while (true)
+    {
+        size_t lowest = 0;
+        int highest = std::numeric_limits<int>::min();
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            const int position = positions[i][cursors[i]];
+            if (position < positions[lowest][cursors[lowest]])
+            {
+                lowest = i;
+            }
+            highest = std::max(highest, position);
+        }
+        best = std::min(best, highest - positions[lowest][cursors[lowest]]);
+        if (++cursors[lowest] == positions[lowest].size())
+        {
+            return best;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string_view>
+#include <vector>
+
+// Token positions of every word in every document. Positions of one posting are stored
+// as varint-encoded gaps, so a term costs a few bytes per occurrence
+class PositionalIndex
+{
+public:
+    // positions are ascending
+    void Add(std::string_view word, int document_id, const std::vector<int> &positions);
+
+    void Remove(std::string_view word, int document_id);
+
+    // Empty if the word does not occur in the document
+    std::vector<int> GetPositions(std::string_view word, int document_id) const;
+
+    // Heap bytes of the postings
+    size_t GetMemoryUsage() const;
+
+    // Bytes Add(word, ...) allocates for a posting of position_count positions: the buffers that run
+    // out of capacity, about a byte per position since gaps rarely reach 128, and a new term's node
+    size_t EstimateAddMemory(std::string_view word, size_t position_count) const;
+
+private:
+    struct Postings
+    {
+        std::vector<int> document_ids;
+        // positions of document_ids[i] are encoded in positions[offsets[i]..offsets[i + 1])
+        std::vector<uint32_t> offsets{0};
+        std::vector<uint8_t> positions;
+    };
+
+    std::map<std::string_view, Postings> word_to_postings_;
+};
+
+// True if there is a start p such that positions[i] contains p + offsets[i] for every i
+bool ContainsPhrase(const std::vector<std::vector<int>> &positions, const std::vector<int> &offsets);
+
+// Length in tokens, minus one, of the shortest window holding a position from every list.
+// Every list has to be non-empty
+int ComputeMinimalSpan(const std::vector<std::vector<int>> &positions);
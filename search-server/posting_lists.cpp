@@ -0,0 +1,52 @@
+#include "posting_lists.h"
+#include <algorithm>
+#include <cstddef>
+
+std::vector<int>::const_iterator GallopLowerBound(std::vector<int>::const_iterator first,
+                                                  std::vector<int>::const_iterator last, int document_id)
+{
+    if (first == last || *first >= document_id)
+    {
+        return first;
+    }
+    // *(first + bound / 2) is known to be less than document_id
+    std::ptrdiff_t bound = 1;
+    while (bound < last - first && *(first + bound) < document_id)
+    {
+        bound *= 2;
+    }
+    const auto range_end = bound < last - first ? first + bound + 1 : last;
+    return std::lower_bound(first + bound / 2, range_end, document_id);
+}
+
+std::vector<int> IntersectPostingLists(std::vector<const std::vector<int> *> lists)
+{
+    if (lists.empty())
+    {
+        return {};
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto *lhs, const auto *rhs)
+              { return lhs->size() < rhs->size(); });
+
+    std::vector<int> result = *lists.front();
+    for (auto list = lists.begin() + 1; list != lists.end() && !result.empty(); ++list)
+    {
+        auto cursor = (*list)->begin();
+        const auto last = (*list)->end();
+        auto kept = result.begin();
+        for (const int document_id : result)
+        {
+            cursor = GallopLowerBound(cursor, last, document_id);
+            if (cursor == last)
+            {
+                break;
+            }
+            if (*cursor == document_id)
+            {
+                *kept++ = document_id;
+            }
+        }
+        result.erase(kept, result.end());
+    }
+    return result;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <utility>
+#include <vector>
+
+// {document id, term frequency} of one term, sorted by id: what cold lists and wildcard merges are decoded into
+using FlatPostings = std::vector<std::pair<int, double>>;
+
+// Exponential search: first position in [first, last) whose id is not less than document_id.
+// Cheap when the answer is close to first, which is the common case while intersecting
+std::vector<int>::const_iterator GallopLowerBound(std::vector<int>::const_iterator first,
+                                                  std::vector<int>::const_iterator last, int document_id);
+
+// Intersection of sorted id lists, driven from the shortest list to the longest
+std::vector<int> IntersectPostingLists(std::vector<const std::vector<int> *> lists);
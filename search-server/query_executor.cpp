@@ -0,0 +1,124 @@
+#include "query_executor.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t max_queue_size, bool pin_threads)
+    : max_queue_size_(max_queue_size)
+{
+    using namespace std::string_literals;
+    if (thread_count == 0)
+    {
+        throw std::invalid_argument("Thread count must be positive"s);
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        workers_.emplace_back([this]
+                              { WorkerLoop(); });
+#ifdef __linux__
+        if (pin_threads)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#endif
+    }
+}
+
+QueryExecutor::~QueryExecutor()
+{
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+    // whatever is still queued never runs
+    while (!tasks_.empty())
+    {
+        Task task = tasks_.top();
+        tasks_.pop();
+        task.reject(std::make_exception_ptr(QueryRejected("Executor is stopped")));
+    }
+}
+
+size_t QueryExecutor::GetThreadCount() const
+{
+    return workers_.size();
+}
+
+size_t QueryExecutor::GetQueueSize() const
+{
+    std::lock_guard guard(mutex_);
+    return tasks_.size();
+}
+
+void QueryExecutor::Enqueue(Task task)
+{
+    const char *rejection = nullptr;
+    {
+        std::lock_guard guard(mutex_);
+        if (stopping_)
+        {
+            rejection = "Executor is stopped";
+        }
+        else if (tasks_.size() >= max_queue_size_)
+        {
+            rejection = "Query queue is full";
+        }
+        else
+        {
+            task.sequence = next_sequence_++;
+            tasks_.push(std::move(task));
+        }
+    }
+    // the promise is settled outside the lock, its waiters may submit again right away
+    if (rejection != nullptr)
+    {
+        task.reject(std::make_exception_ptr(QueryRejected(rejection)));
+        return;
+    }
+    wake_up_.notify_one();
+}
+
+void QueryExecutor::WorkerLoop()
+{
+    while (true)
+    {
+        std::unique_lock lock(mutex_);
+        wake_up_.wait(lock, [this]
+                      { return stopping_ || !tasks_.empty(); });
+        if (stopping_)
+        {
+            return;
+        }
+        Task task = tasks_.top();
+        tasks_.pop();
+        lock.unlock();
+        Execute(task);
+    }
+}
+
+void QueryExecutor::Execute(Task &task)
+{
+    if (task.cancelled && *task.cancelled)
+    {
+        task.reject(std::make_exception_ptr(QueryRejected("Query is cancelled")));
+    }
+    else if (task.deadline && std::chrono::steady_clock::now() > *task.deadline)
+    {
+        task.reject(std::make_exception_ptr(QueryRejected("Query deadline exceeded")));
+    }
+    else
+    {
+        task.run();
+    }
+}
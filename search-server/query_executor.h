@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct QueryOptions
+{
+    // larger values run first
+    int priority = 0;
+    // a query still queued at its deadline is dropped
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    // setting it to true drops the query if it has not started yet
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+// The future of a query that was shed, cancelled or timed out before it started holds this exception
+class QueryRejected : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Fixed pool of workers sharing one priority queue, so a worker always takes the most urgent query
+// waiting anywhere. Once max_queue_size queries are waiting, new ones are rejected instead of queued
+class QueryExecutor
+{
+public:
+    explicit QueryExecutor(size_t thread_count, size_t max_queue_size = 10000, bool pin_threads = false);
+
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor &) = delete;
+    QueryExecutor &operator=(const QueryExecutor &) = delete;
+
+    template <typename Func>
+    std::future<std::invoke_result_t<Func>> Submit(Func func, const QueryOptions &options);
+
+    size_t GetThreadCount() const;
+
+    size_t GetQueueSize() const;
+
+private:
+    struct Task
+    {
+        int priority;
+        uint64_t sequence;
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::function<void()> run;
+        std::function<void(std::exception_ptr)> reject;
+    };
+
+    struct TaskOrder
+    {
+        bool operator()(const Task &lhs, const Task &rhs) const
+        {
+            if (lhs.priority != rhs.priority)
+            {
+                return lhs.priority < rhs.priority;
+            }
+            return lhs.sequence > rhs.sequence;
+        }
+    };
+
+    const size_t max_queue_size_;
+    std::vector<std::thread> workers_;
+    // guards everything below
+    mutable std::mutex mutex_;
+    std::condition_variable wake_up_;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> tasks_;
+    uint64_t next_sequence_ = 0;
+    bool stopping_ = false;
+
+    void Enqueue(Task task);
+    void WorkerLoop();
+    static void Execute(Task &task);
+};
+
+template <typename Func>
+std::future<std::invoke_result_t<Func>> QueryExecutor::Submit(Func func, const QueryOptions &options)
+{
+    using Result = std::invoke_result_t<Func>;
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto future = promise->get_future();
+
+    Task task;
+    task.priority = options.priority;
+    task.deadline = options.deadline;
+    task.cancelled = options.cancelled;
+    task.run = [promise, func = std::move(func)]() mutable
+    {
+        try
+        {
+            if constexpr (std::is_void_v<Result>)
+            {
+                func();
+                promise->set_value();
+            }
+            else
+            {
+                promise->set_value(func());
+            }
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    };
+    task.reject = [promise](std::exception_ptr error)
+    {
+        promise->set_exception(error);
+    };
+    Enqueue(std::move(task));
+    return future;
+}
@@ -0,0 +1,501 @@
+#include "query_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t MAX_LINE_LENGTH = 1 << 20;
+    const int MAX_EVENTS = 64;
+
+    void ThrowSystemError(const char *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void SetNonBlocking(int fd)
+    {
+        const int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            ThrowSystemError("fcntl");
+        }
+    }
+
+    DocumentStatus ParseStatus(const std::string &name)
+    {
+        using namespace std::string_literals;
+        static const std::map<std::string, DocumentStatus> statuses = {
+            {"ACTUAL"s, DocumentStatus::ACTUAL},
+            {"IRRELEVANT"s, DocumentStatus::IRRELEVANT},
+            {"BANNED"s, DocumentStatus::BANNED},
+            {"REMOVED"s, DocumentStatus::REMOVED},
+        };
+        const auto status = statuses.find(name);
+        if (status == statuses.end())
+        {
+            throw std::invalid_argument("Unknown status "s + name);
+        }
+        return status->second;
+    }
+
+    std::string FormatStatus(DocumentStatus status)
+    {
+        switch (status)
+        {
+        case DocumentStatus::ACTUAL:
+            return "ACTUAL";
+        case DocumentStatus::IRRELEVANT:
+            return "IRRELEVANT";
+        case DocumentStatus::BANNED:
+            return "BANNED";
+        case DocumentStatus::REMOVED:
+            return "REMOVED";
+        }
+        return "UNKNOWN";
+    }
+
+    std::vector<int> ParseRatings(const std::string &text)
+    {
+        std::vector<int> ratings;
+        if (text == "-")
+        {
+            return ratings;
+        }
+        std::istringstream in(text);
+        std::string rating;
+        while (std::getline(in, rating, ','))
+        {
+            ratings.push_back(std::stoi(rating));
+        }
+        return ratings;
+    }
+
+    // Rest of the line after the already extracted tokens, without the separating space
+    std::string ReadRest(std::istringstream &in)
+    {
+        std::string rest;
+        std::getline(in, rest);
+        if (!rest.empty() && rest[0] == ' ')
+        {
+            rest.erase(0, 1);
+        }
+        return rest;
+    }
+
+    bool StartsWith(const std::string &line, const std::string &prefix)
+    {
+        return line.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+std::string FormatDocuments(const std::vector<Document> &documents)
+{
+    std::ostringstream out;
+    out << "OK";
+    for (const auto &document : documents)
+    {
+        out << ' ' << document.id << ' ' << document.relevance << ' ' << document.rating;
+    }
+    return out.str();
+}
+
+QueryServer::QueryServer(SearchServer &search_server, size_t max_batch_size)
+    : search_server_(search_server), max_batch_size_(std::max<size_t>(max_batch_size, 1))
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+    {
+        ThrowSystemError("epoll_create1");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0)
+    {
+        close(epoll_fd_);
+        ThrowSystemError("eventfd");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = stop_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &event);
+}
+
+QueryServer::~QueryServer()
+{
+    for (const auto &[fd, _] : connections_)
+    {
+        close(fd);
+    }
+    for (const int fd : listen_fds_)
+    {
+        close(fd);
+    }
+    for (const auto &path : unix_paths_)
+    {
+        unlink(path.c_str());
+    }
+    close(stop_fd_);
+    close(epoll_fd_);
+}
+
+void QueryServer::ListenTcp(uint16_t port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        ThrowSystemError("socket");
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("bind");
+    }
+    AddListener(fd);
+}
+
+void QueryServer::ListenUnix(const std::string &path)
+{
+    using namespace std::string_literals;
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument("Socket path "s + path + " is too long"s);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        ThrowSystemError("socket");
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("bind");
+    }
+    unix_paths_.push_back(path);
+    AddListener(fd);
+}
+
+void QueryServer::Run()
+{
+    epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running)
+    {
+        const int ready = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+
+        std::vector<Request> requests;
+        std::vector<int> writable;
+        for (int i = 0; i < ready; ++i)
+        {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_)
+            {
+                running = false;
+            }
+            else if (std::find(listen_fds_.begin(), listen_fds_.end(), fd) != listen_fds_.end())
+            {
+                Accept(fd);
+            }
+            else
+            {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                {
+                    ReadRequests(fd, requests);
+                }
+                // Flush closes a connection that hung up once its output is delivered
+                if ((events[i].events & EPOLLOUT) || connections_.at(fd).closed)
+                {
+                    writable.push_back(fd);
+                }
+            }
+        }
+
+        // responses keep the order of requests within every connection
+        const auto responses = ExecuteRequests(requests);
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            auto &connection = connections_.at(requests[i].fd);
+            connection.output += responses[i];
+            connection.output += '\n';
+            writable.push_back(requests[i].fd);
+        }
+
+        std::sort(writable.begin(), writable.end());
+        writable.erase(std::unique(writable.begin(), writable.end()), writable.end());
+        for (const int fd : writable)
+        {
+            Flush(fd);
+        }
+    }
+}
+
+void QueryServer::Stop()
+{
+    const uint64_t value = 1;
+    [[maybe_unused]] const auto written = write(stop_fd_, &value, sizeof(value));
+}
+
+void QueryServer::AddListener(int fd)
+{
+    SetNonBlocking(fd);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        close(fd);
+        ThrowSystemError("epoll_ctl");
+    }
+    listen_fds_.push_back(fd);
+}
+
+void QueryServer::Accept(int listen_fd)
+{
+    while (true)
+    {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            // EAGAIN: the backlog is drained; anything else only affects this one client
+            return;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        connections_[fd];
+    }
+}
+
+void QueryServer::ReadRequests(int fd, std::vector<Request> &requests)
+{
+    auto &connection = connections_.at(fd);
+    char buffer[1 << 16];
+    while (!connection.closed)
+    {
+        const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0)
+        {
+            connection.input.append(buffer, received);
+        }
+        else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            connection.closed = true;
+        }
+        else if (errno != EINTR)
+        {
+            break;
+        }
+    }
+
+    size_t line_start = 0;
+    for (size_t line_end = connection.input.find('\n'); line_end != std::string::npos;
+         line_end = connection.input.find('\n', line_start))
+    {
+        std::string line = connection.input.substr(line_start, line_end - line_start);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        requests.push_back({fd, std::move(line)});
+        line_start = line_end + 1;
+    }
+    connection.input.erase(0, line_start);
+    if (connection.input.size() > MAX_LINE_LENGTH)
+    {
+        connection.input.clear();
+        connection.closed = true;
+    }
+}
+
+void QueryServer::Flush(int fd)
+{
+    const auto connection_it = connections_.find(fd);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    auto &connection = connection_it->second;
+    size_t sent_total = 0;
+    while (sent_total < connection.output.size())
+    {
+        const ssize_t sent = send(fd, connection.output.data() + sent_total, connection.output.size() - sent_total, MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            sent_total += sent;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else
+        {
+            // the peer is gone, nothing left to deliver
+            connection.output.clear();
+            connection.closed = true;
+            sent_total = 0;
+            break;
+        }
+    }
+    connection.output.erase(0, sent_total);
+    if (connection.closed && connection.output.empty())
+    {
+        Close(fd);
+        return;
+    }
+    UpdateEvents(fd);
+}
+
+void QueryServer::Close(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+void QueryServer::UpdateEvents(int fd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | (connections_.at(fd).output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+}
+
+std::vector<std::string> QueryServer::ExecuteRequests(const std::vector<Request> &requests)
+{
+    using namespace std::string_literals;
+    std::vector<std::string> responses(requests.size());
+    std::vector<size_t> batch;
+
+    // the same parallel transform as ProcessQueries, but a bad query only fails its own response
+    auto execute_batch = [&]
+    {
+        std::for_each(std::execution::par, batch.begin(), batch.end(), [&](size_t index)
+                      {
+            try {
+                responses[index] = FormatDocuments(search_server_.FindTopDocuments(std::string_view{requests[index].line}.substr(5)));
+            }
+            catch (const std::exception &e) {
+                responses[index] = "ERR "s + e.what();
+            } });
+        batch.clear();
+    };
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const auto &line = requests[i].line;
+        if (StartsWith(line, "FIND "s))
+        {
+            batch.push_back(i);
+            if (batch.size() >= max_batch_size_)
+            {
+                execute_batch();
+            }
+            continue;
+        }
+        // MATCH does not change the index, the queued queries can still run after it
+        if (!StartsWith(line, "MATCH "s))
+        {
+            execute_batch();
+        }
+        responses[i] = ExecuteRequest(line);
+    }
+    execute_batch();
+    return responses;
+}
+
+std::string QueryServer::ExecuteRequest(const std::string &line)
+{
+    using namespace std::string_literals;
+    try
+    {
+        std::istringstream in(line);
+        std::string command;
+        in >> command;
+        if (command == "MATCH"s)
+        {
+            int document_id = 0;
+            if (!(in >> document_id))
+            {
+                throw std::invalid_argument("Expected document id"s);
+            }
+            const auto query = ReadRest(in);
+            const auto [words, status] = search_server_.MatchDocument(query, document_id);
+            std::string response = "OK "s + FormatStatus(status);
+            for (const auto word : words)
+            {
+                response += ' ';
+                response += word;
+            }
+            return response;
+        }
+        if (command == "ADD"s)
+        {
+            int document_id = 0;
+            std::string status;
+            std::string ratings;
+            if (!(in >> document_id >> status >> ratings))
+            {
+                throw std::invalid_argument("Expected document id, status and ratings"s);
+            }
+            search_server_.AddDocument(document_id, ReadRest(in), ParseStatus(status), ParseRatings(ratings));
+            return "OK"s;
+        }
+        if (command == "REMOVE"s)
+        {
+            int document_id = 0;
+            if (!(in >> document_id))
+            {
+                throw std::invalid_argument("Expected document id"s);
+            }
+            search_server_.RemoveDocument(document_id);
+            return "OK"s;
+        }
+        throw std::invalid_argument("Unknown command "s + command);
+    }
+    catch (const std::exception &e)
+    {
+        return "ERR "s + e.what();
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "search_server.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Line protocol, one request and one response per line:
+//   FIND <query>                              -> OK [<id> <relevance> <rating>]...
+//   MATCH <document_id> <query>               -> OK <status> [<word>]...
+//   ADD <document_id> <status> <r1,r2,...> <text> -> OK
+//   REMOVE <document_id>                      -> OK
+// Errors are answered with ERR <message>. Statuses are spelled as in DocumentStatus.
+//
+// The server is a single-threaded non-blocking epoll loop. The FIND requests that arrive between two
+// mutations run as parallel batches of up to max_batch_size queries; a failing query answers ERR alone.
+// MATCH does not split a batch, ADD and REMOVE do, so every query sees the mutations sent before it
+class QueryServer
+{
+public:
+    explicit QueryServer(SearchServer &search_server, size_t max_batch_size = 256);
+
+    ~QueryServer();
+
+    QueryServer(const QueryServer &) = delete;
+    QueryServer &operator=(const QueryServer &) = delete;
+
+    void ListenTcp(uint16_t port);
+
+    void ListenUnix(const std::string &path);
+
+    // Serves until Stop() is called
+    void Run();
+
+    // Safe to call from any thread
+    void Stop();
+
+private:
+    struct Connection
+    {
+        std::string input;
+        std::string output;
+        bool closed = false;
+    };
+
+    struct Request
+    {
+        int fd;
+        std::string line;
+    };
+
+    SearchServer &search_server_;
+    const size_t max_batch_size_;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    std::vector<int> listen_fds_;
+    std::vector<std::string> unix_paths_;
+    std::map<int, Connection> connections_;
+
+    void AddListener(int fd);
+    void Accept(int listen_fd);
+    void ReadRequests(int fd, std::vector<Request> &requests);
+    void Flush(int fd);
+    void Close(int fd);
+    void UpdateEvents(int fd);
+
+    std::vector<std::string> ExecuteRequests(const std::vector<Request> &requests);
+    std::string ExecuteRequest(const std::string &line);
+};
+
+std::string FormatDocuments(const std::vector<Document> &documents);
@@ -5,6 +5,9 @@
 #include <stdexcept>
 #include <numeric>
 #include <execution>
+#include <iterator>
+#include <limits>
+#include <atomic>
 std::set<int>::iterator SearchServer::begin()
 {
     return document_ids_.begin();
@@ -17,22 +20,44 @@ std::set<int>::iterator SearchServer::end()
 
 const std::map<std::string_view, double> &SearchServer::GetWordFrequencies(int document_id) const
 {
+    thread_local std::map<std::string_view, double> loaded_words;
+    loaded_words.clear();
+    return GetDocumentWords(document_id, loaded_words);
+}
 
-    auto &res = ids_to_word_freq_.at(document_id);
-    return res;
+const std::map<std::string_view, double> &SearchServer::GetDocumentWords(int document_id, std::map<std::string_view, double> &loaded_words) const
+{
+    const auto words = ids_to_word_freq_.find(document_id);
+    if (words != ids_to_word_freq_.end())
+    {
+        return words->second;
+    }
+    const auto document = documents_.find(document_id);
+    if (cold_tier_ && document != documents_.end())
+    {
+        // written in the order of the map, so every word goes to its end
+        for (const auto &[word, term_freq] : cold_tier_->ReadWords(document->second.cold_words))
+        {
+            loaded_words.emplace_hint(loaded_words.end(), GetDictionaryTerm(word), term_freq);
+        }
+    }
+    return loaded_words;
 }
 
 void SearchServer::RemoveDocument(int document_id)
 {
-    auto memb = GetWordFrequencies(document_id);
-    for (auto [word, freq] : memb)
+    if (cold_tier_ && documents_.count(document_id) > 0)
     {
-        word_to_document_freqs_.at(word).erase(document_id);
+        // written first: the postings of the document in the lists written until now are no longer valid
+        cold_removals_[document_id] = cold_tier_->AppendRemoval(document_id);
     }
-    // удаление из словаря documents_
-    documents_.erase(document_id);
-    // удаление из вектора document_ids_
-    document_ids_.erase(document_id);
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+    for (const auto &[word, _] : document_words)
+    {
+        ErasePosting(word, document_id);
+    }
+    RemoveDocumentData(document_id, document_words);
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id)
@@ -42,6 +67,12 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int d
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id)
 {
+    if (cold_tier_)
+    {
+        // the removal record goes first and the counts of the cold terms are shared
+        RemoveDocument(document_id);
+        return;
+    }
     const auto &memb = GetWordFrequencies(document_id);
     std::vector<std::string_view> words(memb.size());
     std::transform(policy, memb.begin(), memb.end(), words.begin(), [](const auto &c)
@@ -50,12 +81,194 @@ void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int do
     auto func = [this, &document_id](const std::string_view word)
     {
         word_to_document_freqs_.at(word).erase(document_id);
+        EraseSortedId(word_to_document_ids_.at(word), document_id);
     };
 
     std::for_each(policy, words.begin(), words.end(), func);
+    hot_posting_count_ -= words.size();
+
+    RemoveDocumentData(document_id, memb);
+}
+
+void SearchServer::RemoveDocument(AutomaticExecutionPolicy, int document_id)
+{
+    size_t postings_to_shift = 0;
+    if (!cold_tier_)
+    {
+        for (const auto &[word, _] : GetWordFrequencies(document_id))
+        {
+            postings_to_shift += word_to_document_ids_.at(word).size();
+        }
+    }
+    if (ExecutionCostModel::Instance().PreferParallel(postings_to_shift))
+    {
+        RemoveDocument(std::execution::par, document_id);
+        return;
+    }
+    RemoveDocument(document_id);
+}
+
+void SearchServer::EraseSortedId(std::vector<int> &document_ids, int document_id)
+{
+    const auto position = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (position != document_ids.end() && *position == document_id)
+    {
+        document_ids.erase(position);
+    }
+}
 
-    documents_.erase(document_id);
+void SearchServer::ErasePosting(const std::string_view word, int document_id)
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    if (postings != word_to_document_freqs_.end() && postings->second.erase(document_id) > 0)
+    {
+        EraseSortedId(word_to_document_ids_.at(word), document_id);
+        --hot_posting_count_;
+        return;
+    }
+    // the posting is in a cold list, where the removal record invalidates it
+    --cold_terms_.at(word).document_count;
+}
+
+void SearchServer::RemoveDocumentData(int document_id, const std::map<std::string_view, double> &document_words)
+{
+    const auto document = documents_.find(document_id);
+    if (document != documents_.end())
+    {
+        if (word_to_impact_postings_)
+        {
+            for (const auto &[word, term_freq] : document_words)
+            {
+                auto &postings = word_to_impact_postings_->at(word);
+                const auto posting = std::lower_bound(postings.begin(), postings.end(), ImpactPosting{term_freq, document->second.rating, document_id},
+                                                      IsHigherImpact);
+                if (posting != postings.end() && posting->document_id == document_id)
+                {
+                    postings.erase(posting);
+                }
+            }
+        }
+        if (positional_index_)
+        {
+            for (const auto &[word, _] : document_words)
+            {
+                positional_index_->Remove(word, document_id);
+            }
+        }
+        for (const auto &[word, _] : document_words)
+        {
+            term_dictionary_.RemoveDocument(word);
+        }
+        if (fuzzy_index_)
+        {
+            // a term without documents is no longer offered as a correction
+            for (const auto &[word, _] : document_words)
+            {
+                if (GetDocumentFreq(word) == 0)
+                {
+                    fuzzy_index_->RemoveTerm(word);
+                }
+            }
+        }
+        // storage and the dictionary keep their entries
+        estimated_memory_usage_ -= std::min(estimated_memory_usage_, document->second.accounted_memory);
+        status_to_documents_[document->second.status].Erase(document_id);
+        rating_to_documents_.erase({document->second.rating, document_id});
+        // удаление из словаря documents_
+        documents_.erase(document);
+    }
+    // удаление из вектора document_ids_
     document_ids_.erase(document_id);
+    ids_to_word_freq_.erase(document_id);
+    index_version_ = NextIndexVersion();
+}
+
+size_t SearchServer::GetDocumentFreq(const std::string_view word) const
+{
+    size_t document_freq = 0;
+    const auto postings = word_to_document_freqs_.find(word);
+    if (postings != word_to_document_freqs_.end())
+    {
+        document_freq = postings->second.size();
+    }
+    const auto cold_term = cold_terms_.find(word);
+    if (cold_term != cold_terms_.end())
+    {
+        document_freq += cold_term->second.document_count;
+    }
+    return document_freq;
+}
+
+const std::map<int, double> *SearchServer::GetPostings(const std::string_view word, FlatPostings &loaded_postings) const
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    const auto cold_term = cold_terms_.find(word);
+    if (cold_term == cold_terms_.end())
+    {
+        return postings == word_to_document_freqs_.end() ? nullptr : &postings->second;
+    }
+    for (const auto &list : cold_term->second.lists)
+    {
+        ReadColdList(list, loaded_postings);
+    }
+    // the documents added since the last flush
+    if (postings != word_to_document_freqs_.end())
+    {
+        const auto hot_begin = static_cast<std::ptrdiff_t>(loaded_postings.size());
+        loaded_postings.insert(loaded_postings.end(), postings->second.begin(), postings->second.end());
+        std::inplace_merge(loaded_postings.begin(), loaded_postings.begin() + hot_begin, loaded_postings.end(), IsLowerId);
+    }
+    return nullptr;
+}
+
+void SearchServer::ReadColdList(const ColdTierFile::Extent &list, FlatPostings &postings) const
+{
+    const auto list_begin = static_cast<std::ptrdiff_t>(postings.size());
+    for (const auto &posting : cold_tier_->ReadPostings(list))
+    {
+        const auto removal = cold_removals_.find(posting.first);
+        if (removal == cold_removals_.end() || removal->second < list.offset)
+        {
+            postings.push_back(posting);
+        }
+    }
+    std::inplace_merge(postings.begin(), postings.begin() + list_begin, postings.end(), IsLowerId);
+}
+
+bool SearchServer::IsLowerId(const std::pair<int, double> &lhs, const std::pair<int, double> &rhs)
+{
+    return lhs.first < rhs.first;
+}
+
+const double *SearchServer::FindTermFreq(const std::map<int, double> &postings, int document_id)
+{
+    const auto posting = postings.find(document_id);
+    return posting == postings.end() ? nullptr : &posting->second;
+}
+
+const double *SearchServer::FindTermFreq(const FlatPostings &postings, int document_id)
+{
+    const auto posting = std::lower_bound(postings.begin(), postings.end(), std::pair<int, double>{document_id, 0.0}, IsLowerId);
+    return posting == postings.end() || posting->first != document_id ? nullptr : &posting->second;
+}
+
+bool SearchServer::IsHigherImpact(const ImpactPosting &lhs, const ImpactPosting &rhs)
+{
+    if (lhs.term_freq != rhs.term_freq)
+    {
+        return lhs.term_freq > rhs.term_freq;
+    }
+    if (lhs.rating != rhs.rating)
+    {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.document_id < rhs.document_id;
+}
+
+uint64_t SearchServer::NextIndexVersion()
+{
+    static std::atomic<uint64_t> last_version = 0;
+    return ++last_version;
 }
 
 SearchServer::SearchServer(const std::string &stop_words_text)
@@ -88,40 +301,140 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
     {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    storage.emplace_back(document);
-    auto words = SplitIntoWordsNoStop(storage.back());
+    // with the cold tier the text goes to its file and storage only gets the new terms
+    std::string_view text = document;
+    size_t storage_memory = 0;
+    if (!cold_tier_)
+    {
+        text = storage.emplace_back(document);
+        storage_memory = sizeof(std::string) + GetBufferMemory(storage.back());
+    }
+    auto words = SplitIntoWordsNoStop(text);
+    size_t buffer_growth = 0;
+    if (memory_budget_ > 0)
+    {
+        std::vector<std::string_view> sorted_words = words;
+        std::sort(sorted_words.begin(), sorted_words.end());
+        size_t unique_word_count = 0;
+        std::vector<std::string_view> new_terms;
+        for (auto word = sorted_words.begin(); word != sorted_words.end();)
+        {
+            const auto next_word = std::upper_bound(word, sorted_words.end(), *word);
+            ++unique_word_count;
+            if (word_to_document_freqs_.count(*word) == 0)
+            {
+                new_terms.push_back(*word);
+            }
+            buffer_growth += EstimateBufferGrowth(*word, next_word - word);
+            word = next_word;
+        }
+        if (estimated_memory_usage_ + storage_memory + EstimateDocumentMemory(unique_word_count, new_terms) + buffer_growth > memory_budget_)
+        {
+            if (!cold_tier_)
+            {
+                storage.pop_back();
+            }
+            throw MemoryBudgetExceeded("Document "s + std::to_string(document_id) + " does not fit into the memory budget"s);
+        }
+    }
 
     const double inv_word_count = 1.0 / words.size();
+    std::map<std::string_view, double> document_words;
     for (const auto word : words)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        ids_to_word_freq_[document_id][word] += inv_word_count;
+        document_words[word] += inv_word_count;
+    }
+    const int rating = ComputeAverageRating(ratings);
+    ColdTierFile::Record cold_record;
+    if (cold_tier_)
+    {
+        // the words point into the caller's text, which is not kept
+        std::map<std::string_view, double> stored_words;
+        for (const auto &[word, term_freq] : document_words)
+        {
+            stored_words.emplace_hint(stored_words.end(), GetStoredTerm(word), term_freq);
+        }
+        document_words = std::move(stored_words);
+        // written before the index changes, so a failed write leaves the document out of both
+        cold_record = cold_tier_->AppendDocument(document_id, rating, status, document_words, document);
+    }
+    std::vector<std::string_view> new_terms;
+    for (const auto &[word, term_freq] : document_words)
+    {
+        auto [postings, inserted] = word_to_document_freqs_.try_emplace(word);
+        if (inserted)
+        {
+            new_terms.push_back(postings->first);
+        }
+        if (fuzzy_index_ && GetDocumentFreq(word) == 0)
+        {
+            // a new term, or one whose documents were all removed
+            fuzzy_index_->AddTerm(postings->first);
+        }
+        postings->second.emplace(document_id, term_freq);
+        ++hot_posting_count_;
+        term_dictionary_.AddDocument(word);
+        auto &document_ids = word_to_document_ids_[word];
+        document_ids.insert(std::upper_bound(document_ids.begin(), document_ids.end(), document_id), document_id);
     }
 
-    documents_.emplace(document_id, SearchServer::DocumentData{ComputeAverageRating(ratings), status});
+    if (word_to_impact_postings_)
+    {
+        for (const auto &[word, term_freq] : document_words)
+        {
+            auto &postings = (*word_to_impact_postings_)[word];
+            const ImpactPosting posting{term_freq, rating, document_id};
+            postings.insert(std::upper_bound(postings.begin(), postings.end(), posting, IsHigherImpact), posting);
+        }
+    }
+    if (positional_index_)
+    {
+        AddDocumentPositions(document_id, text);
+    }
+    // the dictionary keeps new terms after the document is gone, so only the rest is given back on removal
+    const size_t unique_word_count = document_words.size();
+    const size_t document_memory = EstimateDocumentMemory(unique_word_count, {});
+    documents_.emplace(document_id, SearchServer::DocumentData{rating, status, cold_tier_ ? std::string_view{} : text, document_memory,
+                                                               cold_record.words, cold_record.text});
+    if (!cold_tier_)
+    {
+        ids_to_word_freq_.emplace(document_id, std::move(document_words));
+    }
     document_ids_.insert(document_id);
+    status_to_documents_[status].Insert(document_id);
+    rating_to_documents_.insert({rating, document_id});
+    index_version_ = NextIndexVersion();
+    if (cold_tier_)
+    {
+        SpillHotPostings();
+    }
+
+    estimated_memory_usage_ += storage_memory + EstimateDocumentMemory(unique_word_count, new_terms) + buffer_growth;
+    if (memory_stats_dump_ && std::chrono::steady_clock::now() - memory_stats_dump_->last_dump >= memory_stats_dump_->period)
+    {
+        *memory_stats_dump_->out << GetMemoryStats();
+        memory_stats_dump_->last_dump = std::chrono::steady_clock::now();
+    }
+    if (!standing_queries_.empty())
+    {
+        NotifyStandingQueries(document_id);
+    }
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentStatus status) const
 {
-    return SearchServer::FindTopDocuments(policy,
-                                          raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                                          { return document_status == status; });
+    return SearchServer::FindTopDocuments(policy, raw_query, AnyDocument{}, &GetDocumentsWithStatus(status));
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentStatus status) const
 {
-    return SearchServer::FindTopDocuments(policy,
-                                          raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                                          { return document_status == status; });
+    return SearchServer::FindTopDocuments(policy, raw_query, AnyDocument{}, &GetDocumentsWithStatus(status));
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const
 {
     std::execution::sequenced_policy policy;
-    return SearchServer::FindTopDocuments(policy,
-                                          raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                                          { return document_status == status; });
+    return SearchServer::FindTopDocuments(policy, raw_query, status);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const
@@ -140,175 +453,1006 @@ std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_po
     return SearchServer::FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-int SearchServer::GetDocumentCount() const
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentStatus status,
+                                                     int min_rating, int max_rating) const
 {
-    return documents_.size();
+    return FindTopDocumentsWithRating(policy, ParseQuery(raw_query), status, min_rating, max_rating);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query,
-                                                                                      int document_id) const
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentStatus status,
+                                                     int min_rating, int max_rating) const
 {
+    return FindTopDocumentsWithRating(policy, ParseQuery(raw_query), status, min_rating, max_rating);
+}
 
-    const auto query = SearchServer::ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const
+{
+    std::execution::sequenced_policy policy;
+    return SearchServer::FindTopDocuments(policy, raw_query, status, min_rating, max_rating);
+}
 
-    std::vector<std::string_view> matched_words;
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy, const std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocumentsAutomatic(raw_query, AnyDocument{}, &GetDocumentsWithStatus(status));
+}
 
-    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), [=](auto minus_word)
-                    {
-        if (word_to_document_freqs_.count(minus_word)) {
-            return word_to_document_freqs_.at(minus_word).count(document_id) != 0;
-        }
-        else {
-            return false;
-        } }))
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy, const std::string_view raw_query, DocumentStatus status,
+                                                     int min_rating, int max_rating) const
+{
+    const auto query = ParseQuery(raw_query);
+    const size_t partition_count = ExecutionCostModel::Instance().ChooseParallelism(EstimateQueryCost(query, &GetDocumentsWithStatus(status)));
+    if (partition_count > 1)
     {
-        return {matched_words, documents_.at(document_id).status};
+        auto policy = std::execution::par;
+        return FindTopDocumentsWithRating(policy, query, status, min_rating, max_rating, partition_count);
     }
+    auto policy = std::execution::seq;
+    return FindTopDocumentsWithRating(policy, query, status, min_rating, max_rating);
+}
 
-    for (const auto word : query.plus_words)
-    {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id))
-        {
-            matched_words.push_back(word);
-        }
-    }
-    return {matched_words, documents_.at(document_id).status};
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy policy, const std::string_view raw_query) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query,
-                                                                                      int document_id) const
+SearchServer::PreparedQuery::PreparedQuery(std::shared_ptr<const PreparedQueryState> state)
+    : binding_(std::make_shared<Binding>(Binding{state->raw_query, state}))
 {
-    return MatchDocument(raw_query, document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
-                                                                                      int document_id) const
+const std::string &SearchServer::PreparedQuery::GetRawQuery() const
 {
-    const auto query = SearchServer::ParseQueryWithoutDeleteCopyes(raw_query);
+    return binding_->raw_query;
+}
 
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+SearchServer::PreparedQuery SearchServer::PrepareQuery(const std::string_view raw_query) const
+{
+    auto state = std::make_shared<PreparedQueryState>();
+    state->raw_query = std::string(raw_query);
+    state->query = ParseQuery(state->raw_query);
+    state->resolved_query = ResolveQuery(state->query, nullptr);
+    // sized for an unfiltered run; with a filter the strategy may be worse, the result is the same
+    state->excluded_documents = ResolveMinusWords(state->query, CountCandidatePostings(state->resolved_query, nullptr));
+    state->index_version = index_version_;
+    return PreparedQuery(std::move(state));
+}
 
-    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [=](auto minus_word)
-                    {
-        if (word_to_document_freqs_.count(minus_word)) {
-            return word_to_document_freqs_.at(minus_word).count(document_id) != 0;
-        }
-        else {
-            return false;
-        } }))
+std::shared_ptr<const SearchServer::PreparedQueryState> SearchServer::GetPreparedQueryState(const PreparedQuery &prepared_query) const
+{
+    auto &binding = *prepared_query.binding_;
+    auto state = std::atomic_load(&binding.state);
+    if (state->index_version != index_version_)
     {
-        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+        // runs racing here all bind it, the last store wins and every one of them is current
+        state = PrepareQuery(binding.raw_query).binding_->state;
+        std::atomic_store(&binding.state, state);
     }
+    return state;
+}
 
-    auto last1 = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [=](auto plus_word)
-                              {
-        if (word_to_document_freqs_.count(plus_word)) {
-        return word_to_document_freqs_.at(plus_word).count(document_id)!= 0;
-        }
-        else {
-            return false;
-        } });
-
-    std::sort(matched_words.begin(), last1);
-    auto last2 = std::unique(matched_words.begin(), last1);
-    matched_words.erase(last2, matched_words.end());
+bool SearchServer::IsPreparedQueryCurrent(const PreparedQuery &prepared_query) const
+{
+    return std::atomic_load(&prepared_query.binding_->state)->index_version == index_version_;
+}
 
-    return {matched_words, documents_.at(document_id).status};
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const PreparedQuery &prepared_query, DocumentStatus status) const
+{
+    return SearchServer::FindTopDocuments(policy, *GetPreparedQueryState(prepared_query), AnyDocument{}, &GetDocumentsWithStatus(status));
 }
 
-bool SearchServer::IsStopWord(const std::string_view word) const
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const PreparedQuery &prepared_query, DocumentStatus status) const
 {
-    return stop_words_.count(word) > 0;
+    return SearchServer::FindTopDocuments(policy, *GetPreparedQueryState(prepared_query), AnyDocument{}, &GetDocumentsWithStatus(status));
 }
 
-bool SearchServer::IsValidWord(const std::string_view word)
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query, DocumentStatus status) const
 {
-    // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](char c)
-                        { return c >= '\0' && c < ' '; });
+    std::execution::sequenced_policy policy;
+    return SearchServer::FindTopDocuments(policy, prepared_query, status);
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query) const
 {
-    std::vector<std::string_view> words;
-    using namespace std::string_literals;
-    for (const auto word : SplitIntoWords(text))
-    {
-        if (!IsValidWord(word))
-        {
-            throw std::invalid_argument("Word "s + std::string{word} + " is invalid"s);
-        }
-        if (!IsStopWord(word))
-        {
-            words.push_back(word);
-        }
-    }
-    return words;
+    return SearchServer::FindTopDocuments(prepared_query, DocumentStatus::ACTUAL);
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int> &ratings)
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy, const PreparedQuery &prepared_query, DocumentStatus status) const
 {
-    if (ratings.empty())
-    {
-        return 0;
-    }
-    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
+    return FindTopDocumentsAutomatic(prepared_query, AnyDocument{}, &GetDocumentsWithStatus(status));
+}
 
-    return rating_sum / static_cast<int>(ratings.size());
+DocumentPage SearchServer::FindDocumentsPage(const std::string_view raw_query, DocumentStatus status,
+                                             const std::optional<SearchCursor> &cursor, size_t page_size) const
+{
+    std::execution::sequenced_policy policy;
+    return FindDocumentsPage(policy, raw_query, AnyDocument{}, &GetDocumentsWithStatus(status), cursor, page_size);
 }
 
-struct SearchServer::QueryWord
+DocumentPage SearchServer::FindDocumentsPage(const std::string_view raw_query, const std::optional<SearchCursor> &cursor, size_t page_size) const
 {
-    std::string_view data;
-    bool is_minus;
-    bool is_stop;
-};
+    return FindDocumentsPage(raw_query, DocumentStatus::ACTUAL, cursor, page_size);
+}
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text) const
+bool SearchServer::IsRankedHigher(const Document &lhs, const Document &rhs)
 {
-    using namespace std::string_literals;
-    if (text.empty())
+    if (std::abs(lhs.relevance - rhs.relevance) >= DIFF)
     {
-        throw std::invalid_argument("Query word is empty"s);
+        return lhs.relevance > rhs.relevance;
     }
-    auto word = text;
-    bool is_minus = false;
-    if (word[0] == '-')
+    if (lhs.rating != rhs.rating)
     {
-        is_minus = true;
-        word = word.substr(1);
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+size_t SearchServer::EstimateQueryCost(const Query &query, const DocumentBitmap *document_filter) const
+{
+    size_t cost = 0;
+    for (const auto word : query.plus_words)
+    {
+        if (IsWildcard(word))
+        {
+            cost += documents_.size();
+            continue;
+        }
+        cost += GetDocumentFreq(word);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word))
+    if (document_filter != nullptr)
     {
-        throw std::invalid_argument("Query word "s + std::string{text} + " is invalid");
+        cost = std::min(cost, document_filter->Size() * query.plus_words.size());
     }
+    return cost;
+}
 
-    return {word, is_minus, IsStopWord(word)};
+const DocumentBitmap &SearchServer::GetDocumentsWithStatus(DocumentStatus status) const
+{
+    static const DocumentBitmap empty_bitmap;
+    const auto documents = status_to_documents_.find(status);
+    return documents == status_to_documents_.end() ? empty_bitmap : documents->second;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
+// Both bounds are inclusive
+std::optional<DocumentBitmap> SearchServer::GetDocumentsWithRating(int min_rating, int max_rating, size_t max_size) const
 {
-    SearchServer::Query query;
-    for (const auto word : SplitIntoWords(text))
+    DocumentBitmap result;
+    if (min_rating > max_rating)
     {
-        const auto query_word = SearchServer::ParseQueryWord(word);
-        if (!query_word.is_stop)
+        return result;
+    }
+    const auto first = rating_to_documents_.lower_bound({min_rating, std::numeric_limits<int>::min()});
+    const auto last = rating_to_documents_.upper_bound({max_rating, std::numeric_limits<int>::max()});
+    for (auto it = first; it != last; ++it)
+    {
+        if (result.Size() == max_size)
         {
-            if (query_word.is_minus)
-            {
-                query.minus_words.push_back(query_word.data);
-            }
-            else
-            {
-                query.plus_words.push_back(query_word.data);
-            }
+            return std::nullopt;
         }
+        result.Insert(it->second);
     }
-    std::sort(query.plus_words.begin(), query.plus_words.end());
+    return result;
+}
+
+size_t SearchServer::EstimateDocumentMemory(size_t unique_word_count, const std::vector<std::string_view> &new_terms) const
+{
+    const size_t word_memory = GetMapNodeSize<std::string_view, double>() + GetMapNodeSize<int, double>();
+    size_t term_memory = GetMapNodeSize<std::string_view, std::map<int, double>>() + GetMapNodeSize<std::string_view, std::vector<int>>();
+    if (word_to_impact_postings_)
+    {
+        term_memory += GetMapNodeSize<std::string_view, std::vector<ImpactPosting>>();
+    }
+    return GetMapNodeSize<int, DocumentData>() + GetSetNodeSize<int>() + GetSetNodeSize<std::pair<int, int>>() +
+           GetMapNodeSize<int, std::map<std::string_view, double>>() + unique_word_count * word_memory + new_terms.size() * term_memory;
+}
+
+size_t SearchServer::EstimateBufferGrowth(std::string_view word, size_t occurrence_count) const
+{
+    static const std::vector<int> no_document_ids;
+    const auto document_ids = word_to_document_ids_.find(word);
+    size_t bytes = GetBufferGrowth(document_ids == word_to_document_ids_.end() ? no_document_ids : document_ids->second, 1);
+    if (word_to_impact_postings_)
+    {
+        static const std::vector<ImpactPosting> no_postings;
+        const auto postings = word_to_impact_postings_->find(word);
+        bytes += GetBufferGrowth(postings == word_to_impact_postings_->end() ? no_postings : postings->second, 1);
+    }
+    if (positional_index_)
+    {
+        bytes += positional_index_->EstimateAddMemory(word, occurrence_count);
+    }
+    if (GetDocumentFreq(word) == 0)
+    {
+        // a term without documents may have left the term dictionary, and it enters the fuzzy index
+        // with every deletion of up to max_edit_distance characters
+        bytes += term_dictionary_.EstimateTermMemory(word);
+        if (fuzzy_index_)
+        {
+            bytes += fuzzy_index_->EstimateTermMemory(word);
+        }
+    }
+    return bytes;
+}
+
+MemoryStats SearchServer::GetMemoryStats(size_t top_term_count) const
+{
+    MemoryStats stats;
+    std::vector<TermMemoryStats> terms;
+    stats.word_to_document_freqs = word_to_document_freqs_.size() * GetMapNodeSize<std::string_view, std::map<int, double>>();
+    for (const auto &[word, postings] : word_to_document_freqs_)
+    {
+        const size_t postings_memory = postings.size() * GetMapNodeSize<int, double>();
+        stats.word_to_document_freqs += postings_memory;
+        terms.push_back({word, postings.size(), postings_memory + GetBufferMemory(word_to_document_ids_.at(word))});
+    }
+
+    stats.ids_to_word_freq = ids_to_word_freq_.size() * GetMapNodeSize<int, std::map<std::string_view, double>>();
+    for (const auto &[_, word_freqs] : ids_to_word_freq_)
+    {
+        stats.ids_to_word_freq += word_freqs.size() * GetMapNodeSize<std::string_view, double>();
+    }
+
+    stats.documents = documents_.size() * GetMapNodeSize<int, DocumentData>();
+    stats.document_ids = document_ids_.size() * GetSetNodeSize<int>();
+
+    stats.storage = GetDequeMemory(storage);
+    for (const auto &text : storage)
+    {
+        stats.storage += GetBufferMemory(text);
+    }
+
+    stats.word_to_document_ids = word_to_document_ids_.size() * GetMapNodeSize<std::string_view, std::vector<int>>();
+    for (const auto &[_, document_ids] : word_to_document_ids_)
+    {
+        stats.word_to_document_ids += GetBufferMemory(document_ids);
+    }
+
+    stats.status_to_documents = status_to_documents_.size() * GetMapNodeSize<DocumentStatus, DocumentBitmap>();
+    for (const auto &[_, documents] : status_to_documents_)
+    {
+        stats.status_to_documents += documents.GetMemoryUsage();
+    }
+    stats.rating_to_documents = rating_to_documents_.size() * GetSetNodeSize<std::pair<int, int>>();
+
+    if (word_to_impact_postings_)
+    {
+        stats.impact_postings = word_to_impact_postings_->size() * GetMapNodeSize<std::string_view, std::vector<ImpactPosting>>();
+        for (auto &term : terms)
+        {
+            const auto postings = word_to_impact_postings_->find(term.word);
+            if (postings != word_to_impact_postings_->end())
+            {
+                stats.impact_postings += GetBufferMemory(postings->second);
+                term.bytes += GetBufferMemory(postings->second);
+            }
+        }
+    }
+    if (fuzzy_index_)
+    {
+        stats.fuzzy_index = fuzzy_index_->GetMemoryUsage();
+    }
+    if (positional_index_)
+    {
+        stats.positional_index = positional_index_->GetMemoryUsage();
+    }
+    stats.standing_queries = standing_queries_.size() * GetMapNodeSize<int, StandingQuery>() +
+                             word_to_standing_queries_.size() * GetMapNodeSize<std::string, std::vector<int>, std::less<>>();
+    for (const auto &[_, standing_query] : standing_queries_)
+    {
+        const auto &query = standing_query.query;
+        stats.standing_queries += GetBufferMemory(standing_query.raw_query) + GetBufferMemory(query.plus_words) +
+                                  GetBufferMemory(query.minus_words) + GetBufferMemory(query.required_words) +
+                                  GetBufferMemory(query.phrases) + GetBufferMemory(standing_query.keys);
+        for (const auto &phrase : query.phrases)
+        {
+            stats.standing_queries += GetBufferMemory(phrase);
+        }
+        for (const auto &key : standing_query.keys)
+        {
+            stats.standing_queries += GetBufferMemory(key);
+        }
+    }
+    for (const auto &[word, query_ids] : word_to_standing_queries_)
+    {
+        stats.standing_queries += GetBufferMemory(word) + GetBufferMemory(query_ids);
+    }
+    stats.term_dictionary = term_dictionary_.GetMemoryUsage();
+    if (cold_tier_)
+    {
+        stats.cold_tier = cold_terms_.size() * GetMapNodeSize<std::string_view, ColdTerm>() +
+                          cold_removals_.size() * GetMapNodeSize<int, uint64_t>() + cold_tier_->GetMemoryUsage();
+        for (const auto &[_, cold_term] : cold_terms_)
+        {
+            stats.cold_tier += GetBufferMemory(cold_term.lists);
+        }
+    }
+
+    stats.stop_words = stop_words_.size() * GetSetNodeSize<std::string, std::less<>>();
+    for (const auto &stop_word : stop_words_)
+    {
+        stats.stop_words += GetBufferMemory(stop_word);
+    }
+
+    const auto top_end = terms.begin() + std::min(top_term_count, terms.size());
+    std::partial_sort(terms.begin(), top_end, terms.end(), [](const TermMemoryStats &lhs, const TermMemoryStats &rhs)
+                      { return lhs.bytes > rhs.bytes; });
+    terms.erase(top_end, terms.end());
+    stats.largest_terms = std::move(terms);
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t max_bytes)
+{
+    memory_budget_ = max_bytes;
+    estimated_memory_usage_ = GetMemoryStats(0).GetTotal();
+}
+
+void SearchServer::EnableMemoryStatsDump(std::chrono::seconds period, std::ostream &out)
+{
+    memory_stats_dump_ = MemoryStatsDump{period, &out, std::chrono::steady_clock::now()};
+}
+
+int SearchServer::GetDocumentCount() const
+{
+    return documents_.size();
+}
+
+void SearchServer::ConfigureExecutor(size_t thread_count, size_t max_queue_size, bool pin_threads)
+{
+    executor_ = std::make_unique<QueryExecutor>(thread_count, max_queue_size, pin_threads);
+}
+
+std::future<std::vector<Document>> SearchServer::FindTopDocumentsAsync(const std::string &raw_query, DocumentStatus status,
+                                                                       const QueryOptions &options) const
+{
+    return GetExecutor().Submit([this, raw_query, status]
+                                { return FindTopDocuments(raw_query, status); },
+                                options);
+}
+
+QueryExecutor &SearchServer::GetExecutor() const
+{
+    using namespace std::string_literals;
+    if (!executor_)
+    {
+        throw std::logic_error("Executor is not configured, call ConfigureExecutor first"s);
+    }
+    return *executor_;
+}
+
+void SearchServer::EnableFuzzySearch(int max_edit_distance)
+{
+    using namespace std::string_literals;
+    if (max_edit_distance < 1 || max_edit_distance > 2)
+    {
+        throw std::invalid_argument("Max edit distance must be 1 or 2"s);
+    }
+    fuzzy_index_.emplace(max_edit_distance);
+    for (const auto &[word, _] : word_to_document_freqs_)
+    {
+        if (GetDocumentFreq(word) > 0)
+        {
+            fuzzy_index_->AddTerm(word);
+        }
+    }
+    for (const auto &[word, cold_term] : cold_terms_)
+    {
+        if (cold_term.document_count > 0 && word_to_document_freqs_.count(word) == 0)
+        {
+            fuzzy_index_->AddTerm(word);
+        }
+    }
+    // prepared queries were parsed without corrections
+    index_version_ = NextIndexVersion();
+}
+
+void SearchServer::EnablePositionalIndex()
+{
+    using namespace std::string_literals;
+    if (cold_tier_)
+    {
+        throw std::logic_error("The positional index cannot be enabled together with the cold tier"s);
+    }
+    positional_index_.emplace();
+    for (const auto &[document_id, document] : documents_)
+    {
+        AddDocumentPositions(document_id, document.text);
+    }
+}
+
+void SearchServer::AddDocumentPositions(int document_id, const std::string_view text)
+{
+    std::map<std::string_view, std::vector<int>> word_to_positions;
+    int position = 0;
+    for (const auto word : SplitIntoWords(text))
+    {
+        if (!IsStopWord(word))
+        {
+            word_to_positions[word].push_back(position);
+        }
+        ++position;
+    }
+    for (const auto &[word, positions] : word_to_positions)
+    {
+        positional_index_->Add(word, document_id, positions);
+    }
+}
+
+bool SearchServer::ContainsQueryPhrases(const Query &query, int document_id) const
+{
+    for (const auto &phrase : query.phrases)
+    {
+        std::vector<std::vector<int>> positions;
+        std::vector<int> offsets;
+        for (const auto &[word, offset] : phrase)
+        {
+            positions.push_back(positional_index_->GetPositions(word, document_id));
+            offsets.push_back(offset);
+        }
+        if (!ContainsPhrase(positions, offsets))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SearchServer::HasProximityBoost(const Query &query) const
+{
+    return positional_index_ && std::set<std::string_view>(query.required_words.begin(), query.required_words.end()).size() > 1 &&
+           std::none_of(query.required_words.begin(), query.required_words.end(), IsWildcard);
+}
+
+double SearchServer::ComputeProximityBoost(const Query &query, int document_id) const
+{
+    if (!HasProximityBoost(query))
+    {
+        return 1.0;
+    }
+    // a word required twice would count twice in k but not widen the span, and push the boost past 1 + PROXIMITY_WEIGHT
+    std::vector<std::vector<int>> positions;
+    for (const auto word : std::set<std::string_view>(query.required_words.begin(), query.required_words.end()))
+    {
+        positions.push_back(positional_index_->GetPositions(word, document_id));
+        if (positions.back().empty())
+        {
+            return 1.0;
+        }
+    }
+    const auto span = ComputeMinimalSpan(positions);
+    return 1.0 + PROXIMITY_WEIGHT * (positions.size() - 1) / std::max(span, 1);
+}
+
+void SearchServer::EnableColdTier(const std::string &path, size_t hot_postings_bytes, size_t cache_bytes)
+{
+    using namespace std::string_literals;
+    if (cold_tier_ || !documents_.empty())
+    {
+        throw std::logic_error("The cold tier is enabled once, before any document is added"s);
+    }
+    // their copies of the postings would stay in memory and defeat the budget
+    if (word_to_impact_postings_ || positional_index_)
+    {
+        throw std::logic_error("The cold tier cannot be enabled together with impact-ordered postings or the positional index"s);
+    }
+    cold_tier_ = std::make_unique<ColdTierFile>(path, cache_bytes);
+    hot_postings_bytes_ = hot_postings_bytes;
+    try
+    {
+        ReplayColdTier();
+    }
+    catch (...)
+    {
+        // back to the empty server it was called on
+        documents_.clear();
+        document_ids_.clear();
+        status_to_documents_.clear();
+        rating_to_documents_.clear();
+        word_to_document_freqs_.clear();
+        word_to_document_ids_.clear();
+        cold_terms_.clear();
+        cold_removals_.clear();
+        hot_posting_count_ = 0;
+        term_dictionary_ = TermDictionary{};
+        if (fuzzy_index_)
+        {
+            fuzzy_index_.emplace(fuzzy_index_->GetMaxEditDistance());
+        }
+        cold_tier_.reset();
+        throw;
+    }
+    index_version_ = NextIndexVersion();
+}
+
+void SearchServer::ReplayColdTier()
+{
+    std::map<int, ColdTierFile::Record> documents; // the latest record of every document not removed since
+    cold_tier_->Replay([&](const ColdTierFile::Record &record)
+                       {
+        switch (record.type)
+        {
+        case ColdTierFile::RecordType::DOCUMENT:
+            documents[record.document_id] = record;
+            break;
+        case ColdTierFile::RecordType::REMOVAL:
+            documents.erase(record.document_id);
+            cold_removals_[record.document_id] = record.offset;
+            break;
+        case ColdTierFile::RecordType::POSTINGS:
+        {
+            auto &lists = cold_terms_[GetStoredTerm(record.term)].lists;
+            lists.resize(lists.size() - std::min<size_t>(record.replaced_lists, lists.size()));
+            lists.push_back(record.postings);
+            break;
+        }
+        } });
+
+    for (const auto &[document_id, record] : documents)
+    {
+        for (const auto &[stored_word, term_freq] : cold_tier_->ReadWords(record.words))
+        {
+            const auto word = GetStoredTerm(stored_word);
+            if (fuzzy_index_ && GetDocumentFreq(word) == 0)
+            {
+                fuzzy_index_->AddTerm(word);
+            }
+            term_dictionary_.AddDocument(word);
+            // a list written after the document holds its posting
+            const auto cold_term = cold_terms_.find(word);
+            if (cold_term != cold_terms_.end() && !cold_term->second.lists.empty() && cold_term->second.lists.back().offset > record.offset)
+            {
+                ++cold_term->second.document_count;
+                continue;
+            }
+            word_to_document_freqs_[word].emplace(document_id, term_freq);
+            word_to_document_ids_[word].push_back(document_id);
+            ++hot_posting_count_;
+        }
+        documents_.emplace(document_id, DocumentData{record.rating, record.status, {}, 0, record.words, record.text});
+        document_ids_.insert(document_id);
+        status_to_documents_[record.status].Insert(document_id);
+        rating_to_documents_.insert({record.rating, document_id});
+    }
+    SpillHotPostings();
+}
+
+void SearchServer::SpillHotPostings()
+{
+    const size_t posting_memory = GetMapNodeSize<int, double>() + sizeof(int);
+    if (hot_posting_count_ * posting_memory <= hot_postings_bytes_)
+    {
+        return;
+    }
+    // the most frequent terms are the most likely to be queried and the most expensive to read
+    std::vector<std::pair<size_t, std::string_view>> terms; // {document frequency, term}
+    for (const auto &[word, postings] : word_to_document_freqs_)
+    {
+        if (!postings.empty())
+        {
+            terms.push_back({GetDocumentFreq(word), word});
+        }
+    }
+    std::sort(terms.begin(), terms.end());
+    for (const auto &[_, word] : terms)
+    {
+        if (hot_posting_count_ * posting_memory <= hot_postings_bytes_ / 2)
+        {
+            break;
+        }
+        FlushColdTerm(word);
+    }
+    cold_tier_->Flush();
+}
+
+void SearchServer::FlushColdTerm(const std::string_view word)
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    FlatPostings flat_postings(postings->second.begin(), postings->second.end());
+    auto &cold_term = cold_terms_[postings->first];
+    auto &lists = cold_term.lists;
+    uint32_t replaced_lists = 0;
+    while (replaced_lists < lists.size() && lists[lists.size() - 1 - replaced_lists].count <= 2 * flat_postings.size())
+    {
+        ReadColdList(lists[lists.size() - 1 - replaced_lists], flat_postings);
+        ++replaced_lists;
+    }
+    const auto list = cold_tier_->AppendPostings(word, flat_postings, replaced_lists);
+    lists.resize(lists.size() - replaced_lists);
+    lists.push_back(list);
+    cold_term.document_count += postings->second.size();
+    hot_posting_count_ -= postings->second.size();
+    // the key points into storage, so the cold term keeps a valid view
+    word_to_document_ids_.erase(word);
+    word_to_document_freqs_.erase(postings);
+}
+
+BlockCacheStats SearchServer::GetColdTierCacheStats() const
+{
+    return cold_tier_ ? cold_tier_->GetCacheStats() : BlockCacheStats{};
+}
+
+int SearchServer::AddStandingQuery(const std::string_view raw_query, std::function<bool(int, DocumentStatus, int)> document_predicate,
+                                   StandingQueryCallback callback)
+{
+    using namespace std::string_literals;
+    const int query_id = next_standing_query_id_;
+    // parsed in place: the query words point into the stored raw_query
+    auto &standing_query = standing_queries_[query_id];
+    try
+    {
+        standing_query.raw_query = std::string{raw_query};
+        // a correction would follow today's dictionary, while the query waits for words that are not in it yet
+        standing_query.query = ParseQuery(standing_query.raw_query, false);
+        const auto &query = standing_query.query;
+        if (query.plus_words.empty())
+        {
+            throw std::invalid_argument("Standing query "s + std::string{raw_query} + " has no plus-words"s);
+        }
+        if (std::any_of(query.plus_words.begin(), query.plus_words.end(), IsWildcard))
+        {
+            throw std::invalid_argument("Standing query "s + std::string{raw_query} + " has a wildcard"s);
+        }
+    }
+    catch (...)
+    {
+        standing_queries_.erase(query_id);
+        throw;
+    }
+    ++next_standing_query_id_;
+    standing_query.document_predicate = std::move(document_predicate);
+    standing_query.callback = std::move(callback);
+
+    const auto &query = standing_query.query;
+    if (query.required_words.empty())
+    {
+        standing_query.keys.assign(query.plus_words.begin(), query.plus_words.end());
+    }
+    else
+    {
+        standing_query.keys.emplace_back(*std::min_element(query.required_words.begin(), query.required_words.end(),
+                                                           [this](const std::string_view lhs, const std::string_view rhs)
+                                                           { return GetDocumentFreq(lhs) < GetDocumentFreq(rhs); }));
+    }
+    for (const auto &key : standing_query.keys)
+    {
+        // ids only grow, so appending keeps the list sorted
+        word_to_standing_queries_[key].push_back(query_id);
+    }
+    return query_id;
+}
+
+int SearchServer::AddStandingQuery(const std::string_view raw_query, DocumentStatus status, StandingQueryCallback callback)
+{
+    return AddStandingQuery(raw_query, [status](int, DocumentStatus document_status, int)
+                            { return document_status == status; },
+                            std::move(callback));
+}
+
+int SearchServer::AddStandingQuery(const std::string_view raw_query, StandingQueryCallback callback)
+{
+    return AddStandingQuery(raw_query, DocumentStatus::ACTUAL, std::move(callback));
+}
+
+void SearchServer::RemoveStandingQuery(int query_id)
+{
+    const auto standing_query = standing_queries_.find(query_id);
+    if (standing_query == standing_queries_.end())
+    {
+        return;
+    }
+    for (const auto &key : standing_query->second.keys)
+    {
+        const auto query_ids = word_to_standing_queries_.find(key);
+        EraseSortedId(query_ids->second, query_id);
+        if (query_ids->second.empty())
+        {
+            word_to_standing_queries_.erase(query_ids);
+        }
+    }
+    standing_queries_.erase(standing_query);
+}
+
+void SearchServer::NotifyStandingQueries(int document_id)
+{
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+    std::vector<int> candidates;
+    for (const auto &[word, _] : document_words)
+    {
+        const auto query_ids = word_to_standing_queries_.find(word);
+        if (query_ids != word_to_standing_queries_.end())
+        {
+            candidates.insert(candidates.end(), query_ids->second.begin(), query_ids->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    const auto &document = documents_.at(document_id);
+    std::vector<std::pair<int, Document>> matches;
+    for (const int query_id : candidates)
+    {
+        const auto &standing_query = standing_queries_.at(query_id);
+        const auto &query = standing_query.query;
+        if (!standing_query.document_predicate(document_id, document.status, document.rating) ||
+            MatchDocumentWords(query, document_id, nullptr) == 0)
+        {
+            continue;
+        }
+        double relevance = 0.0;
+        for (const auto word : query.plus_words)
+        {
+            const auto term_freq = document_words.find(word);
+            if (term_freq != document_words.end())
+            {
+                relevance += term_freq->second * log(GetDocumentCount() * 1.0 / GetDocumentFreq(word));
+            }
+        }
+        relevance *= ComputeProximityBoost(query, document_id);
+        matches.emplace_back(query_id, Document{document_id, relevance, document.rating});
+    }
+    // a callback may add or remove standing queries, including its own
+    for (const auto &[query_id, matched_document] : matches)
+    {
+        const auto standing_query = standing_queries_.find(query_id);
+        if (standing_query != standing_queries_.end())
+        {
+            const auto callback = standing_query->second.callback;
+            callback(query_id, matched_document);
+        }
+    }
+}
+
+void SearchServer::EnableImpactOrderedPostings()
+{
+    using namespace std::string_literals;
+    if (cold_tier_)
+    {
+        throw std::logic_error("Impact-ordered postings cannot be enabled together with the cold tier"s);
+    }
+    auto &word_to_impact_postings = word_to_impact_postings_.emplace();
+    for (const auto &[document_id, word_freqs] : ids_to_word_freq_)
+    {
+        const auto document = documents_.find(document_id);
+        if (document == documents_.end())
+        {
+            continue;
+        }
+        for (const auto &[word, term_freq] : word_freqs)
+        {
+            word_to_impact_postings[word].push_back({term_freq, document->second.rating, document_id});
+        }
+    }
+    for (auto &[_, postings] : word_to_impact_postings)
+    {
+        std::sort(postings.begin(), postings.end(), IsHigherImpact);
+    }
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocumentsByImpact(raw_query, [status](int, DocumentStatus document_status, int)
+                                    { return document_status == status; });
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query) const
+{
+    return FindTopDocumentsByImpact(raw_query, DocumentStatus::ACTUAL);
+}
+
+double SearchServer::ComputeRelevance(const std::vector<ImpactCursor> &cursors, int document_id) const
+{
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+    double relevance = 0.0;
+    for (const auto &cursor : cursors)
+    {
+        const auto term_freq = document_words.find(cursor.word);
+        if (term_freq != document_words.end())
+        {
+            relevance += term_freq->second * cursor.inverse_document_freq;
+        }
+    }
+    return relevance;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                      int document_id) const
+{
+    return MatchDocument(ParseQuery(raw_query), document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const Query &query, int document_id) const
+{
+    const auto status = documents_.at(document_id).status;
+    // forward index of the document: one small map instead of a posting lookup per word
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+
+    std::vector<std::string_view> matched_words;
+
+    if (std::any_of(query.minus_words.begin(), query.minus_words.end(), [&](auto minus_word)
+                    { return ContainsQueryWord(document_words, minus_word); }) ||
+        std::any_of(query.required_words.begin(), query.required_words.end(), [&](auto required_word)
+                    { return !ContainsPlusWord(query, document_words, required_word); }) ||
+        !ContainsQueryPhrases(query, document_id))
+    {
+        return {matched_words, status};
+    }
+
+    for (const auto word : query.plus_words)
+    {
+        if (ContainsPlusWord(query, document_words, word))
+        {
+            matched_words.push_back(word);
+        }
+    }
+    return {matched_words, status};
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query,
+                                                                                      int document_id) const
+{
+    return MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
+                                                                                      int document_id) const
+{
+    const auto query = SearchServer::ParseQueryWithoutDeleteCopyes(raw_query);
+    const auto status = documents_.at(document_id).status;
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+
+    std::vector<std::string_view> matched_words(query.plus_words.size());
+
+    if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&](auto minus_word)
+                    { return ContainsQueryWord(document_words, minus_word); }) ||
+        std::any_of(policy, query.required_words.begin(), query.required_words.end(), [&](auto required_word)
+                    { return !ContainsPlusWord(query, document_words, required_word); }) ||
+        !ContainsQueryPhrases(query, document_id))
+    {
+        return {std::vector<std::string_view>{}, status};
+    }
+
+    auto last1 = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto plus_word)
+                              { return ContainsPlusWord(query, document_words, plus_word); });
+
+    std::sort(matched_words.begin(), last1);
+    auto last2 = std::unique(matched_words.begin(), last1);
+    matched_words.erase(last2, matched_words.end());
+
+    return {matched_words, status};
+}
+
+DocumentMatches SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int> &document_ids) const
+{
+    std::execution::sequenced_policy policy;
+    return MatchDocuments(policy, ParseQuery(raw_query), document_ids);
+}
+
+DocumentMatches SearchServer::MatchDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query,
+                                             const std::vector<int> &document_ids) const
+{
+    return MatchDocuments(policy, ParseQuery(raw_query), document_ids);
+}
+
+DocumentMatches SearchServer::MatchDocuments(std::execution::parallel_policy policy, const std::string_view raw_query,
+                                             const std::vector<int> &document_ids) const
+{
+    return MatchDocuments(policy, ParseQuery(raw_query), document_ids);
+}
+
+bool SearchServer::PassesMinusAndRequiredWords(const Query &query, int document_id) const
+{
+    std::map<std::string_view, double> loaded_words;
+    return PassesMinusAndRequiredWords(query, document_id, GetDocumentWords(document_id, loaded_words));
+}
+
+bool SearchServer::PassesMinusAndRequiredWords(const Query &query, int document_id,
+                                               const std::map<std::string_view, double> &document_words) const
+{
+    return MatchSortedWords(document_words, query.minus_words, nullptr, nullptr) == 0 &&
+           MatchSortedWords(document_words, query.required_words, &query, nullptr) == query.required_words.size() &&
+           ContainsQueryPhrases(query, document_id);
+}
+
+size_t SearchServer::MatchDocumentWords(const Query &query, int document_id, std::string_view *matched_words) const
+{
+    std::map<std::string_view, double> loaded_words;
+    const auto &document_words = GetDocumentWords(document_id, loaded_words);
+    if (!PassesMinusAndRequiredWords(query, document_id, document_words))
+    {
+        return 0;
+    }
+    return MatchSortedWords(document_words, query.plus_words, &query, matched_words);
+}
+
+bool SearchServer::IsStopWord(const std::string_view word) const
+{
+    return stop_words_.count(word) > 0;
+}
+
+bool SearchServer::IsValidWord(const std::string_view word)
+{
+    // A valid word must not contain special characters
+    return std::none_of(word.begin(), word.end(), [](char c)
+                        { return c >= '\0' && c < ' '; });
+}
+
+std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const
+{
+    std::vector<std::string_view> words;
+    using namespace std::string_literals;
+    for (const auto word : SplitIntoWords(text))
+    {
+        if (!IsValidWord(word))
+        {
+            throw std::invalid_argument("Word "s + std::string{word} + " is invalid"s);
+        }
+        if (!IsStopWord(word))
+        {
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
+int SearchServer::ComputeAverageRating(const std::vector<int> &ratings)
+{
+    if (ratings.empty())
+    {
+        return 0;
+    }
+    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
+
+    return rating_sum / static_cast<int>(ratings.size());
+}
+
+struct SearchServer::QueryWord
+{
+    std::string_view data;
+    bool is_minus;
+    bool is_required;
+    bool is_stop;
+};
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text) const
+{
+    using namespace std::string_literals;
+    if (text.empty())
+    {
+        throw std::invalid_argument("Query word is empty"s);
+    }
+    auto word = text;
+    bool is_minus = false;
+    bool is_required = false;
+    if (word[0] == '-')
+    {
+        is_minus = true;
+        word = word.substr(1);
+    }
+    else if (word[0] == '+')
+    {
+        is_required = true;
+        word = word.substr(1);
+        if (!word.empty() && word[0] == '+')
+        {
+            throw std::invalid_argument("Query word "s + std::string{text} + " is invalid");
+        }
+    }
+    if (word.empty() || word[0] == '-' || (word[0] == '*' && !TermDictionary::HasTrigram(word)) || !IsValidWord(word))
+    {
+        throw std::invalid_argument("Query word "s + std::string{text} + " is invalid");
+    }
+
+    return {word, is_minus, is_required, IsStopWord(word)};
+}
+
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool is_corrected, bool is_expanded) const
+{
+    SearchServer::Query query;
+    ParseQueryWords(text, query, is_corrected);
+    std::sort(query.plus_words.begin(), query.plus_words.end());
     std::sort(query.minus_words.begin(), query.minus_words.end());
 
     auto last1 = std::unique(query.plus_words.begin(), query.plus_words.end());
@@ -316,14 +1460,82 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
 
     query.plus_words.erase(last1, query.plus_words.end());
     query.minus_words.erase(last2, query.minus_words.end());
+
+    std::sort(query.required_words.begin(), query.required_words.end());
+    query.required_words.erase(std::unique(query.required_words.begin(), query.required_words.end()), query.required_words.end());
+    if (is_expanded)
+    {
+        ExpandWildcards(query);
+    }
     return query;
 }
 
 SearchServer::Query SearchServer::ParseQueryWithoutDeleteCopyes(const std::string_view text) const
 {
     SearchServer::Query query;
-    for (const auto word : SplitIntoWords(text))
+    ParseQueryWords(text, query);
+    ExpandWildcards(query);
+    return query;
+}
+
+void SearchServer::ExpandWildcards(Query &query) const
+{
+    for (const auto word : query.plus_words)
+    {
+        if (IsWildcard(word) && query.wildcard_terms.count(word) == 0)
+        {
+            query.wildcard_terms.emplace(word, ExpandWildcard(word, MAX_WILDCARD_EXPANSION));
+        }
+    }
+}
+
+void SearchServer::ParseQueryWords(const std::string_view text, Query &query, bool is_corrected) const
+{
+    using namespace std::string_literals;
+    std::optional<std::vector<PhraseWord>> phrase;
+    int phrase_offset = 0;
+    for (auto word : SplitIntoWords(text))
     {
+        if (!phrase && word[0] == '"')
+        {
+            phrase.emplace();
+            phrase_offset = 0;
+            word.remove_prefix(1);
+        }
+        if (phrase)
+        {
+            const bool closes_phrase = !word.empty() && word.back() == '"';
+            if (closes_phrase)
+            {
+                word.remove_suffix(1);
+            }
+            if (!word.empty())
+            {
+                if (word[0] == '-' || word[0] == '+' || word.find('"') != std::string_view::npos || IsWildcard(word) || !IsValidWord(word))
+                {
+                    throw std::invalid_argument("Phrase word "s + std::string{word} + " is invalid"s);
+                }
+                // a stop word is not indexed but still takes its place in the phrase
+                if (!IsStopWord(word))
+                {
+                    const auto corrected_word = is_corrected ? CorrectQueryWord(word) : word;
+                    phrase->push_back({corrected_word, phrase_offset});
+                    query.plus_words.push_back(corrected_word);
+                    query.required_words.push_back(corrected_word);
+                }
+                ++phrase_offset;
+            }
+            if (closes_phrase)
+            {
+                if (phrase->size() > 1)
+                {
+                    query.phrases.push_back(std::move(*phrase));
+                }
+                phrase.reset();
+            }
+            continue;
+        }
+
         const auto query_word = SearchServer::ParseQueryWord(word);
         if (!query_word.is_stop)
         {
@@ -333,15 +1545,399 @@ SearchServer::Query SearchServer::ParseQueryWithoutDeleteCopyes(const std::strin
             }
             else
             {
-                query.plus_words.push_back(query_word.data);
+                const auto word = is_corrected ? CorrectQueryWord(query_word.data) : query_word.data;
+                query.plus_words.push_back(word);
+                if (query_word.is_required)
+                {
+                    query.required_words.push_back(word);
+                }
             }
         }
     }
-    return query;
+    if (phrase)
+    {
+        throw std::invalid_argument("Phrase is not closed"s);
+    }
+    if (!query.phrases.empty() && !positional_index_)
+    {
+        throw std::logic_error("Phrase queries need the positional index, call EnablePositionalIndex first"s);
+    }
+}
+
+bool SearchServer::ExcludedDocuments::Contains(int document_id) const
+{
+    if (!patterns.empty())
+    {
+        std::map<std::string_view, double> loaded_words;
+        const auto &document_words = search_server->GetDocumentWords(document_id, loaded_words);
+        if (std::any_of(patterns.begin(), patterns.end(), [&document_words](const std::string_view pattern)
+                        { return ContainsQueryWord(document_words, pattern); }))
+        {
+            return true;
+        }
+    }
+    if (use_bitmap)
+    {
+        return bitmap.Contains(document_id);
+    }
+    return std::any_of(postings.begin(), postings.end(), [document_id](const auto *word_postings)
+                       { return word_postings->count(document_id) != 0; }) ||
+           std::any_of(cold_postings.begin(), cold_postings.end(), [document_id](const FlatPostings &word_postings)
+                       { return FindTermFreq(word_postings, document_id) != nullptr; });
+}
+
+std::vector<std::pair<int, int>> SearchServer::SplitDocumentIds(size_t partition_count) const
+{
+    std::vector<std::pair<int, int>> ranges;
+    if (document_ids_.empty())
+    {
+        return ranges;
+    }
+    const int64_t first_id = *document_ids_.begin();
+    const int64_t end_id = int64_t{*document_ids_.rbegin()} + 1;
+    const int64_t width = std::max<int64_t>(1, (end_id - first_id + partition_count - 1) / partition_count);
+    for (int64_t range_begin = first_id; range_begin < end_id; range_begin += width)
+    {
+        ranges.emplace_back(static_cast<int>(range_begin), static_cast<int>(std::min(range_begin + width, end_id)));
+    }
+    return ranges;
+}
+
+size_t SearchServer::CountCandidatePostings(const ResolvedQuery &resolved_query, const DocumentBitmap *document_filter)
+{
+    size_t candidates_size = 0;
+    for (const auto &term : resolved_query.plus_terms)
+    {
+        candidates_size += term.document_ids->size();
+    }
+    if (document_filter != nullptr)
+    {
+        candidates_size = std::min(candidates_size, document_filter->Size());
+    }
+    return candidates_size;
+}
+
+SearchServer::ExcludedDocuments SearchServer::ResolveMinusWords(const Query &query, size_t candidates_size) const
+{
+    ExcludedDocuments excluded;
+    excluded.search_server = this;
+    size_t minus_postings_size = 0;
+    auto add_postings = [&](const std::string_view word)
+    {
+        FlatPostings loaded_postings;
+        const auto *postings = GetPostings(word, loaded_postings);
+        if (postings != nullptr && !postings->empty())
+        {
+            excluded.postings.push_back(postings);
+            minus_postings_size += postings->size();
+        }
+        else if (!loaded_postings.empty())
+        {
+            minus_postings_size += loaded_postings.size();
+            excluded.cold_postings.push_back(std::move(loaded_postings));
+        }
+    };
+    for (const auto word : query.minus_words)
+    {
+        if (!IsWildcard(word))
+        {
+            add_postings(word);
+            continue;
+        }
+        // excluding only a part of the expansion would leak documents, so a large one is matched per candidate instead
+        const auto terms = term_dictionary_.FindAllTerms(word, MAX_MINUS_WILDCARD_EXPANSION);
+        if (!terms)
+        {
+            excluded.patterns.push_back(word);
+            continue;
+        }
+        for (const auto &term : *terms)
+        {
+            add_postings(term);
+        }
+    }
+    if (excluded.postings.empty() && excluded.cold_postings.empty())
+    {
+        return excluded;
+    }
+
+    if (minus_postings_size <= candidates_size)
+    {
+        excluded.use_bitmap = true;
+        for (const auto *word_postings : excluded.postings)
+        {
+            for (const auto [document_id, _] : *word_postings)
+            {
+                excluded.bitmap.Insert(document_id);
+            }
+        }
+        for (const auto &word_postings : excluded.cold_postings)
+        {
+            for (const auto &[document_id, _] : word_postings)
+            {
+                excluded.bitmap.Insert(document_id);
+            }
+        }
+        excluded.postings.clear();
+        excluded.cold_postings.clear();
+    }
+    return excluded;
+}
+
+std::string_view SearchServer::CorrectQueryWord(const std::string_view word) const
+{
+    if (!fuzzy_index_ || IsWildcard(word))
+    {
+        return word;
+    }
+    if (GetDocumentFreq(word) > 0)
+    {
+        return word;
+    }
+    // candidates come sorted by distance: take the most frequent term among the nearest ones
+    std::string_view best_term = word;
+    int best_distance = 0;
+    size_t best_document_freq = 0;
+    for (const auto &[term, distance] : fuzzy_index_->FindCandidates(word))
+    {
+        if (best_document_freq > 0 && distance > best_distance)
+        {
+            break;
+        }
+        const size_t document_freq = GetDocumentFreq(term);
+        if (document_freq > best_document_freq)
+        {
+            best_term = term;
+            best_distance = distance;
+            best_document_freq = document_freq;
+        }
+    }
+    return best_term;
+}
+
+bool SearchServer::IsWildcard(const std::string_view word)
+{
+    return word.find('*') != word.npos;
+}
+
+std::vector<std::string_view> SearchServer::ExpandWildcard(const std::string_view pattern, size_t limit) const
+{
+    std::vector<std::string_view> terms;
+    for (const auto &[_, term] : CollectWildcardTerms(pattern, limit))
+    {
+        terms.push_back(term);
+    }
+    std::sort(terms.begin(), terms.end());
+    return terms;
+}
+
+std::vector<std::pair<size_t, std::string_view>> SearchServer::CollectWildcardTerms(const std::string_view pattern, size_t limit) const
+{
+    std::vector<std::pair<size_t, std::string_view>> terms; // {document frequency, term}
+    for (const auto &[document_freq, term] : term_dictionary_.FindFrequentTerms(pattern, limit))
+    {
+        terms.push_back({document_freq, GetDictionaryTerm(term)});
+    }
+    return terms;
+}
+
+std::string_view SearchServer::GetDictionaryTerm(const std::string_view word) const
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    if (postings != word_to_document_freqs_.end())
+    {
+        return postings->first;
+    }
+    return cold_terms_.find(word)->first;
+}
+
+std::string_view SearchServer::GetStoredTerm(const std::string_view word)
+{
+    const auto postings = word_to_document_freqs_.find(word);
+    if (postings != word_to_document_freqs_.end())
+    {
+        return postings->first;
+    }
+    const auto cold_term = cold_terms_.find(word);
+    if (cold_term != cold_terms_.end())
+    {
+        return cold_term->first;
+    }
+    return storage.emplace_back(word);
+}
+
+std::vector<std::string_view> SearchServer::SelectFrequentTerms(std::vector<std::pair<size_t, std::string_view>> terms, size_t limit)
+{
+    if (terms.size() > limit)
+    {
+        std::nth_element(terms.begin(), terms.begin() + limit, terms.end(), [](const auto &lhs, const auto &rhs)
+                         { return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second); });
+        terms.resize(limit);
+    }
+
+    std::vector<std::string_view> result(terms.size());
+    std::transform(terms.begin(), terms.end(), result.begin(), [](const auto &term)
+                   { return term.second; });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+bool SearchServer::ContainsQueryWord(const std::map<std::string_view, double> &document_words, const std::string_view word)
+{
+    if (!IsWildcard(word))
+    {
+        return document_words.count(word) != 0;
+    }
+    const auto prefix = word.substr(0, word.find('*'));
+    for (auto it = document_words.lower_bound(prefix); it != document_words.end() && it->first.substr(0, prefix.size()) == prefix; ++it)
+    {
+        if (MatchesWildcard(word, it->first))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SearchServer::ContainsPlusWord(const Query &query, const std::map<std::string_view, double> &document_words, const std::string_view word)
+{
+    if (!IsWildcard(word))
+    {
+        return document_words.count(word) != 0;
+    }
+    const auto &terms = query.wildcard_terms.at(word);
+    return std::any_of(terms.begin(), terms.end(), [&document_words](const std::string_view term)
+                       { return document_words.count(term) != 0; });
+}
+
+size_t SearchServer::MatchSortedWords(const std::map<std::string_view, double> &document_words, const std::vector<std::string_view> &sorted_words,
+                                      const Query *query, std::string_view *matched_words)
+{
+    size_t matched_count = 0;
+    auto document_word = document_words.begin();
+    for (const auto word : sorted_words)
+    {
+        bool is_matched = false;
+        if (IsWildcard(word))
+        {
+            is_matched = query != nullptr ? ContainsPlusWord(*query, document_words, word) : ContainsQueryWord(document_words, word);
+        }
+        else
+        {
+            while (document_word != document_words.end() && document_word->first < word)
+            {
+                ++document_word;
+            }
+            is_matched = document_word != document_words.end() && document_word->first == word;
+        }
+        if (is_matched)
+        {
+            if (matched_words != nullptr)
+            {
+                matched_words[matched_count] = word;
+            }
+            ++matched_count;
+        }
+    }
+    return matched_count;
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query &query, const CorpusStatistics *statistics) const
+{
+    auto compute_inverse_document_freq = [this, statistics](const std::string_view word, size_t document_freq)
+    {
+        if (statistics != nullptr)
+        {
+            return log(statistics->document_count * 1.0 / statistics->document_freqs.at(word));
+        }
+        return log(GetDocumentCount() * 1.0 / document_freq);
+    };
+    ResolvedQuery resolved_query;
+    auto add_flat_term = [&](const std::string_view word, FlatPostings postings)
+    {
+        auto &document_ids = resolved_query.merged_document_ids.emplace_back();
+        document_ids.reserve(postings.size());
+        for (const auto &[document_id, _] : postings)
+        {
+            document_ids.push_back(document_id);
+        }
+        const double inverse_document_freq = compute_inverse_document_freq(word, postings.size());
+        const auto &flat_postings = resolved_query.merged_postings.emplace_back(std::move(postings));
+        resolved_query.plus_terms.push_back({word, nullptr, &flat_postings, &document_ids, inverse_document_freq});
+    };
+    for (const auto word : query.plus_words)
+    {
+        if (!IsWildcard(word))
+        {
+            FlatPostings loaded_postings;
+            const auto *postings = GetPostings(word, loaded_postings);
+            if (postings != nullptr && !postings->empty())
+            {
+                resolved_query.plus_terms.push_back({word, postings, nullptr, &word_to_document_ids_.at(word),
+                                                     compute_inverse_document_freq(word, postings->size())});
+            }
+            else if (!loaded_postings.empty())
+            {
+                add_flat_term(word, std::move(loaded_postings));
+            }
+            continue;
+        }
+
+        FlatPostings merged;
+        for (const auto term : query.wildcard_terms.at(word))
+        {
+            FlatPostings loaded_postings;
+            const auto *postings = GetPostings(term, loaded_postings);
+            const auto term_begin = static_cast<std::ptrdiff_t>(merged.size());
+            if (postings != nullptr)
+            {
+                merged.insert(merged.end(), postings->begin(), postings->end());
+            }
+            else
+            {
+                merged.insert(merged.end(), loaded_postings.begin(), loaded_postings.end());
+            }
+            std::inplace_merge(merged.begin(), merged.begin() + term_begin, merged.end(), IsLowerId);
+        }
+        // a document with several of the terms gets the sum of their frequencies, added in term order
+        size_t merged_size = 0;
+        for (const auto &posting : merged)
+        {
+            if (merged_size > 0 && merged[merged_size - 1].first == posting.first)
+            {
+                merged[merged_size - 1].second += posting.second;
+            }
+            else
+            {
+                merged[merged_size++] = posting;
+            }
+        }
+        merged.resize(merged_size);
+        if (!merged.empty())
+        {
+            add_flat_term(word, std::move(merged));
+        }
+    }
+
+    for (const auto word : query.required_words)
+    {
+        const auto term = std::find_if(resolved_query.plus_terms.begin(), resolved_query.plus_terms.end(), [word](const QueryTerm &plus_term)
+                                       { return plus_term.word == word; });
+        if (term == resolved_query.plus_terms.end())
+        {
+            resolved_query.has_missing_required_word = true;
+            break;
+        }
+        resolved_query.required_terms.push_back(*term);
+    }
+    return resolved_query;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const
+void SearchServer::CollectStatistics(const Query &query, CorpusStatistics &statistics) const
 {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    statistics.document_count += GetDocumentCount();
+    for (const auto &term : ResolveQuery(query, nullptr).plus_terms)
+    {
+        statistics.document_freqs[term.word] += term.document_ids->size();
+    }
 }
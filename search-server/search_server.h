@@ -12,12 +12,76 @@
 #include <execution>
 #include <deque>
 #include "concurrent_map.h"
+#include "document_bitmap.h"
+#include "posting_lists.h"
+#include "deletion_index.h"
+#include "term_dictionary.h"
+#include "query_executor.h"
+#include "execution_cost_model.h"
+#include "memory_usage.h"
+#include "positional_index.h"
+#include "cold_tier_file.h"
+#include <optional>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include "paginator.h"
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <thread>
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// A "cat*" plus-word is replaced with at most this many terms, the most frequent ones
+const int MAX_WILDCARD_EXPANSION = 64;
+// A minus-wildcard with more terms is checked against each candidate's words instead of merging the postings of its terms
+const int MAX_MINUS_WILDCARD_EXPANSION = 1024;
+
 const auto DIFF = 1e-6;
 
+// Relevance of a document is multiplied by up to 1 + PROXIMITY_WEIGHT when the required words stand next to each other
+const double PROXIMITY_WEIGHT = 0.5;
+
+// Last document of a page; the next page starts right after it in the ranking
+struct SearchCursor
+{
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+struct DocumentPage
+{
+    std::vector<Document> documents;
+    // empty on the last page
+    std::optional<SearchCursor> next_cursor;
+};
+
+// Matched words of many documents in one buffer
+struct DocumentMatches
+{
+    // the words of the i-th document are words[offsets[i]] .. words[offsets[i + 1] - 1]
+    std::vector<std::string_view> words;
+    std::vector<size_t> offsets;
+    std::vector<DocumentStatus> statuses;
+
+    IteratorRange<std::vector<std::string_view>::const_iterator> GetWords(size_t index) const
+    {
+        return {words.begin() + offsets[index], words.begin() + offsets[index + 1], offsets[index + 1] - offsets[index]};
+    }
+};
+
+class ShardedSearchServer;
+class DurableSearchServer;
+
 class SearchServer
 {
+    // shards are queried through the private query pipeline with corpus-wide statistics
+    friend class ShardedSearchServer;
+    // snapshots are written from the stored documents
+    friend class DurableSearchServer;
+
 public:
     template <typename StringContainer>
     explicit SearchServer(const StringContainer &stop_words);
@@ -32,12 +96,15 @@ public:
 
     std::set<int>::iterator end();
 
+    // With the cold tier the entry is read from its file into a buffer of the calling thread, which its next call overwrites
     const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
 
     // void DeleteDoc(std::string* word);
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
+    // Removal shifts the sorted id list of every word of the document, so its cost is the length of those lists
+    void RemoveDocument(AutomaticExecutionPolicy policy, int document_id);
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
                      const std::vector<int> &ratings);
@@ -58,12 +125,145 @@ public:
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentStatus status,
+                                           int min_rating, int max_rating) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentStatus status,
+                                           int min_rating, int max_rating) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, int min_rating, int max_rating) const;
+
     std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query) const;
 
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query) const;
 
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const std::string_view raw_query,
+                                           DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const std::string_view raw_query, DocumentStatus status,
+                                           int min_rating, int max_rating) const;
+
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const std::string_view raw_query) const;
+
+    // Any depth of the ranking FindTopDocuments cuts at MAX_RESULT_DOCUMENT_COUNT. Only the page itself is sorted,
+    // so page N costs about as much as page 1. Documents with equal relevance and rating are ordered by id
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                   const std::optional<SearchCursor> &cursor, size_t page_size) const;
+
+    DocumentPage FindDocumentsPage(const std::string_view raw_query, DocumentStatus status,
+                                   const std::optional<SearchCursor> &cursor, size_t page_size) const;
+
+    DocumentPage FindDocumentsPage(const std::string_view raw_query, const std::optional<SearchCursor> &cursor, size_t page_size) const;
+
+    class PreparedQuery;
+
+    // Parses the query and binds it to the current postings once, so it can be run many times.
+    // After AddDocument or RemoveDocument the next run binds it again, and the runs after that reuse the new binding
+    PreparedQuery PrepareQuery(const std::string_view raw_query) const;
+
+    // False if the index changed since the query was last bound, so its next run binds it again
+    bool IsPreparedQueryCurrent(const PreparedQuery &prepared_query) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &policy, const PreparedQuery &prepared_query,
+                                           DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const PreparedQuery &prepared_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const PreparedQuery &prepared_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery &prepared_query) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const PreparedQuery &prepared_query,
+                                           DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(AutomaticExecutionPolicy policy, const PreparedQuery &prepared_query, DocumentStatus status) const;
+
+    // Queries run on the server's own executor. Like the blocking overloads,
+    // they must not overlap with AddDocument or RemoveDocument
+    void ConfigureExecutor(size_t thread_count, size_t max_queue_size = 10000, bool pin_threads = false);
+
+    std::future<std::vector<Document>> FindTopDocumentsAsync(const std::string &raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             const QueryOptions &options = {}) const;
+
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(const std::string &raw_query, DocumentPredicate document_predicate,
+                                                             const QueryOptions &options = {}) const;
+
     int GetDocumentCount() const;
 
+    // Byte counts of every index structure, derived from the node and buffer sizes of the standard library,
+    // and the top_term_count terms with the largest postings. Deque blocks and hash buckets follow the libstdc++
+    // layout and the targets of std::function are not counted, so the totals are close but not exact
+    MemoryStats GetMemoryStats(size_t top_term_count = 10) const;
+
+    // AddDocument throws MemoryBudgetExceeded instead of growing the index past max_bytes, zero turns it off.
+    // The check uses a running estimate that is reset to the exact figure here
+    void SetMemoryBudget(size_t max_bytes);
+
+    // AddDocument writes GetMemoryStats to out at most once per period
+    void EnableMemoryStatsDump(std::chrono::seconds period, std::ostream &out = std::cerr);
+
+    // Keeps a second copy of every posting list ordered by term frequency, then rating, for FindTopDocumentsByImpact.
+    // Throws std::logic_error once the cold tier is enabled
+    void EnableImpactOrderedPostings();
+
+    // Same result as FindTopDocuments. Reads the impact-ordered postings best first and stops as soon as
+    // no unread document can enter the top; the rest is looked up in the forward index. Wildcard queries and queries that need positions fall back to FindTopDocuments
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocumentsByImpact(const std::string_view raw_query) const;
+
+    // Stores token positions, which enables "quoted phrases" in queries and ranks documents whose
+    // required words are close together higher. Built now and kept up to date by AddDocument.
+    // Throws std::logic_error once the cold tier is enabled
+    void EnablePositionalIndex();
+
+    // Keeps the documents in a file at path instead of memory: AddDocument appends the forward index entry and text,
+    // and once the postings in memory outgrow hot_postings_bytes, those of the rarest terms are appended as well.
+    // Only the dictionary, the document metadata and the most frequent postings stay in memory. The file is read with pread
+    // through a block cache of cache_bytes. An existing file is opened again with the documents it holds; changes reach it
+    // once its buffer fills or the server is destroyed. Results do not change.
+    // Called on a server without documents; refuses with std::logic_error otherwise, and when impact-ordered postings
+    // or the positional index are enabled, they are not tiered
+    void EnableColdTier(const std::string &path, size_t hot_postings_bytes, size_t cache_bytes);
+
+    BlockCacheStats GetColdTierCacheStats() const;
+
+    // Receives the id of the standing query and the new document with its relevance at the moment it was added
+    using StandingQueryCallback = std::function<void(int query_id, const Document &document)>;
+
+    // Registers a query that is checked against every document added from now on, callback is run by
+    // AddDocument once the document is indexed. Only the queries sharing a word with the document are checked:
+    // a query with required words is keyed by the rarest of them, any other by each of its plus-words.
+    // Words are taken literally, fuzzy correction is not applied, and wildcards are not supported.
+    // Returns the id for RemoveStandingQuery
+    int AddStandingQuery(const std::string_view raw_query, std::function<bool(int, DocumentStatus, int)> document_predicate,
+                         StandingQueryCallback callback);
+
+    int AddStandingQuery(const std::string_view raw_query, DocumentStatus status, StandingQueryCallback callback);
+
+    int AddStandingQuery(const std::string_view raw_query, StandingQueryCallback callback);
+
+    void RemoveStandingQuery(int query_id);
+
+    // Unknown plus-words of later queries are rewritten to the most frequent dictionary term
+    // within max_edit_distance. The deletion index is built now and kept up to date by AddDocument
+    void EnableFuzzySearch(int max_edit_distance = 2);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
                                                                             int document_id) const;
 
@@ -73,6 +273,15 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
                                                                             int document_id) const;
 
+    // MatchDocument for every id with a single parse of the query and no allocation per document
+    DocumentMatches MatchDocuments(const std::string_view raw_query, const std::vector<int> &document_ids) const;
+
+    DocumentMatches MatchDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query,
+                                   const std::vector<int> &document_ids) const;
+
+    DocumentMatches MatchDocuments(std::execution::parallel_policy policy, const std::string_view raw_query,
+                                   const std::vector<int> &document_ids) const;
+
     std::set<std::string, std::less<>> GetStopWords()
     {
         return stop_words_;
@@ -83,17 +292,119 @@ private:
     {
         int rating;
         DocumentStatus status;
+        std::string_view text; // in storage, empty with the cold tier
+        // what AddDocument added to the running memory estimate, taken back on removal
+        size_t accounted_memory;
+        // the forward index entry and text in the cold tier file
+        ColdTierFile::Extent cold_words;
+        ColdTierFile::Extent cold_text;
     };
 
     const std::set<std::string, std::less<>> stop_words_;
     std::map<std::string_view, std::map<int, double>> word_to_document_freqs_; // 1
+    TermDictionary term_dictionary_; // the terms of both tiers, for wildcard enumeration
     std::map<int, DocumentData> documents_;
     std::set<int> document_ids_;
 
-    std::deque<std::string> storage;
+    std::deque<std::string> storage; // texts, or only the terms with the cold tier
 
     std::map<int, std::map<std::string_view, double>> ids_to_word_freq_; // 2
 
+    std::map<std::string_view, std::vector<int>> word_to_document_ids_; // sorted, for intersections
+
+    std::optional<DeletionIndex> fuzzy_index_;
+
+    struct ImpactPosting
+    {
+        double term_freq;
+        int rating;
+        int document_id;
+    };
+
+    std::optional<std::map<std::string_view, std::vector<ImpactPosting>>> word_to_impact_postings_; // sorted by IsHigherImpact
+
+    std::optional<PositionalIndex> positional_index_;
+
+    std::map<DocumentStatus, DocumentBitmap> status_to_documents_;
+    std::set<std::pair<int, int>> rating_to_documents_; // {rating, document_id}
+
+    // offset counts the tokens from the start of the phrase, stop words included
+    struct PhraseWord
+    {
+        std::string_view word;
+        int offset;
+    };
+
+    struct Query
+    {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+        // "+word": every document must contain it, also scored as a plus-word
+        std::vector<std::string_view> required_words;
+        // "white cat": its words are required and have to follow each other in the document
+        std::vector<std::vector<PhraseWord>> phrases;
+        // terms a "cat*" plus-word stands for: the same capped expansion for search and matching
+        std::map<std::string_view, std::vector<std::string_view>> wildcard_terms;
+    };
+
+    struct StandingQuery
+    {
+        std::string raw_query;
+        Query query; // points into raw_query or the dictionary
+        std::vector<std::string> keys;
+        std::function<bool(int, DocumentStatus, int)> document_predicate;
+        StandingQueryCallback callback;
+    };
+
+    std::map<int, StandingQuery> standing_queries_;
+    std::map<std::string, std::vector<int>, std::less<>> word_to_standing_queries_; // sorted query ids
+    int next_standing_query_id_ = 0;
+
+    // Postings appended to the cold tier file; the ones added since stay in word_to_document_freqs_
+    struct ColdTerm
+    {
+        std::vector<ColdTierFile::Extent> lists; // in file order
+        size_t document_count = 0;               // the valid postings of the lists
+    };
+
+    std::map<std::string_view, ColdTerm> cold_terms_;
+    // offset of the last removal record of a document: its postings in lists written before are not valid
+    std::map<int, uint64_t> cold_removals_;
+    std::unique_ptr<ColdTierFile> cold_tier_;
+    size_t hot_postings_bytes_ = 0;
+    size_t hot_posting_count_ = 0; // in word_to_document_freqs_
+
+    size_t memory_budget_ = 0;
+    size_t estimated_memory_usage_ = 0;
+
+    struct MemoryStatsDump
+    {
+        std::chrono::seconds period;
+        std::ostream *out;
+        std::chrono::steady_clock::time_point last_dump;
+    };
+
+    std::optional<MemoryStatsDump> memory_stats_dump_;
+
+    // changes on every modification of the index and is never shared between two servers
+    uint64_t index_version_ = NextIndexVersion();
+
+    // declared after the indexes: destroyed first, so no query outlives them
+    std::unique_ptr<QueryExecutor> executor_;
+
+    QueryExecutor &GetExecutor() const;
+
+    static uint64_t NextIndexVersion();
+
+    // Predicate used when the candidates are already narrowed down by a bitmap
+    struct AnyDocument
+    {
+        bool operator()(int, DocumentStatus, int) const
+        {
+            return true;
+        }
+    };
+
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
@@ -102,25 +413,297 @@ private:
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
+    void RemoveDocumentData(int document_id, const std::map<std::string_view, double> &document_words);
+
+    // Takes the document out of the postings of word, in memory or, once they are in the cold tier, by its count
+    void ErasePosting(const std::string_view word, int document_id);
+
+    // Index nodes one document with unique_word_count distinct words adds. Storage and posting buffers are not included
+    size_t EstimateDocumentMemory(size_t unique_word_count, const std::vector<std::string_view> &new_terms) const;
+
+    // Bytes the posting buffers of word, its term dictionary entry and its fuzzy index deletions allocate when a document
+    // with occurrence_count of it is added. Buffers keep their capacity, so removal gives none of it back
+    size_t EstimateBufferGrowth(std::string_view word, size_t occurrence_count) const;
+
+    static void EraseSortedId(std::vector<int> &document_ids, int document_id);
+
+    // Hot or cold, zero for unknown words
+    size_t GetDocumentFreq(const std::string_view word) const;
+
+    // The in-memory postings of a hot term. nullptr for a term with postings in the cold tier:
+    // they are read into loaded_postings together with the ones still in memory
+    const std::map<int, double> *GetPostings(const std::string_view word, FlatPostings &loaded_postings) const;
+
+    // The in-memory forward index entry of the document, or the one in the cold tier read into loaded_words
+    const std::map<std::string_view, double> &GetDocumentWords(int document_id, std::map<std::string_view, double> &loaded_words) const;
+
+    // The view of a term that outlives the text it was found in: the dictionary's own, or a new copy in storage
+    std::string_view GetStoredTerm(const std::string_view word);
+
+    // Appends the in-memory postings of the rarest terms to the cold tier until they take half of hot_postings_bytes_
+    void SpillHotPostings();
+
+    // Appends the in-memory postings of the term to the cold tier as a new list, merged with the newest lists while they
+    // are at most twice as long, so a term keeps a logarithmic number of them
+    void FlushColdTerm(const std::string_view word);
+
+    // Adds the postings of a cold list whose documents were not removed since, keeping postings sorted by id
+    void ReadColdList(const ColdTierFile::Extent &list, FlatPostings &postings) const;
+
+    static bool IsLowerId(const std::pair<int, double> &lhs, const std::pair<int, double> &rhs);
+
+    // Rebuilds the documents and postings from the records of the cold tier file
+    void ReplayColdTier();
+
+    // IDF is the same for the whole list, so term frequency orders it by impact; rating and id break ties
+    static bool IsHigherImpact(const ImpactPosting &lhs, const ImpactPosting &rhs);
+
+    const DocumentBitmap &GetDocumentsWithStatus(DocumentStatus status) const;
+
+    // nullopt once the range holds more than max_size documents
+    std::optional<DocumentBitmap> GetDocumentsWithRating(int min_rating, int max_rating, size_t max_size) const;
+
+    // A rating range is turned into a bitmap only when it is smaller than the postings the query visits,
+    // otherwise the rating of every candidate is checked instead
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsWithRating(ExecutionPolicy &policy, const Query &query, DocumentStatus status,
+                                                     int min_rating, int max_rating, size_t partition_count = 0) const;
+
     struct QueryWord;
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
-    struct Query
+    // Without correction the plus-words are taken literally even when fuzzy search is on.
+    // Without expansion wildcard_terms stays empty, for a caller that expands against other dictionaries
+    Query ParseQuery(const std::string_view text, bool is_corrected = true, bool is_expanded = true) const;
+    Query ParseQueryWithoutDeleteCopyes(const std::string_view text) const;
+
+    void ParseQueryWords(const std::string_view text, Query &query, bool is_corrected = true) const;
+
+    // Fills wildcard_terms for the wildcard plus-words from this dictionary
+    void ExpandWildcards(Query &query) const;
+
+    void AddDocumentPositions(int document_id, const std::string_view text);
+
+    // Runs the callbacks of the standing queries the document matches
+    void NotifyStandingQueries(int document_id);
+
+    bool ContainsQueryPhrases(const Query &query, int document_id) const;
+
+    // Whether the ranking of the query depends on the positions of its words
+    bool HasProximityBoost(const Query &query) const;
+
+    // 1 + PROXIMITY_WEIGHT * (k - 1) / span, span being the distance between the first and the last word of the
+    // shortest window holding all k distinct required words: k - 1 when they are adjacent, which gives the full boost
+    double ComputeProximityBoost(const Query &query, int document_id) const;
+
+    // The word itself if it is in the dictionary or fuzzy search is off, otherwise its nearest frequent neighbour
+    std::string_view CorrectQueryWord(const std::string_view word) const;
+
+    // '*' matches any sequence of characters. A pattern starting with '*' needs a literal run of 3 characters,
+    // which the trigram index of the term dictionary looks up
+    static bool IsWildcard(const std::string_view word);
+
+    // Dictionary terms matching the pattern, the limit keeps the ones with the largest document frequency; sorted by term
+    std::vector<std::string_view> ExpandWildcard(const std::string_view pattern, size_t limit) const;
+
+    // {document frequency, term} of the at most limit most frequent dictionary terms matching the pattern, most frequent first
+    std::vector<std::pair<size_t, std::string_view>> CollectWildcardTerms(const std::string_view pattern, size_t limit) const;
+
+    // The dictionary's own view of a term with documents, which outlives any query
+    std::string_view GetDictionaryTerm(const std::string_view word) const;
+
+    // The limit terms with the largest document frequency, ties go to the smaller term; sorted by term
+    static std::vector<std::string_view> SelectFrequentTerms(std::vector<std::pair<size_t, std::string_view>> terms, size_t limit);
+
+    // A wildcard matches any term here, which is how minus-words are applied
+    static bool ContainsQueryWord(const std::map<std::string_view, double> &document_words, const std::string_view word);
+
+    // A wildcard matches only the terms of its expansion, the ones search scores
+    static bool ContainsPlusWord(const Query &query, const std::map<std::string_view, double> &document_words, const std::string_view word);
+
+    // Merges the document's words with sorted_words and writes the common ones to matched_words unless it is null.
+    // Wildcards are matched with ContainsPlusWord if query is given, otherwise with ContainsQueryWord
+    static size_t MatchSortedWords(const std::map<std::string_view, double> &document_words, const std::vector<std::string_view> &sorted_words,
+                                   const Query *query, std::string_view *matched_words);
+
+    // No minus-word and every required word, checked in the forward index
+    bool PassesMinusAndRequiredWords(const Query &query, int document_id) const;
+    bool PassesMinusAndRequiredWords(const Query &query, int document_id, const std::map<std::string_view, double> &document_words) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const Query &query, int document_id) const;
+
+    // Number of matched plus-words, zero if a minus-word or required word rules the document out
+    size_t MatchDocumentWords(const Query &query, int document_id, std::string_view *matched_words) const;
+
+    template <typename ExecutionPolicy>
+    DocumentMatches MatchDocuments(ExecutionPolicy &policy, const Query &query, const std::vector<int> &document_ids) const;
+
+    // Query word bound to its postings. Wildcards get the postings of all their terms merged into one stream
+    struct QueryTerm
     {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::string_view word;
+        // the in-memory postings of a hot term, or else the ones read from the cold tier or merged for a wildcard
+        const std::map<int, double> *postings;
+        const FlatPostings *flat_postings;
+        const std::vector<int> *document_ids;
+        double inverse_document_freq;
     };
 
-    Query ParseQuery(const std::string_view text) const;
-    Query ParseQueryWithoutDeleteCopyes(const std::string_view text) const;
+    struct ResolvedQuery
+    {
+        std::vector<QueryTerm> plus_terms;
+        std::vector<QueryTerm> required_terms;
+        bool has_missing_required_word = false;
+        // wildcard merges and cold postings
+        std::deque<FlatPostings> merged_postings;
+        std::deque<std::vector<int>> merged_document_ids;
+    };
+
+    // Document count and per plus-word document frequencies of the whole corpus
+    // when it is split between several servers; IDF is computed from them instead of the local maps
+    struct CorpusStatistics
+    {
+        int document_count = 0;
+        std::map<std::string_view, int> document_freqs;
+    };
+
+    ResolvedQuery ResolveQuery(const Query &query, const CorpusStatistics *statistics) const;
+
+    void CollectStatistics(const Query &query, CorpusStatistics &statistics) const;
+
+    // Documents containing any minus-word. Small minus postings are folded into a bitmap,
+    // otherwise every candidate is probed against them, so the cost follows the candidate set.
+    // Minus-wildcards of more than MAX_MINUS_WILDCARD_EXPANSION terms are matched against the candidate's words
+    struct ExcludedDocuments
+    {
+        std::vector<const std::map<int, double> *> postings;
+        std::deque<FlatPostings> cold_postings;
+        DocumentBitmap bitmap;
+        bool use_bitmap = false;
+        std::vector<std::string_view> patterns;
+        const SearchServer *search_server = nullptr;
+
+        bool Contains(int document_id) const;
+    };
+
+    ExcludedDocuments ResolveMinusWords(const Query &query, size_t candidates_size) const;
+
+    static size_t CountCandidatePostings(const ResolvedQuery &resolved_query, const DocumentBitmap *document_filter);
+
+    // Immutable once built; the query words point into raw_query or the dictionary
+    struct PreparedQueryState
+    {
+        std::string raw_query;
+        Query query;
+        ResolvedQuery resolved_query;
+        ExcludedDocuments excluded_documents;
+        uint64_t index_version = 0;
+    };
+
+    // The prepared state itself if it is still current, otherwise a freshly resolved one, which replaces it
+    std::shared_ptr<const PreparedQueryState> GetPreparedQueryState(const PreparedQuery &prepared_query) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &policy, const PreparedQueryState &state, DocumentPredicate document_predicate,
+                                           const DocumentBitmap *document_filter, size_t partition_count = 0) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsAutomatic(const PreparedQuery &prepared_query, DocumentPredicate document_predicate,
+                                                    const DocumentBitmap *document_filter) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                           DocumentPredicate document_predicate, const DocumentBitmap *document_filter) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsAutomatic(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                    const DocumentBitmap *document_filter) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Upper bound of the postings a query visits, wildcards are counted as the whole corpus
+    size_t EstimateQueryCost(const Query &query, const DocumentBitmap *document_filter) const;
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(ExecutionPolicy &policy, const Query &query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate, const DocumentBitmap *document_filter,
+                                           const CorpusStatistics *statistics = nullptr) const;
+
+    // Minus-words are resolved here unless excluded_documents is given. par splits the ids into partition_count
+    // ranges, zero means one per hardware thread
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy &policy, const Query &query, const ResolvedQuery &resolved_query,
+                                           const ExcludedDocuments *excluded_documents, DocumentPredicate document_predicate,
+                                           const DocumentBitmap *document_filter, size_t partition_count = 0) const;
+
+    // Relevance descending, then rating descending, then id ascending
+    static bool IsRankedHigher(const Document &lhs, const Document &rhs);
+
+    // Sorts by IsRankedHigher and keeps MAX_RESULT_DOCUMENT_COUNT best documents
+    template <typename ExecutionPolicy>
+    static void KeepTopDocuments(ExecutionPolicy &policy, std::vector<Document> &documents);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    DocumentPage FindDocumentsPage(ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                   const DocumentBitmap *document_filter, const std::optional<SearchCursor> &cursor, size_t page_size) const;
+
+    // AND semantics: only the intersection of the required words' postings is scored
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsConjunctive(ExecutionPolicy &policy, const Query &query, const ResolvedQuery &resolved_query,
+                                                      const ExcludedDocuments *excluded_documents, DocumentPredicate document_predicate,
+                                                      const DocumentBitmap *document_filter) const;
+
+    template <typename DocumentPredicate>
+    bool IsAcceptedDocument(int document_id, DocumentPredicate &document_predicate) const;
+
+    struct ImpactCursor
+    {
+        std::string_view word;
+        const std::vector<ImpactPosting> *postings;
+        double inverse_document_freq;
+        size_t position = 0;
+    };
+
+    // Full relevance of a document met in one list, by random access to its forward index
+    double ComputeRelevance(const std::vector<ImpactCursor> &cursors, int document_id) const;
+
+    // Walks only the postings of ids in [first_id, last_id) that are also in document_filter (all of them if it is null)
+    template <typename Postings, typename Visitor>
+    static void ForEachCandidatePosting(const Postings &postings, const DocumentBitmap *document_filter,
+                                        int first_id, int last_id, Visitor visit);
+
+    // nullptr if the document is not in the postings
+    static const double *FindTermFreq(const std::map<int, double> &postings, int document_id);
+    static const double *FindTermFreq(const FlatPostings &postings, int document_id);
+
+    // Relevance of the candidates with ids in [first_id, last_id), ascending by id
+    template <typename DocumentPredicate>
+    std::vector<Document> AccumulateRelevance(const ResolvedQuery &resolved_query, const ExcludedDocuments &excluded_documents,
+                                              DocumentPredicate &document_predicate, const DocumentBitmap *document_filter,
+                                              int first_id, int last_id) const;
+
+    // Contiguous ranges [first, last) of about equal width that cover every document id
+    std::vector<std::pair<int, int>> SplitDocumentIds(size_t partition_count) const;
+};
+
+// Query parsed and bound to the postings of the server that prepared it. Copies share the state
+class SearchServer::PreparedQuery
+{
+public:
+    const std::string &GetRawQuery() const;
+
+private:
+    friend class SearchServer;
+
+    // Swapped with std::atomic_load and std::atomic_store when a run binds the query again
+    struct Binding
+    {
+        std::string raw_query;
+        std::shared_ptr<const PreparedQueryState> state;
+    };
+
+    explicit PreparedQuery(std::shared_ptr<const PreparedQueryState> state);
+
+    std::shared_ptr<Binding> binding_;
 };
 
 template <typename StringContainer>
@@ -137,31 +720,96 @@ SearchServer::SearchServer(const StringContainer &stop_words)
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
                                                      DocumentPredicate document_predicate) const
+{
+    return FindTopDocuments(policy, raw_query, document_predicate, nullptr);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                                     DocumentPredicate document_predicate, const DocumentBitmap *document_filter) const
 {
     const auto query = ParseQuery(raw_query);
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, document_filter);
+    KeepTopDocuments(policy, matched_documents);
+    return matched_documents;
+}
 
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs)
-         {
-             if (std::abs(lhs.relevance - rhs.relevance) < DIFF)
-             {
-                 return lhs.rating > rhs.rating;
-             }
-             else
-             {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsWithRating(ExecutionPolicy &policy, const Query &query, DocumentStatus status,
+                                                               int min_rating, int max_rating, size_t partition_count) const
+{
+    const auto &status_documents = GetDocumentsWithStatus(status);
+    const auto rating_documents = GetDocumentsWithRating(min_rating, max_rating, EstimateQueryCost(query, &status_documents));
+    const auto resolved_query = ResolveQuery(query, nullptr);
+    std::vector<Document> matched_documents;
+    if (rating_documents)
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        const auto candidates = rating_documents->Intersect(status_documents);
+        matched_documents = FindAllDocuments(policy, query, resolved_query, nullptr, AnyDocument{}, &candidates, partition_count);
     }
-
+    else
+    {
+        matched_documents = FindAllDocuments(policy, query, resolved_query, nullptr, [min_rating, max_rating](int, DocumentStatus, int rating)
+                                             { return rating >= min_rating && rating <= max_rating; },
+                                             &status_documents, partition_count);
+    }
+    KeepTopDocuments(policy, matched_documents);
     return matched_documents;
 }
 
+template <typename ExecutionPolicy>
+void SearchServer::KeepTopDocuments(ExecutionPolicy &policy, std::vector<Document> &documents)
+{
+    const auto top_size = std::min(documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(policy, documents.begin(), documents.begin() + top_size, documents.end(), IsRankedHigher);
+    documents.resize(top_size);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+DocumentPage SearchServer::FindDocumentsPage(ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                             const std::optional<SearchCursor> &cursor, size_t page_size) const
+{
+    return FindDocumentsPage(policy, raw_query, document_predicate, nullptr, cursor, page_size);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+DocumentPage SearchServer::FindDocumentsPage(ExecutionPolicy &policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                             const DocumentBitmap *document_filter, const std::optional<SearchCursor> &cursor, size_t page_size) const
+{
+    using namespace std::string_literals;
+    if (page_size == 0)
+    {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    const auto query = ParseQuery(raw_query);
+    auto documents = FindAllDocuments(policy, query, document_predicate, document_filter);
+    if (cursor)
+    {
+        // everything ranked up to the cursor was on the previous pages
+        const Document last{cursor->document_id, cursor->relevance, cursor->rating};
+        documents.erase(std::remove_if(policy, documents.begin(), documents.end(), [&last](const Document &document)
+                                       { return !IsRankedHigher(last, document); }),
+                        documents.end());
+    }
+
+    DocumentPage page;
+    if (documents.size() > page_size)
+    {
+        std::nth_element(policy, documents.begin(), documents.begin() + page_size, documents.end(), IsRankedHigher);
+        documents.resize(page_size);
+        std::sort(policy, documents.begin(), documents.end(), IsRankedHigher);
+        const auto &last = documents.back();
+        page.next_cursor = SearchCursor{last.relevance, last.rating, last.id};
+    }
+    else
+    {
+        std::sort(policy, documents.begin(), documents.end(), IsRankedHigher);
+    }
+    page.documents = std::move(documents);
+    return page;
+}
+
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
                                                      DocumentPredicate document_predicate) const
@@ -170,81 +818,394 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
     return FindTopDocuments(policy, raw_query, document_predicate);
 }
 
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy, const std::string_view raw_query,
+                                                     DocumentPredicate document_predicate) const
+{
+    return FindTopDocumentsAutomatic(raw_query, document_predicate, nullptr);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsAutomatic(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                              const DocumentBitmap *document_filter) const
+{
+    const auto query = ParseQuery(raw_query);
+    // with the postings bound the cost is exact, wildcards included
+    const auto resolved_query = ResolveQuery(query, nullptr);
+    const size_t partition_count = ExecutionCostModel::Instance().ChooseParallelism(CountCandidatePostings(resolved_query, document_filter));
+    std::vector<Document> matched_documents;
+    if (partition_count > 1)
+    {
+        auto policy = std::execution::par;
+        matched_documents = FindAllDocuments(policy, query, resolved_query, nullptr, document_predicate, document_filter, partition_count);
+        KeepTopDocuments(policy, matched_documents);
+    }
+    else
+    {
+        auto policy = std::execution::seq;
+        matched_documents = FindAllDocuments(policy, query, resolved_query, nullptr, document_predicate, document_filter);
+        KeepTopDocuments(policy, matched_documents);
+    }
+    return matched_documents;
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy &policy, const Query &query,
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &policy, const PreparedQuery &prepared_query,
                                                      DocumentPredicate document_predicate) const
 {
-    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    return FindTopDocuments(policy, *GetPreparedQueryState(prepared_query), document_predicate, nullptr);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery &prepared_query, DocumentPredicate document_predicate) const
+{
+    std::execution::sequenced_policy policy;
+    return FindTopDocuments(policy, prepared_query, document_predicate);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(AutomaticExecutionPolicy, const PreparedQuery &prepared_query,
+                                                     DocumentPredicate document_predicate) const
+{
+    return FindTopDocumentsAutomatic(prepared_query, document_predicate, nullptr);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy &policy, const PreparedQueryState &state, DocumentPredicate document_predicate,
+                                                     const DocumentBitmap *document_filter, size_t partition_count) const
+{
+    auto matched_documents = FindAllDocuments(policy, state.query, state.resolved_query, &state.excluded_documents,
+                                              document_predicate, document_filter, partition_count);
+    KeepTopDocuments(policy, matched_documents);
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsAutomatic(const PreparedQuery &prepared_query, DocumentPredicate document_predicate,
+                                                              const DocumentBitmap *document_filter) const
+{
+    const auto state = GetPreparedQueryState(prepared_query);
+    // the postings are already bound, so the cost is exact here
+    const size_t partition_count = ExecutionCostModel::Instance().ChooseParallelism(CountCandidatePostings(state->resolved_query, document_filter));
+    if (partition_count > 1)
+    {
+        auto policy = std::execution::par;
+        return FindTopDocuments(policy, *state, document_predicate, document_filter, partition_count);
+    }
+    auto policy = std::execution::seq;
+    return FindTopDocuments(policy, *state, document_predicate, document_filter);
+}
+
+template <typename DocumentPredicate>
+std::future<std::vector<Document>> SearchServer::FindTopDocumentsAsync(const std::string &raw_query, DocumentPredicate document_predicate,
+                                                                       const QueryOptions &options) const
+{
+    return GetExecutor().Submit([this, raw_query, document_predicate]
+                                { return FindTopDocuments(raw_query, document_predicate); },
+                                options);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    using namespace std::string_literals;
+    if (!word_to_impact_postings_)
+    {
+        throw std::logic_error("Impact-ordered postings are not enabled, call EnableImpactOrderedPostings first"s);
+    }
+    const auto query = ParseQuery(raw_query);
+    if (std::any_of(query.plus_words.begin(), query.plus_words.end(), IsWildcard) || !query.phrases.empty() || HasProximityBoost(query))
+    {
+        return FindTopDocuments(raw_query, document_predicate);
+    }
+
+    std::vector<ImpactCursor> cursors;
+    for (const auto word : query.plus_words)
+    {
+        const auto postings = word_to_impact_postings_->find(word);
+        if (postings != word_to_impact_postings_->end() && !postings->second.empty())
+        {
+            cursors.push_back({word, &postings->second, log(GetDocumentCount() * 1.0 / postings->second.size())});
+        }
+    }
+    for (const auto word : query.required_words)
     {
-        std::map<int, double> document_to_relevance;
-        for (const std::string_view word : query.plus_words)
+        if (std::none_of(cursors.begin(), cursors.end(), [word](const ImpactCursor &cursor)
+                         { return cursor.word == word; }))
         {
-            if (word_to_document_freqs_.count(word) == 0)
+            return {};
+        }
+    }
+
+    // kept sorted by IsRankedHigher
+    std::vector<Document> top_documents;
+    DocumentBitmap seen_documents;
+    bool has_unread_postings = true;
+    while (has_unread_postings)
+    {
+        has_unread_postings = false;
+        for (auto &cursor : cursors)
+        {
+            if (cursor.position == cursor.postings->size())
             {
                 continue;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+            has_unread_postings = true;
+            const auto &posting = (*cursor.postings)[cursor.position++];
 
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+            if (cursors.size() == 1 && top_documents.size() == MAX_RESULT_DOCUMENT_COUNT &&
+                posting.rating < top_documents.back().rating &&
+                std::abs(posting.term_freq * cursor.inverse_document_freq - top_documents.back().relevance) < DIFF)
             {
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating))
-                {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                }
+                // the rest of this term frequency has the same relevance and no higher rating
+                const auto run_end = std::partition_point(cursor.postings->begin() + cursor.position, cursor.postings->end(),
+                                                          [&posting](const ImpactPosting &next)
+                                                          { return next.term_freq == posting.term_freq; });
+                cursor.position = run_end - cursor.postings->begin();
+                continue;
             }
-        }
 
-        for (const auto word : query.minus_words)
-        {
-            if (word_to_document_freqs_.count(word) == 0)
+            if (seen_documents.Contains(posting.document_id))
             {
                 continue;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+            seen_documents.Insert(posting.document_id);
+            if (!PassesMinusAndRequiredWords(query, posting.document_id) || !IsAcceptedDocument(posting.document_id, document_predicate))
             {
-                document_to_relevance.erase(document_id);
+                continue;
+            }
+            const Document document{posting.document_id, ComputeRelevance(cursors, posting.document_id), posting.rating};
+            top_documents.insert(std::upper_bound(top_documents.begin(), top_documents.end(), document, IsRankedHigher), document);
+            if (top_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+            {
+                top_documents.pop_back();
             }
         }
 
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance)
+        if (top_documents.size() == MAX_RESULT_DOCUMENT_COUNT)
         {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+            // no unread document scores more than the sum of the next postings
+            double threshold = 0.0;
+            for (const auto &cursor : cursors)
+            {
+                if (cursor.position < cursor.postings->size())
+                {
+                    threshold += (*cursor.postings)[cursor.position].term_freq * cursor.inverse_document_freq;
+                }
+            }
+            if (top_documents.back().relevance >= threshold + DIFF)
+            {
+                break;
+            }
         }
-        return matched_documents;
     }
+    return top_documents;
+}
+
+template <typename ExecutionPolicy>
+DocumentMatches SearchServer::MatchDocuments(ExecutionPolicy &policy, const Query &query, const std::vector<int> &document_ids) const
+{
+    DocumentMatches matches;
+    // unknown ids throw here, before the parallel passes
+    matches.statuses.reserve(document_ids.size());
+    for (const int document_id : document_ids)
+    {
+        matches.statuses.push_back(documents_.at(document_id).status);
+    }
+
+    // count, prefix sum, fill: each document writes its own slice of the buffer
+    matches.offsets.resize(document_ids.size() + 1);
+    std::transform(policy, document_ids.begin(), document_ids.end(), matches.offsets.begin() + 1, [&](int document_id)
+                   { return MatchDocumentWords(query, document_id, nullptr); });
+    std::inclusive_scan(policy, matches.offsets.begin() + 1, matches.offsets.end(), matches.offsets.begin() + 1);
+
+    matches.words.resize(matches.offsets.back());
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index)
+                  { MatchDocumentWords(query, document_ids[index], matches.words.data() + matches.offsets[index]); });
+    return matches;
+}
 
+template <typename DocumentPredicate>
+bool SearchServer::IsAcceptedDocument(int document_id, DocumentPredicate &document_predicate) const
+{
+    if constexpr (std::is_same_v<DocumentPredicate, AnyDocument>)
+    {
+        return true;
+    }
     else
     {
-        ConcurrentMap<int, double> document_to_relevance(15);
-        std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-                      [&](std::string_view word)
-                      {
-                          if (word_to_document_freqs_.count(word) == 0)
-                          {
-                              return;
-                          }
-                          const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-
-                          std::for_each(std::execution::par, word_to_document_freqs_.at(word).begin(), word_to_document_freqs_.at(word).end(),
-                                        [&](auto memb)
+        const auto &document_data = documents_.at(document_id);
+        return document_predicate(document_id, document_data.status, document_data.rating);
+    }
+}
+
+template <typename Postings, typename Visitor>
+void SearchServer::ForEachCandidatePosting(const Postings &postings, const DocumentBitmap *document_filter,
+                                           int first_id, int last_id, Visitor visit)
+{
+    if (document_filter != nullptr && document_filter->Size() < postings.size())
+    {
+        document_filter->ForEachInRange(first_id, last_id, [&](int document_id)
                                         {
-                                            const auto &document_data = documents_.at(memb.first);
-                                            if (document_predicate(memb.first, document_data.status, document_data.rating))
-                                            {
-                                                document_to_relevance[memb.first].ref_to_value += memb.second * inverse_document_freq;
-                                            }
-                                        });
-                      });
+            const auto *term_freq = FindTermFreq(postings, document_id);
+            if (term_freq != nullptr) {
+                visit(document_id, *term_freq);
+            } });
+        return;
+    }
+    auto posting = postings.begin();
+    if constexpr (std::is_same_v<Postings, FlatPostings>)
+    {
+        posting = std::lower_bound(postings.begin(), postings.end(), first_id, [](const auto &posting, int document_id)
+                                   { return posting.first < document_id; });
+    }
+    else
+    {
+        posting = postings.lower_bound(first_id);
+    }
+    for (; posting != postings.end() && posting->first < last_id; ++posting)
+    {
+        if (document_filter == nullptr || document_filter->Contains(posting->first))
+        {
+            visit(posting->first, posting->second);
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::AccumulateRelevance(const ResolvedQuery &resolved_query, const ExcludedDocuments &excluded_documents,
+                                                        DocumentPredicate &document_predicate, const DocumentBitmap *document_filter,
+                                                        int first_id, int last_id) const
+{
+    std::map<int, double> document_to_relevance;
+    for (const auto &term : resolved_query.plus_terms)
+    {
+        const double inverse_document_freq = term.inverse_document_freq;
+
+        const auto visit = [&](int document_id, double term_freq)
+        {
+            if (!excluded_documents.Contains(document_id) && IsAcceptedDocument(document_id, document_predicate))
+            {
+                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            }
+        };
+        if (term.postings != nullptr)
+        {
+            ForEachCandidatePosting(*term.postings, document_filter, first_id, last_id, visit);
+        }
+        else
+        {
+            ForEachCandidatePosting(*term.flat_postings, document_filter, first_id, last_id, visit);
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    for (const auto [document_id, relevance] : document_to_relevance)
+    {
+        matched_documents.push_back(
+            {document_id, relevance, documents_.at(document_id).rating});
+    }
+    return matched_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy &policy, const Query &query,
+                                                     DocumentPredicate document_predicate, const DocumentBitmap *document_filter,
+                                                     const CorpusStatistics *statistics) const
+{
+    const auto resolved_query = ResolveQuery(query, statistics);
+    return FindAllDocuments(policy, query, resolved_query, nullptr, document_predicate, document_filter);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy &policy, const Query &query, const ResolvedQuery &resolved_query,
+                                                     const ExcludedDocuments *excluded_documents, DocumentPredicate document_predicate,
+                                                     const DocumentBitmap *document_filter, size_t partition_count) const
+{
+    if (!query.required_words.empty())
+    {
+        return FindAllDocumentsConjunctive(policy, query, resolved_query, excluded_documents, document_predicate, document_filter);
+    }
+    std::optional<ExcludedDocuments> resolved_excluded_documents;
+    if (excluded_documents == nullptr)
+    {
+        resolved_excluded_documents = ResolveMinusWords(query, CountCandidatePostings(resolved_query, document_filter));
+        excluded_documents = &*resolved_excluded_documents;
+    }
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        return AccumulateRelevance(resolved_query, *excluded_documents, document_predicate, document_filter,
+                                   0, std::numeric_limits<int>::max());
+    }
+
+    else
+    {
+        // every id range is walked like the sequential branch, so par visits the same postings
+        // and adds them up in the same order, with no lock between the ranges
+        const auto ranges = SplitDocumentIds(partition_count > 0 ? partition_count : std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<std::vector<Document>> range_documents(ranges.size());
+        std::transform(std::execution::par, ranges.begin(), ranges.end(), range_documents.begin(), [&](const std::pair<int, int> &range)
+                       { return AccumulateRelevance(resolved_query, *excluded_documents, document_predicate, document_filter,
+                                                    range.first, range.second); });
 
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap())
+        for (auto &documents : range_documents)
         {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+            matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
         }
         return matched_documents;
     }
 }
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(ExecutionPolicy &policy, const Query &query, const ResolvedQuery &resolved_query,
+                                                                const ExcludedDocuments *excluded_documents, DocumentPredicate document_predicate,
+                                                                const DocumentBitmap *document_filter) const
+{
+    if (resolved_query.has_missing_required_word)
+    {
+        return {};
+    }
+    std::vector<const std::vector<int> *> required_postings;
+    for (const auto &term : resolved_query.required_terms)
+    {
+        required_postings.push_back(term.document_ids);
+    }
+    const auto candidates = IntersectPostingLists(std::move(required_postings));
+    std::optional<ExcludedDocuments> resolved_excluded_documents;
+    if (excluded_documents == nullptr)
+    {
+        resolved_excluded_documents = ResolveMinusWords(query, candidates.size());
+        excluded_documents = &*resolved_excluded_documents;
+    }
+
+    std::vector<Document> matched_documents(candidates.size());
+    std::transform(policy, candidates.begin(), candidates.end(), matched_documents.begin(),
+                   [&](int document_id)
+                   {
+                       if ((document_filter != nullptr && !document_filter->Contains(document_id)) ||
+                           excluded_documents->Contains(document_id) || !IsAcceptedDocument(document_id, document_predicate) ||
+                           !ContainsQueryPhrases(query, document_id))
+                       {
+                           return Document{-1, 0.0, 0};
+                       }
+                       double relevance = 0.0;
+                       for (const auto &term : resolved_query.plus_terms)
+                       {
+                           const auto *term_freq = term.postings != nullptr ? FindTermFreq(*term.postings, document_id)
+                                                                            : FindTermFreq(*term.flat_postings, document_id);
+                           if (term_freq != nullptr)
+                           {
+                               relevance += *term_freq * term.inverse_document_freq;
+                           }
+                       }
+                       relevance *= ComputeProximityBoost(query, document_id);
+                       return Document{document_id, relevance, documents_.at(document_id).rating};
+                   });
+    matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [](const Document &document)
+                                           { return document.id < 0; }),
+                            matched_documents.end());
+    return matched_documents;
+}
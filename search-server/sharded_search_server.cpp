@@ -0,0 +1,192 @@
+#include "sharded_search_server.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <set>
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const std::string &stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWords(stop_words_text))
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                                      const std::vector<int> &ratings)
+{
+    using namespace std::string_literals;
+    if (document_id < 0)
+    {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument> &documents)
+{
+    using namespace std::string_literals;
+    std::vector<std::vector<const NewDocument *>> shard_documents(shards_.size());
+    for (const auto &document : documents)
+    {
+        if (document.document_id < 0)
+        {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+        shard_documents[GetShardIndex(document.document_id)].push_back(&document);
+    }
+    // an exception must not leave a parallel algorithm, so every shard keeps its own
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(policy, shard_indexes.begin(), shard_indexes.end(),
+                  [&](size_t shard_index)
+                  {
+                      try
+                      {
+                          for (const auto *document : shard_documents[shard_index])
+                          {
+                              shards_[shard_index].AddDocument(document->document_id, document->text, document->status, document->ratings);
+                          }
+                      }
+                      catch (...)
+                      {
+                          errors[shard_index] = std::current_exception();
+                      }
+                  });
+    for (const auto &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void ShardedSearchServer::AddDocuments(std::execution::sequenced_policy, const std::vector<NewDocument> &documents)
+{
+    for (const auto &document : documents)
+    {
+        AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id)
+{
+    GetShard(document_id).RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, SearchServer::AnyDocument{}, [status](const SearchServer &shard)
+                            { return &shard.GetDocumentsWithStatus(status); });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, SearchServer::AnyDocument{}, [status](const SearchServer &shard)
+                            { return &shard.GetDocumentsWithStatus(status); });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const
+{
+    std::execution::sequenced_policy policy;
+    return FindTopDocuments(policy, raw_query, status);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const std::string_view raw_query,
+                                                                                             int document_id) const
+{
+    return GetShard(document_id).MatchDocument(ParseQuery(raw_query), document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const
+{
+    return std::accumulate(shards_.begin(), shards_.end(), 0, [](int count, const SearchServer &shard)
+                           { return count + shard.GetDocumentCount(); });
+}
+
+size_t ShardedSearchServer::GetShardCount() const
+{
+    return shards_.size();
+}
+
+SearchServer::Query ShardedSearchServer::ParseQuery(const std::string_view raw_query) const
+{
+    // every shard has the same stop words, so any of them parses the query; the wildcards are expanded here instead
+    auto query = shards_.front().ParseQuery(raw_query, true, false);
+    for (const auto pattern : query.plus_words)
+    {
+        if (!SearchServer::IsWildcard(pattern))
+        {
+            continue;
+        }
+        query.wildcard_terms.emplace(pattern, SelectCorpusTerms(pattern));
+    }
+    return query;
+}
+
+std::vector<std::string_view> ShardedSearchServer::SelectCorpusTerms(const std::string_view pattern) const
+{
+    // Threshold algorithm: a term no shard lists among its depth most frequent has at most the sum of the last listed
+    // frequencies, so the corpus-wide top is settled once its last term is above that sum
+    for (size_t depth = MAX_WILDCARD_EXPANSION;; depth *= 2)
+    {
+        // the terms point into the dictionaries of the shards, which outlive the query
+        std::set<std::string_view> listed_terms;
+        size_t unlisted_bound = 0;
+        bool is_complete = true;
+        for (const auto &shard : shards_)
+        {
+            const auto terms = shard.CollectWildcardTerms(pattern, depth);
+            for (const auto &[_, term] : terms)
+            {
+                listed_terms.insert(term);
+            }
+            if (terms.size() == depth)
+            {
+                unlisted_bound += terms.back().first;
+                is_complete = false;
+            }
+        }
+        std::vector<std::pair<size_t, std::string_view>> corpus_terms;
+        for (const auto term : listed_terms)
+        {
+            const size_t document_freq = std::accumulate(shards_.begin(), shards_.end(), size_t{0}, [term](size_t sum, const SearchServer &shard)
+                                                         { return sum + shard.GetDocumentFreq(term); });
+            corpus_terms.push_back({document_freq, term});
+        }
+        // a shard that filled its list listed at least MAX_WILDCARD_EXPANSION terms
+        if (!is_complete)
+        {
+            std::nth_element(corpus_terms.begin(), corpus_terms.begin() + (MAX_WILDCARD_EXPANSION - 1), corpus_terms.end(),
+                             [](const auto &lhs, const auto &rhs)
+                             { return lhs.first > rhs.first; });
+            // an unlisted term as frequent as the last one could still win the tie by its spelling
+            if (corpus_terms[MAX_WILDCARD_EXPANSION - 1].first <= unlisted_bound)
+            {
+                continue;
+            }
+        }
+        return SearchServer::SelectFrequentTerms(std::move(corpus_terms), MAX_WILDCARD_EXPANSION);
+    }
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const
+{
+    // Fibonacci hashing: consecutive ids still spread evenly over the shards
+    const uint64_t hash = static_cast<uint64_t>(document_id) * 0x9E3779B97F4A7C15ull;
+    return (hash >> 32) % shards_.size();
+}
+
+const SearchServer &ShardedSearchServer::GetShard(int document_id) const
+{
+    return shards_[GetShardIndex(document_id)];
+}
+
+SearchServer &ShardedSearchServer::GetShard(int document_id)
+{
+    return const_cast<SearchServer &>(static_cast<const ShardedSearchServer &>(*this).GetShard(document_id));
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "search_server.h"
+#include <deque>
+#include <exception>
+#include <execution>
+#include <string>
+#include <vector>
+
+// Documents are spread over independent SearchServer shards by id hash.
+// A query runs on all shards in parallel with corpus-wide IDF, so the result matches one big server
+class ShardedSearchServer
+{
+public:
+    struct NewDocument
+    {
+        int document_id = 0;
+        std::string_view text;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        std::vector<int> ratings;
+    };
+
+    template <typename StringContainer>
+    ShardedSearchServer(size_t shard_count, const StringContainer &stop_words);
+
+    ShardedSearchServer(size_t shard_count, const std::string &stop_words_text);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    // Ingest on all shards at once: the batch is grouped by shard, and each shard adds its documents in batch order
+    // on a thread of its own. If a document fails, the first error is rethrown once all shards are done;
+    // the documents added before it stay, as after a loop of AddDocument
+    void AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument> &documents);
+
+    void AddDocuments(std::execution::sequenced_policy policy, const std::vector<NewDocument> &documents);
+
+    void RemoveDocument(int document_id);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                           DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
+                                                                            int document_id) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+private:
+    // deque: shards are never moved, the maps of a shard point into its own storage
+    std::deque<SearchServer> shards_;
+
+    // A wildcard is expanded to the most frequent terms of the whole corpus, the same list for every shard
+    SearchServer::Query ParseQuery(const std::string_view raw_query) const;
+
+    // The MAX_WILDCARD_EXPANSION terms matching the pattern with the largest document frequency over all shards
+    std::vector<std::string_view> SelectCorpusTerms(const std::string_view pattern) const;
+
+    size_t GetShardIndex(int document_id) const;
+    const SearchServer &GetShard(int document_id) const;
+    SearchServer &GetShard(int document_id);
+
+    // filter_for_shard returns the candidate bitmap of a shard or nullptr
+    template <typename ExecutionPolicy, typename DocumentPredicate, typename ShardFilter>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                           DocumentPredicate document_predicate, ShardFilter filter_for_shard) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const StringContainer &stop_words)
+{
+    using namespace std::string_literals;
+    if (shard_count == 0)
+    {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                                            DocumentPredicate document_predicate) const
+{
+    return FindTopDocuments(policy, raw_query, document_predicate, [](const SearchServer &) -> const DocumentBitmap *
+                            { return nullptr; });
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename ShardFilter>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy &policy, const std::string_view raw_query,
+                                                            DocumentPredicate document_predicate, ShardFilter filter_for_shard) const
+{
+    const auto query = ParseQuery(raw_query);
+
+    SearchServer::CorpusStatistics statistics;
+    for (const auto &shard : shards_)
+    {
+        shard.CollectStatistics(query, statistics);
+    }
+
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_results.begin(),
+                   [&](const SearchServer &shard)
+                   {
+                       auto matched_documents = shard.FindAllDocuments(policy, query, document_predicate,
+                                                                       filter_for_shard(shard), &statistics);
+                       SearchServer::KeepTopDocuments(policy, matched_documents);
+                       return matched_documents;
+                   });
+
+    std::vector<Document> result;
+    for (const auto &matched_documents : shard_results)
+    {
+        result.insert(result.end(), matched_documents.begin(), matched_documents.end());
+    }
+    std::execution::sequenced_policy merge_policy;
+    SearchServer::KeepTopDocuments(merge_policy, result);
+    return result;
+}
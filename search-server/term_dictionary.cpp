@@ -0,0 +1,508 @@
+#include "term_dictionary.h"
+#include "memory_usage.h"
+#include "posting_lists.h"
+#include <algorithm>
+#include <queue>
+
+namespace
+{
+    void AppendVarint(uint32_t value, std::string &out)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    uint32_t ReadVarint(std::string_view data, size_t &position)
+    {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const auto byte = static_cast<unsigned char>(data[position++]);
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (byte < 0x80)
+            {
+                return value;
+            }
+        }
+    }
+
+    // Decodes the terms of one block in order; each term is the shared prefix length, the suffix length and the suffix
+    class BlockReader
+    {
+    public:
+        BlockReader(std::string_view blocks, size_t offset)
+            : blocks_(blocks),
+              position_(offset)
+        {
+        }
+
+        const std::string &Next()
+        {
+            const size_t shared = ReadVarint(blocks_, position_);
+            const size_t length = ReadVarint(blocks_, position_);
+            term_.resize(shared);
+            term_.append(blocks_.substr(position_, length));
+            position_ += length;
+            return term_;
+        }
+
+    private:
+        std::string_view blocks_;
+        size_t position_;
+        std::string term_;
+    };
+
+    uint32_t GetTrigram(std::string_view text, size_t position)
+    {
+        return static_cast<uint32_t>(static_cast<unsigned char>(text[position])) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[position + 1])) << 8 |
+               static_cast<unsigned char>(text[position + 2]);
+    }
+
+    // The literal runs between the '*' of a pattern
+    std::vector<std::string_view> SplitLiterals(std::string_view pattern)
+    {
+        std::vector<std::string_view> literals;
+        while (!pattern.empty())
+        {
+            const auto star = pattern.find('*');
+            if (star != 0)
+            {
+                literals.push_back(pattern.substr(0, star));
+            }
+            if (star == pattern.npos)
+            {
+                break;
+            }
+            pattern.remove_prefix(star + 1);
+        }
+        return literals;
+    }
+
+    // The smallest string above every string that starts with prefix, nullopt if there is none
+    std::optional<std::string> GetPrefixEnd(std::string_view prefix)
+    {
+        std::string end{prefix};
+        while (!end.empty() && static_cast<unsigned char>(end.back()) == 0xFF)
+        {
+            end.pop_back();
+        }
+        if (end.empty())
+        {
+            return std::nullopt;
+        }
+        end.back() = static_cast<char>(static_cast<unsigned char>(end.back()) + 1);
+        return end;
+    }
+}
+
+bool MatchesWildcard(std::string_view pattern, std::string_view word)
+{
+    size_t pattern_pos = 0;
+    size_t word_pos = 0;
+    size_t star_pos = pattern.npos;
+    size_t star_word_pos = 0;
+    while (word_pos < word.size())
+    {
+        if (pattern_pos < pattern.size() && pattern[pattern_pos] == '*')
+        {
+            star_pos = pattern_pos++;
+            star_word_pos = word_pos;
+        }
+        else if (pattern_pos < pattern.size() && pattern[pattern_pos] == word[word_pos])
+        {
+            ++pattern_pos;
+            ++word_pos;
+        }
+        else if (star_pos != pattern.npos)
+        {
+            // let the last '*' swallow one more character
+            pattern_pos = star_pos + 1;
+            word_pos = ++star_word_pos;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*')
+    {
+        ++pattern_pos;
+    }
+    return pattern_pos == pattern.size();
+}
+
+void TermDictionary::AddDocument(std::string_view term)
+{
+    if (const auto term_id = FindTermId(term))
+    {
+        const uint32_t document_freq = ++document_freqs_[*term_id];
+        auto &block_max_freq = block_max_freqs_[*term_id / BLOCK_SIZE];
+        block_max_freq = std::max(block_max_freq, document_freq);
+        return;
+    }
+    auto pending_term = pending_.find(term);
+    if (pending_term != pending_.end())
+    {
+        ++pending_term->second;
+        return;
+    }
+    pending_.emplace(term, 1);
+    if (pending_.size() > std::max(MIN_PENDING_TERMS, GetTermCount() / PENDING_FRACTION))
+    {
+        Merge();
+    }
+}
+
+void TermDictionary::RemoveDocument(std::string_view term)
+{
+    if (const auto term_id = FindTermId(term))
+    {
+        if (document_freqs_[*term_id] > 0)
+        {
+            --document_freqs_[*term_id];
+        }
+        return;
+    }
+    const auto pending_term = pending_.find(term);
+    if (pending_term != pending_.end() && pending_term->second > 0)
+    {
+        --pending_term->second;
+    }
+}
+
+std::vector<std::pair<size_t, std::string>> TermDictionary::FindFrequentTerms(std::string_view pattern, size_t limit) const
+{
+    using Term = std::pair<size_t, std::string>;
+    const auto is_better = [](const Term &lhs, const Term &rhs)
+    {
+        return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    };
+    if (limit == 0)
+    {
+        return {};
+    }
+    // the worst of the kept terms on top; once limit terms are kept, a rarer one cannot enter
+    std::priority_queue<Term, std::vector<Term>, decltype(is_better)> kept(is_better);
+    size_t min_document_freq = 1;
+    VisitMatches(pattern, min_document_freq, [&](std::string_view term, size_t document_freq)
+                 {
+        if (kept.size() < limit)
+        {
+            kept.push({document_freq, std::string{term}});
+        }
+        else if (document_freq > kept.top().first || (document_freq == kept.top().first && term < kept.top().second))
+        {
+            kept.pop();
+            kept.push({document_freq, std::string{term}});
+        }
+        if (kept.size() == limit)
+        {
+            min_document_freq = kept.top().first;
+        }
+        return true; });
+
+    std::vector<Term> terms;
+    while (!kept.empty())
+    {
+        terms.push_back(kept.top());
+        kept.pop();
+    }
+    std::reverse(terms.begin(), terms.end());
+    return terms;
+}
+
+std::optional<std::vector<std::string>> TermDictionary::FindAllTerms(std::string_view pattern, size_t max_count) const
+{
+    std::vector<std::string> terms;
+    bool is_over = false;
+    const size_t min_document_freq = 1;
+    VisitMatches(pattern, min_document_freq, [&](std::string_view term, size_t)
+                 {
+        if (terms.size() == max_count)
+        {
+            is_over = true;
+            return false;
+        }
+        terms.emplace_back(term);
+        return true; });
+    if (is_over)
+    {
+        return std::nullopt;
+    }
+    return terms;
+}
+
+bool TermDictionary::HasTrigram(std::string_view pattern)
+{
+    const auto literals = SplitLiterals(pattern);
+    return std::any_of(literals.begin(), literals.end(), [](std::string_view literal)
+                       { return literal.size() >= 3; });
+}
+
+size_t TermDictionary::GetMemoryUsage() const
+{
+    size_t bytes = GetBufferMemory(blocks_) + GetBufferMemory(block_offsets_) + GetBufferMemory(block_max_freqs_) +
+                   GetBufferMemory(document_freqs_) +
+                   trigram_to_terms_.size() * GetUnorderedMapNodeSize<uint32_t, std::vector<int>>() +
+                   trigram_to_terms_.bucket_count() * sizeof(void *) +
+                   pending_.size() * GetMapNodeSize<std::string, uint32_t, std::less<>>();
+    for (const auto &[_, term_ids] : trigram_to_terms_)
+    {
+        bytes += GetBufferMemory(term_ids);
+    }
+    for (const auto &[term, _] : pending_)
+    {
+        bytes += GetBufferMemory(term);
+    }
+    return bytes;
+}
+
+size_t TermDictionary::EstimateTermMemory(std::string_view term) const
+{
+    const size_t pending_memory = GetMapNodeSize<std::string, uint32_t, std::less<>>() +
+                                  (term.size() > std::string().capacity() ? term.size() + 1 : 0);
+    // two varints of up to 5 bytes, the document frequency, and a block offset and maximum as if the term had a block of its own
+    const size_t block_memory = term.size() + 10 + 3 * sizeof(uint32_t);
+    // every trigram is taken to open a list of its own
+    const size_t trigram_count = term.size() >= 3 ? term.size() - 2 : 0;
+    const size_t trigram_memory = trigram_count * (sizeof(int) + GetUnorderedMapNodeSize<uint32_t, std::vector<int>>() + sizeof(void *));
+    return pending_memory + block_memory + trigram_memory;
+}
+
+size_t TermDictionary::GetTermCount() const
+{
+    return document_freqs_.size();
+}
+
+std::string_view TermDictionary::GetFirstTerm(size_t block) const
+{
+    size_t position = block_offsets_[block];
+    ReadVarint(blocks_, position); // nothing is shared with the previous block
+    const size_t length = ReadVarint(blocks_, position);
+    return std::string_view(blocks_).substr(position, length);
+}
+
+size_t TermDictionary::LowerBound(std::string_view key) const
+{
+    // the first block starting at key or above; the answer is in the block before it or is its first term
+    size_t low = 0;
+    size_t high = block_offsets_.size();
+    while (low < high)
+    {
+        const size_t middle = (low + high) / 2;
+        if (GetFirstTerm(middle) < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if (low == 0)
+    {
+        return 0;
+    }
+    const size_t block = low - 1;
+    BlockReader reader(blocks_, block_offsets_[block]);
+    const size_t block_end = std::min(GetTermCount(), low * BLOCK_SIZE);
+    for (size_t term_id = block * BLOCK_SIZE; term_id < block_end; ++term_id)
+    {
+        if (!(reader.Next() < key))
+        {
+            return term_id;
+        }
+    }
+    return block_end;
+}
+
+std::optional<size_t> TermDictionary::FindTermId(std::string_view term) const
+{
+    const size_t term_id = LowerBound(term);
+    if (term_id < GetTermCount() && DecodeTerm(term_id) == term)
+    {
+        return term_id;
+    }
+    return std::nullopt;
+}
+
+std::string TermDictionary::DecodeTerm(size_t term_id) const
+{
+    const size_t block = term_id / BLOCK_SIZE;
+    BlockReader reader(blocks_, block_offsets_[block]);
+    for (size_t i = block * BLOCK_SIZE; i < term_id; ++i)
+    {
+        reader.Next();
+    }
+    return reader.Next();
+}
+
+void TermDictionary::VisitMatches(std::string_view pattern, const size_t &min_document_freq,
+                                  const std::function<bool(std::string_view, size_t)> &visit) const
+{
+    const auto prefix = pattern.substr(0, pattern.find('*'));
+    for (auto it = pending_.lower_bound(prefix); it != pending_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+    {
+        if (it->second > 0 && it->second >= min_document_freq && MatchesWildcard(pattern, it->first) && !visit(it->first, it->second))
+        {
+            return;
+        }
+    }
+
+    const size_t first = LowerBound(prefix);
+    const auto prefix_end = GetPrefixEnd(prefix);
+    const size_t last = prefix_end ? LowerBound(*prefix_end) : GetTermCount();
+    const auto candidates = last - first > BLOCK_SIZE ? FindTrigramCandidates(pattern) : std::nullopt;
+    if (candidates)
+    {
+        // a term's frequency is checked before the term is decoded
+        for (auto term_id = std::lower_bound(candidates->begin(), candidates->end(), static_cast<int>(first));
+             term_id != candidates->end() && static_cast<size_t>(*term_id) < last; ++term_id)
+        {
+            const size_t document_freq = document_freqs_[*term_id];
+            if (document_freq == 0 || document_freq < min_document_freq)
+            {
+                continue;
+            }
+            const auto term = DecodeTerm(*term_id);
+            if (MatchesWildcard(pattern, term) && !visit(term, document_freq))
+            {
+                return;
+            }
+        }
+        return;
+    }
+    for (size_t block = first / BLOCK_SIZE; block * BLOCK_SIZE < last; ++block)
+    {
+        if (block_max_freqs_[block] < std::max<size_t>(min_document_freq, 1))
+        {
+            continue;
+        }
+        BlockReader reader(blocks_, block_offsets_[block]);
+        const size_t block_end = std::min(last, (block + 1) * BLOCK_SIZE);
+        for (size_t term_id = block * BLOCK_SIZE; term_id < block_end; ++term_id)
+        {
+            const auto &term = reader.Next();
+            const size_t document_freq = document_freqs_[term_id];
+            if (term_id < first || document_freq == 0 || document_freq < min_document_freq)
+            {
+                continue;
+            }
+            if (MatchesWildcard(pattern, term) && !visit(term, document_freq))
+            {
+                return;
+            }
+        }
+    }
+}
+
+std::optional<std::vector<int>> TermDictionary::FindTrigramCandidates(std::string_view pattern) const
+{
+    std::vector<uint32_t> trigrams;
+    for (const auto literal : SplitLiterals(pattern))
+    {
+        for (size_t position = 0; position + 3 <= literal.size(); ++position)
+        {
+            trigrams.push_back(GetTrigram(literal, position));
+        }
+    }
+    if (trigrams.empty())
+    {
+        return std::nullopt;
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    std::vector<const std::vector<int> *> lists;
+    for (const auto trigram : trigrams)
+    {
+        const auto term_ids = trigram_to_terms_.find(trigram);
+        if (term_ids == trigram_to_terms_.end())
+        {
+            return std::vector<int>{};
+        }
+        lists.push_back(&term_ids->second);
+    }
+    return IntersectPostingLists(std::move(lists));
+}
+
+void TermDictionary::Merge()
+{
+    std::vector<std::pair<std::string, uint32_t>> terms;
+    terms.reserve(GetTermCount() + pending_.size());
+    for (size_t block = 0; block < block_offsets_.size(); ++block)
+    {
+        BlockReader reader(blocks_, block_offsets_[block]);
+        const size_t block_end = std::min(GetTermCount(), (block + 1) * BLOCK_SIZE);
+        for (size_t term_id = block * BLOCK_SIZE; term_id < block_end; ++term_id)
+        {
+            const auto &term = reader.Next();
+            if (document_freqs_[term_id] > 0)
+            {
+                terms.emplace_back(term, document_freqs_[term_id]);
+            }
+        }
+    }
+    const auto blocked_end = terms.size();
+    for (const auto &[term, document_freq] : pending_)
+    {
+        if (document_freq > 0)
+        {
+            terms.emplace_back(term, document_freq);
+        }
+    }
+    std::inplace_merge(terms.begin(), terms.begin() + blocked_end, terms.end());
+
+    std::string blocks;
+    std::vector<uint32_t> block_offsets;
+    std::vector<uint32_t> block_max_freqs;
+    std::vector<uint32_t> document_freqs;
+    std::unordered_map<uint32_t, std::vector<int>> trigram_to_terms;
+    std::string_view previous;
+    for (size_t term_id = 0; term_id < terms.size(); ++term_id)
+    {
+        const auto &[term, document_freq] = terms[term_id];
+        if (term_id % BLOCK_SIZE == 0)
+        {
+            block_offsets.push_back(static_cast<uint32_t>(blocks.size()));
+            block_max_freqs.push_back(0);
+            previous = {};
+        }
+        const size_t shared = std::mismatch(previous.begin(), previous.end(), term.begin(), term.end()).first - previous.begin();
+        AppendVarint(static_cast<uint32_t>(shared), blocks);
+        AppendVarint(static_cast<uint32_t>(term.size() - shared), blocks);
+        blocks.append(term, shared);
+        block_max_freqs.back() = std::max(block_max_freqs.back(), document_freq);
+        document_freqs.push_back(document_freq);
+        for (size_t position = 0; position + 3 <= term.size(); ++position)
+        {
+            auto &term_ids = trigram_to_terms[GetTrigram(term, position)];
+            if (term_ids.empty() || term_ids.back() != static_cast<int>(term_id))
+            {
+                term_ids.push_back(static_cast<int>(term_id));
+            }
+        }
+        previous = term;
+    }
+    // sized to the content, which is what EstimateTermMemory counts on
+    blocks.shrink_to_fit();
+    block_offsets.shrink_to_fit();
+    block_max_freqs.shrink_to_fit();
+    document_freqs.shrink_to_fit();
+    for (auto &[_, term_ids] : trigram_to_terms)
+    {
+        term_ids.shrink_to_fit();
+    }
+    trigram_to_terms.rehash(0);
+
+    blocks_ = std::move(blocks);
+    block_offsets_ = std::move(block_offsets);
+    block_max_freqs_ = std::move(block_max_freqs);
+    document_freqs_ = std::move(document_freqs);
+    trigram_to_terms_ = std::move(trigram_to_terms);
+    pending_.clear();
+}
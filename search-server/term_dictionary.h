@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// '*' matches any sequence of characters
+bool MatchesWildcard(std::string_view pattern, std::string_view word);
+
+// Sorted terms with their document frequencies, for wildcard enumeration over a large vocabulary.
+// The terms sit front-coded in blocks of BLOCK_SIZE: the first one in full, the others as the length
+// of the prefix shared with the previous term and the rest of the bytes. A term id is its position in that order.
+// Each block keeps an upper bound of its document frequencies, so an enumeration capped to the most frequent terms
+// skips the blocks that cannot enter the result, and a trigram index finds the terms holding a literal run of a pattern
+// that has no useful prefix. New terms wait in a small map and are merged into the blocks once it outgrows
+// a fraction of them; the merge drops the terms left without documents
+class TermDictionary
+{
+public:
+    // One more document holds the term
+    void AddDocument(std::string_view term);
+
+    // One document less holds the term
+    void RemoveDocument(std::string_view term);
+
+    // {document frequency, term} of the at most limit terms with documents that match the pattern, most frequent first,
+    // ties go to the smaller term
+    std::vector<std::pair<size_t, std::string>> FindFrequentTerms(std::string_view pattern, size_t limit) const;
+
+    // Every term with documents that matches the pattern, nullopt as soon as there are more than max_count
+    std::optional<std::vector<std::string>> FindAllTerms(std::string_view pattern, size_t max_count) const;
+
+    // A pattern without a literal prefix is looked up through the trigrams of its literal runs, so it needs one of 3 characters
+    static bool HasTrigram(std::string_view pattern);
+
+    size_t GetMemoryUsage() const;
+
+    // Upper bound of the bytes a new term adds: its pending entry and its share of the blocks and trigram lists after the merge
+    size_t EstimateTermMemory(std::string_view term) const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 16;
+    // the pending terms are merged once there are more than this many and more than term count / PENDING_FRACTION
+    static constexpr size_t MIN_PENDING_TERMS = 1024;
+    static constexpr size_t PENDING_FRACTION = 8;
+
+    std::string blocks_;
+    std::vector<uint32_t> block_offsets_;
+    std::vector<uint32_t> block_max_freqs_; // only raised between merges, so an upper bound
+    std::vector<uint32_t> document_freqs_;  // by term id
+    std::unordered_map<uint32_t, std::vector<int>> trigram_to_terms_; // sorted term ids
+    std::map<std::string, uint32_t, std::less<>> pending_;
+
+    size_t GetTermCount() const;
+    std::string_view GetFirstTerm(size_t block) const;
+    // First term id whose term is not less than key
+    size_t LowerBound(std::string_view key) const;
+    std::optional<size_t> FindTermId(std::string_view term) const;
+    std::string DecodeTerm(size_t term_id) const;
+
+    // Calls visit(term, document_freq) for the terms that match the pattern and have at least min_document_freq documents
+    // until it returns false. min_document_freq may grow while the visit goes on
+    void VisitMatches(std::string_view pattern, const size_t &min_document_freq,
+                      const std::function<bool(std::string_view, size_t)> &visit) const;
+
+    // Sorted ids of the blocked terms holding every trigram of the pattern, nullopt if it has none
+    std::optional<std::vector<int>> FindTrigramCandidates(std::string_view pattern) const;
+
+    void Merge();
+};
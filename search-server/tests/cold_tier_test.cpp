@@ -0,0 +1,251 @@
+#include "../block_cache.h"
+#include "../search_server.h"
+#include "test_framework.h"
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <tuple>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"w1"s, "w1 w2 w3"s, "w1500 w1700 -w3"s, "+w5 +w10 w7"s, "w12*"s, "w19* -w1*"s, "+w1999 w3"s,
+                                    "w17 -w18*"s, "zzz"s, "w1 w1 -w1"s, "+w100 +w200"s, "w4 w44 w444 w1444 -w0"s};
+
+    string GetTierPath(const string &name)
+    {
+        return (filesystem::temp_directory_path() / ("cold_tier_test_"s + name)).string();
+    }
+
+    // Postings read back from the cold tier must give the very same relevance, not just a close one
+    void AssertSameDocuments(const vector<Document> &actual, const vector<Document> &expected, const string &hint)
+    {
+        ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+        for (size_t i = 0; i < actual.size(); ++i)
+        {
+            ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+            ASSERT_HINT(actual[i].relevance == expected[i].relevance, hint);
+        }
+    }
+
+    void AssertSameResults(const SearchServer &tiered, SearchServer &in_memory, const string &budget_hint)
+    {
+        const auto is_selected = [](int document_id, DocumentStatus, int rating)
+        {
+            return rating > 3 && document_id % 2 != 0;
+        };
+        for (const auto &raw_query : QUERIES)
+        {
+            // the misspelt word goes through the fuzzy correction over the tiered dictionary
+            for (const auto &query : {raw_query, raw_query + " w1x9"s})
+            {
+                const auto hint = query + " "s + budget_hint;
+                AssertSameDocuments(tiered.FindTopDocuments(query), in_memory.FindTopDocuments(query), hint);
+                AssertSameDocuments(tiered.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                                    in_memory.FindTopDocuments(execution::par, query, DocumentStatus::BANNED), hint);
+                AssertSameDocuments(tiered.FindTopDocuments(query, is_selected), in_memory.FindTopDocuments(query, is_selected), hint);
+                AssertSameDocuments(tiered.FindTopDocuments(tiered.PrepareQuery(query)),
+                                    in_memory.FindTopDocuments(in_memory.PrepareQuery(query)), hint);
+                AssertSameDocuments(tiered.FindDocumentsPage(query, nullopt, 50).documents,
+                                    in_memory.FindDocumentsPage(query, nullopt, 50).documents, hint);
+                AssertSameDocuments(tiered.FindTopDocuments(automatic_execution, query, DocumentStatus::ACTUAL),
+                                    in_memory.FindTopDocuments(automatic_execution, query, DocumentStatus::ACTUAL), hint);
+            }
+        }
+        for (const int document_id : in_memory)
+        {
+            if (document_id % 11 != 0)
+            {
+                continue;
+            }
+            const auto hint = to_string(document_id) + " "s + budget_hint;
+            ASSERT_HINT(tiered.GetWordFrequencies(document_id) == in_memory.GetWordFrequencies(document_id), hint);
+            ASSERT_HINT(tiered.MatchDocument("w1 w2 w3 w1*"s, document_id) == in_memory.MatchDocument("w1 w2 w3 w1*"s, document_id), hint);
+        }
+    }
+}
+
+void TestBlockCacheResistsScans()
+{
+    const size_t block_count = 64;
+    BlockCache cache(block_count * 10, 10);
+    const auto make_block = []()
+    {
+        return make_shared<const string>(string(10, 'x'));
+    };
+    const auto request = [&](uint64_t block_index)
+    {
+        if (!cache.Find(block_index))
+        {
+            cache.Insert(block_index, make_block());
+        }
+    };
+    for (int round = 0; round < 5; ++round)
+    {
+        for (uint64_t block_index = 1; block_index <= block_count; ++block_index)
+        {
+            request(block_index);
+        }
+    }
+    // a single pass over many blocks must not flush the often requested ones
+    for (uint64_t block_index = 100000; block_index < 100000 + 5 * block_count; ++block_index)
+    {
+        request(block_index);
+    }
+    size_t kept = 0;
+    for (uint64_t block_index = 1; block_index <= block_count; ++block_index)
+    {
+        kept += cache.Find(block_index) != nullptr;
+    }
+    ASSERT(kept >= block_count * 7 / 8);
+    ASSERT(cache.GetStats().bytes <= block_count * 10);
+}
+
+void TestColdTierRanksLikeMemory()
+{
+    mt19937 generator(5);
+    const auto make_text = [&generator](int document_id)
+    {
+        string text;
+        const int word_count = 3 + static_cast<int>(generator() % 15);
+        for (int i = 0; i < word_count; ++i)
+        {
+            // skewed towards small numbers, so some terms stay hot and most go cold
+            text += "w"s + to_string(min(generator() % 2000, generator() % 2000)) + " "s;
+        }
+        if (document_id % 7 == 0)
+        {
+            text += "with"s;
+        }
+        return text;
+    };
+    const auto path = GetTierPath("postings"s);
+    for (const auto &[hot_postings_bytes, cache_bytes] : {pair{size_t(0), size_t(0)}, pair{size_t(200000), size_t(1) << 16},
+                                                          pair{size_t(1) << 40, size_t(1) << 26}})
+    {
+        const auto budget_hint = to_string(hot_postings_bytes) + " "s + to_string(cache_bytes);
+        filesystem::remove(path);
+        SearchServer in_memory("with"s);
+        in_memory.EnableFuzzySearch();
+        auto tiered = make_unique<SearchServer>("with"s);
+        tiered->EnableFuzzySearch();
+        tiered->EnableColdTier(path, hot_postings_bytes, cache_bytes);
+        // removals and a new text under a removed id come in between, after the earlier postings went cold
+        const auto add_documents = [&](SearchServer &server, int first_id, int end_id)
+        {
+            for (int document_id = first_id; document_id < end_id; ++document_id)
+            {
+                const auto text = make_text(document_id);
+                const auto status = static_cast<DocumentStatus>(generator() % 3);
+                const int rating = static_cast<int>(generator() % 20) - 5;
+                in_memory.AddDocument(document_id, text, status, {rating});
+                server.AddDocument(document_id, text, status, {rating});
+                if (document_id % 13 == 0 && document_id >= 500)
+                {
+                    const int removed_id = document_id - 500;
+                    in_memory.RemoveDocument(removed_id);
+                    server.RemoveDocument(removed_id);
+                    if (removed_id % 3 == 0)
+                    {
+                        const auto new_text = make_text(removed_id) + " w1"s;
+                        in_memory.AddDocument(removed_id, new_text, DocumentStatus::ACTUAL, {7});
+                        server.AddDocument(removed_id, new_text, DocumentStatus::ACTUAL, {7});
+                    }
+                }
+            }
+        };
+        add_documents(*tiered, 0, 6000);
+        AssertSameResults(*tiered, in_memory, budget_hint);
+        // the forward index and texts are read from the file, and so are the postings past the budget
+        const auto tiered_stats = tiered->GetMemoryStats();
+        const auto in_memory_stats = in_memory.GetMemoryStats();
+        ASSERT_EQUAL(tiered_stats.ids_to_word_freq, 0u);
+        ASSERT(tiered_stats.storage < in_memory_stats.storage / 4);
+        if (hot_postings_bytes == 0)
+        {
+            ASSERT(tiered_stats.word_to_document_freqs < in_memory_stats.word_to_document_freqs / 4);
+        }
+
+        // a new server over the same file gets the documents back and takes more
+        tiered.reset();
+        SearchServer reopened("with"s);
+        reopened.EnableColdTier(path, hot_postings_bytes, cache_bytes);
+        reopened.EnableFuzzySearch();
+        ASSERT_EQUAL(reopened.GetDocumentCount(), in_memory.GetDocumentCount());
+        AssertSameResults(reopened, in_memory, budget_hint + " reopened"s);
+        add_documents(reopened, 6000, 8000);
+        AssertSameResults(reopened, in_memory, budget_hint + " reopened and grown"s);
+    }
+    filesystem::remove(path);
+}
+
+void TestColdTierSurvivesTornTail()
+{
+    const auto path = GetTierPath("torn"s);
+    filesystem::remove(path);
+    SearchServer in_memory(""s);
+    {
+        SearchServer tiered(""s);
+        tiered.EnableColdTier(path, 0, 4096);
+        for (int document_id = 0; document_id < 300; ++document_id)
+        {
+            const auto text = "cat"s + to_string(document_id % 17) + " dog"s + to_string(document_id % 5);
+            in_memory.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 4});
+            tiered.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 4});
+        }
+        ASSERT_THROWS(tiered.EnableColdTier(path, 0, 4096), logic_error);
+    }
+    // a write cut short by a crash
+    {
+        ofstream out(path, ios::binary | ios::app);
+        out << "\x40\x00\x00\x00garbage"s;
+    }
+    SearchServer reopened(""s);
+    reopened.EnableColdTier(path, 0, 4096);
+    ASSERT_EQUAL(reopened.GetDocumentCount(), 300);
+    reopened.AddDocument(300, "cat1 dog1"s, DocumentStatus::ACTUAL, {1});
+    in_memory.AddDocument(300, "cat1 dog1"s, DocumentStatus::ACTUAL, {1});
+    for (const auto &query : {"cat1"s, "dog1 -cat1"s, "cat1* dog*"s})
+    {
+        AssertSameDocuments(reopened.FindTopDocuments(query), in_memory.FindTopDocuments(query), query);
+    }
+    ASSERT(get<0>(reopened.MatchDocument("cat1 dog1"s, 300)) == get<0>(in_memory.MatchDocument("cat1 dog1"s, 300)));
+
+    SearchServer not_empty(""s);
+    not_empty.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_THROWS(not_empty.EnableColdTier(path, 0, 4096), logic_error);
+    filesystem::remove(path);
+}
+
+void TestColdTierExcludesOtherIndexes()
+{
+    const auto path = GetTierPath("exclusive"s);
+    filesystem::remove(path);
+    SearchServer positional(""s);
+    positional.EnablePositionalIndex();
+    ASSERT_THROWS(positional.EnableColdTier(path, 0, 4096), logic_error);
+
+    SearchServer impact_ordered(""s);
+    impact_ordered.EnableImpactOrderedPostings();
+    ASSERT_THROWS(impact_ordered.EnableColdTier(path, 0, 4096), logic_error);
+
+    SearchServer tiered(""s);
+    tiered.EnableColdTier(path, 0, 4096);
+    tiered.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_THROWS(tiered.EnablePositionalIndex(), logic_error);
+    ASSERT_THROWS(tiered.EnableImpactOrderedPostings(), logic_error);
+    ASSERT_EQUAL(tiered.FindTopDocuments("cat"s).size(), 1u);
+    filesystem::remove(path);
+}
+
+int main()
+{
+    RUN_TEST(TestBlockCacheResistsScans);
+    RUN_TEST(TestColdTierRanksLikeMemory);
+    RUN_TEST(TestColdTierSurvivesTornTail);
+    RUN_TEST(TestColdTierExcludesOtherIndexes);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../posting_lists.h"
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <algorithm>
+#include <execution>
+#include <random>
+
+using namespace std;
+
+void TestGallopLowerBound()
+{
+    vector<int> ids;
+    for (int id = 0; id < 1000; id += 3)
+    {
+        ids.push_back(id);
+    }
+    for (int id = -1; id < 1002; ++id)
+    {
+        for (size_t first = 0; first < ids.size(); first += 37)
+        {
+            const auto expected = lower_bound(ids.cbegin() + first, ids.cend(), id);
+            ASSERT_HINT(GallopLowerBound(ids.cbegin() + first, ids.cend(), id) == expected, to_string(id));
+        }
+    }
+}
+
+void TestIntersectPostingLists()
+{
+    mt19937 generator(1);
+    for (int round = 0; round < 200; ++round)
+    {
+        // lists of very different density, so the shortest one drives
+        vector<int> dense;
+        vector<int> medium;
+        vector<int> sparse;
+        for (int id = 0; id < 500; ++id)
+        {
+            if (generator() % 2 == 0)
+            {
+                dense.push_back(id);
+            }
+            if (generator() % 5 == 0)
+            {
+                medium.push_back(id);
+            }
+            if (generator() % 50 == 0)
+            {
+                sparse.push_back(id);
+            }
+        }
+        vector<int> expected;
+        for (const int id : sparse)
+        {
+            if (binary_search(dense.begin(), dense.end(), id) && binary_search(medium.begin(), medium.end(), id))
+            {
+                expected.push_back(id);
+            }
+        }
+        ASSERT(IntersectPostingLists({&dense, &medium, &sparse}) == expected);
+        ASSERT(IntersectPostingLists({&sparse, &dense, &medium}) == expected);
+    }
+    const vector<int> empty;
+    const vector<int> some = {1, 2, 3};
+    ASSERT(IntersectPostingLists({&some, &empty}).empty());
+}
+
+void TestRequiredWordsMatchReference()
+{
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    const auto texts = GenerateTexts(3000, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        const auto status = static_cast<DocumentStatus>(document_id % 2);
+        search_server.AddDocument(document_id, texts[document_id], status, {document_id % 10});
+        reference.AddDocument(document_id, texts[document_id], status, {document_id % 10});
+    }
+    // removed documents must drop out of the id lists too
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); document_id += 4)
+    {
+        search_server.RemoveDocument(execution::par, document_id);
+        reference.RemoveDocument(document_id);
+    }
+    const auto is_actual = [](int, DocumentStatus status, int)
+    {
+        return status == DocumentStatus::ACTUAL;
+    };
+    for (const auto &query : {"+curly +cat"s, "+curly cat -dog"s, "+cat +tail +big -eyes"s, "+zzz cat"s, "+cat"s, "+cat +cat hat"s})
+    {
+        const auto expected = reference.FindTopDocuments(query, is_actual);
+        AssertSameRanking(search_server.FindTopDocuments(query), expected, query);
+        AssertSameRanking(search_server.FindTopDocuments(execution::par, query), expected, query);
+        AssertSameRanking(search_server.FindTopDocuments(automatic_execution, query), expected, query);
+
+        // a document lacking a required word has no match at all; odd ids are all still indexed
+        for (int document_id = 1; document_id < static_cast<int>(texts.size()); document_id += 98)
+        {
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            const bool is_found = !reference.FindAllDocuments(query, [document_id](int id, DocumentStatus, int)
+                                                              { return id == document_id; })
+                                       .empty();
+            ASSERT_EQUAL_HINT(!words.empty(), is_found, query + " "s + to_string(document_id));
+        }
+    }
+    for (const auto &invalid_query : {"+"s, "++cat"s, "+-cat"s})
+    {
+        ASSERT_THROWS(search_server.FindTopDocuments(invalid_query), invalid_argument);
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestGallopLowerBound);
+    RUN_TEST(TestIntersectPostingLists);
+    RUN_TEST(TestRequiredWordsMatchReference);
+    return 0;
+}
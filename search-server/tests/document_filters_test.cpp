@@ -0,0 +1,205 @@
+#include "../document_bitmap.h"
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <execution>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s, "zzz"s};
+
+    // Every status and a rating of 0..9, with a few removals so the bitmaps have holes
+    void FillIndex(SearchServer &search_server, ReferenceSearch &reference, mt19937 &generator)
+    {
+        const auto texts = GenerateTexts(3000, VOCABULARY, 6, generator);
+        for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+        {
+            const auto status = static_cast<DocumentStatus>(generator() % 4);
+            const int rating = static_cast<int>(generator() % 10);
+            search_server.AddDocument(document_id, texts[document_id], status, {rating});
+            reference.AddDocument(document_id, texts[document_id], status, {rating});
+        }
+        for (int document_id = 0; document_id < static_cast<int>(texts.size()); document_id += 7)
+        {
+            search_server.RemoveDocument(document_id);
+            reference.RemoveDocument(document_id);
+        }
+    }
+}
+
+void TestDocumentBitmap()
+{
+    DocumentBitmap lhs;
+    DocumentBitmap rhs;
+    for (int document_id = 0; document_id < 1000; document_id += 3)
+    {
+        lhs.Insert(document_id);
+    }
+    for (int document_id = 0; document_id < 1000; document_id += 5)
+    {
+        rhs.Insert(document_id);
+    }
+    lhs.Erase(15);
+    ASSERT(lhs.Contains(3));
+    ASSERT(!lhs.Contains(15));
+    ASSERT(!lhs.Contains(4));
+    const auto both = lhs.Intersect(rhs);
+    for (int document_id = 0; document_id < 1000; ++document_id)
+    {
+        ASSERT_EQUAL_HINT(both.Contains(document_id), document_id % 15 == 0 && document_id != 15, to_string(document_id));
+    }
+}
+
+void TestDocumentBitmapSwitchesChunkLayout()
+{
+    DocumentBitmap bitmap;
+    // past MAX_ARRAY_SIZE the first chunk becomes a bitset, after the erasures an array again
+    for (int document_id = 0; document_id < 10000; ++document_id)
+    {
+        bitmap.Insert(document_id);
+    }
+    bitmap.Insert(70000);
+    ASSERT_EQUAL(bitmap.Size(), 10001u);
+    for (int document_id = 0; document_id < 10000; ++document_id)
+    {
+        if (document_id % 10 != 0)
+        {
+            bitmap.Erase(document_id);
+        }
+    }
+    ASSERT_EQUAL(bitmap.Size(), 1001u);
+    vector<int> visited;
+    bitmap.ForEach([&visited](int document_id)
+                   { visited.push_back(document_id); });
+    ASSERT_EQUAL(visited.size(), 1001u);
+    ASSERT(is_sorted(visited.begin(), visited.end()));
+    ASSERT_EQUAL(visited.back(), 70000);
+    for (int document_id = 0; document_id < 10000; ++document_id)
+    {
+        ASSERT_EQUAL(bitmap.Contains(document_id), document_id % 10 == 0);
+    }
+}
+
+void TestDocumentBitmapRangeWalk()
+{
+    DocumentBitmap bitmap;
+    // a bitset chunk, an array chunk and a chunk far away
+    for (int document_id = 0; document_id < 70000; ++document_id)
+    {
+        if (document_id < 65536 ? document_id % 3 == 0 : document_id % 50 == 0)
+        {
+            bitmap.Insert(document_id);
+        }
+    }
+    bitmap.Insert(1 << 30);
+    const vector<pair<int, int>> ranges = {{0, 1}, {1, 3}, {60, 130}, {63, 64}, {64, 65}, {65000, 66000}, {65535, 65537}, {69950, 70000},
+                                           {5, 5}, {9, 2}, {0, numeric_limits<int>::max()}, {(1 << 30) - 1, (1 << 30) + 1}};
+    for (const auto &[first_id, last_id] : ranges)
+    {
+        vector<int> expected;
+        bitmap.ForEach([&, first_id = first_id, last_id = last_id](int document_id)
+                       {
+            if (document_id >= first_id && document_id < last_id) {
+                expected.push_back(document_id);
+            } });
+        vector<int> visited;
+        bitmap.ForEachInRange(first_id, last_id, [&visited](int document_id)
+                              { visited.push_back(document_id); });
+        ASSERT_HINT(visited == expected, to_string(first_id) + " "s + to_string(last_id));
+    }
+}
+
+void TestParallelSumsLikeSequential()
+{
+    mt19937 generator(3);
+    SearchServer search_server(STOP_WORDS);
+    // sparse ids, so the id ranges of par hold very different numbers of documents
+    const auto texts = GenerateTexts(2000, VOCABULARY, 6, generator);
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        const int document_id = i % 10 == 0 ? static_cast<int>(generator() % 1000000) + 100000 : static_cast<int>(i);
+        if (search_server.GetWordFrequencies(document_id).empty())
+        {
+            search_server.AddDocument(document_id, texts[i], static_cast<DocumentStatus>(i % 2), {static_cast<int>(i % 7)});
+        }
+    }
+    for (const auto &query : QUERIES)
+    {
+        for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT})
+        {
+            const auto sequential = search_server.FindTopDocuments(execution::seq, query, status);
+            const auto parallel = search_server.FindTopDocuments(execution::par, query, status);
+            ASSERT_EQUAL_HINT(parallel.size(), sequential.size(), query);
+            for (size_t i = 0; i < parallel.size(); ++i)
+            {
+                ASSERT_EQUAL_HINT(parallel[i].id, sequential[i].id, query);
+                ASSERT_HINT(parallel[i].relevance == sequential[i].relevance, query);
+            }
+        }
+    }
+}
+
+void TestStatusMatchesPredicate()
+{
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    FillIndex(search_server, reference, generator);
+    for (const auto status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED})
+    {
+        const auto has_status = [status](int, DocumentStatus document_status, int)
+        {
+            return document_status == status;
+        };
+        for (const auto &query : QUERIES)
+        {
+            const auto expected = reference.FindTopDocuments(query, has_status);
+            AssertSameRanking(search_server.FindTopDocuments(query, status), expected, query);
+            AssertSameRanking(search_server.FindTopDocuments(execution::par, query, status), expected, query);
+            AssertSameRanking(search_server.FindTopDocuments(query, has_status), expected, query);
+        }
+    }
+}
+
+void TestRatingRangeMatchesPredicate()
+{
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    FillIndex(search_server, reference, generator);
+    // narrow ranges take the rating bitmap, wide ones the rating check per candidate
+    const vector<pair<int, int>> ranges = {{3, 3}, {0, 1}, {2, 7}, {0, 9}, {-5, 100}, {7, 2}};
+    for (const auto &[min_rating, max_rating] : ranges)
+    {
+        const auto in_range = [min_rating = min_rating, max_rating = max_rating](int, DocumentStatus status, int rating)
+        {
+            return status == DocumentStatus::ACTUAL && rating >= min_rating && rating <= max_rating;
+        };
+        for (const auto &query : QUERIES)
+        {
+            const auto hint = query + " ["s + to_string(min_rating) + ", "s + to_string(max_rating) + "]"s;
+            const auto expected = reference.FindTopDocuments(query, in_range);
+            AssertSameRanking(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, min_rating, max_rating), expected, hint);
+            AssertSameRanking(search_server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, min_rating, max_rating),
+                              expected, hint);
+            AssertSameRanking(search_server.FindTopDocuments(automatic_execution, query, DocumentStatus::ACTUAL, min_rating, max_rating),
+                              expected, hint);
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestDocumentBitmapSwitchesChunkLayout);
+    RUN_TEST(TestDocumentBitmapRangeWalk);
+    RUN_TEST(TestStatusMatchesPredicate);
+    RUN_TEST(TestParallelSumsLikeSequential);
+    RUN_TEST(TestRatingRangeMatchesPredicate);
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include "../durable_search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s};
+
+    string MakeTestDirectory(const string &name)
+    {
+        const auto directory = filesystem::temp_directory_path() / ("durable_search_server_test_"s + name);
+        filesystem::remove_all(directory);
+        return directory.string();
+    }
+
+    vector<string> ListSegmentPaths(const string &directory)
+    {
+        vector<string> paths;
+        for (const auto &entry : filesystem::directory_iterator(directory))
+        {
+            if (entry.path().filename().string().rfind("wal-"s, 0) == 0)
+            {
+                paths.push_back(entry.path().string());
+            }
+        }
+        sort(paths.begin(), paths.end(), [](const string &lhs, const string &rhs)
+             { return lhs.size() != rhs.size() ? lhs.size() < rhs.size() : lhs < rhs; });
+        return paths;
+    }
+
+    void AssertSameIndex(const DurableSearchServer &durable_server, const SearchServer &search_server)
+    {
+        ASSERT_EQUAL(durable_server.GetDocumentCount(), search_server.GetDocumentCount());
+        for (const auto &query : QUERIES)
+        {
+            AssertSameRanking(durable_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+            AssertSameRanking(durable_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                              search_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        }
+    }
+
+    // Applies the same changes to both
+    void AddDocuments(DurableSearchServer &durable_server, SearchServer &search_server, int first_id, size_t count, mt19937 &generator)
+    {
+        const auto texts = GenerateTexts(count, VOCABULARY, 6, generator);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int document_id = first_id + static_cast<int>(i);
+            const auto status = static_cast<DocumentStatus>(document_id % 2);
+            durable_server.AddDocument(document_id, texts[i], status, {document_id % 10, document_id % 7});
+            search_server.AddDocument(document_id, texts[i], status, {document_id % 10, document_id % 7});
+        }
+    }
+}
+
+void TestWriteAheadLogCutsOffTornTail()
+{
+    const auto directory = MakeTestDirectory("torn_tail"s);
+    filesystem::create_directories(directory);
+    const auto path = directory + "/log"s;
+    {
+        WriteAheadLog log(path);
+        log.Append("first"s);
+        log.Append("second"s);
+        log.Flush();
+    }
+    const auto intact_size = filesystem::file_size(path);
+    {
+        // a header promising more bytes than the crash left behind
+        ofstream out(path, ios::app | ios::binary);
+        out << "\x10\x00\x00\x00garbage"s;
+    }
+    vector<string> records;
+    WriteAheadLog::Replay(path, [&records](string_view record)
+                          { records.emplace_back(record); });
+    ASSERT_EQUAL(records.size(), 2u);
+    ASSERT_EQUAL(records.back(), "second"s);
+    ASSERT_EQUAL(filesystem::file_size(path), intact_size);
+
+    // records appended after the cut are read back
+    {
+        WriteAheadLog log(path);
+        log.Append("third"s);
+        log.Flush();
+    }
+    records.clear();
+    WriteAheadLog::Replay(path, [&records](string_view record)
+                          { records.emplace_back(record); });
+    ASSERT_EQUAL(records.size(), 3u);
+    ASSERT_EQUAL(records.back(), "third"s);
+}
+
+void TestWriteAheadLogStopsAtCorruptRecord()
+{
+    const auto directory = MakeTestDirectory("corrupt"s);
+    filesystem::create_directories(directory);
+    const auto path = directory + "/log"s;
+    {
+        WriteAheadLog log(path);
+        log.Append("first"s);
+        log.Append("second"s);
+        log.Flush();
+    }
+    {
+        // flips the last byte of the second record, the checksum no longer matches
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(-1, ios::end);
+        file.put('X');
+    }
+    vector<string> records;
+    WriteAheadLog::Replay(path, [&records](string_view record)
+                          { records.emplace_back(record); });
+    ASSERT_EQUAL(records.size(), 1u);
+    ASSERT_EQUAL(records.front(), "first"s);
+}
+
+void TestRecoveryReplaysTheLog()
+{
+    const auto directory = MakeTestDirectory("replay"s);
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS);
+        AddDocuments(durable_server, search_server, 0, 500, generator);
+        for (int document_id = 0; document_id < 500; document_id += 5)
+        {
+            durable_server.RemoveDocument(document_id);
+            search_server.RemoveDocument(document_id);
+        }
+        // an unknown id is not logged
+        durable_server.RemoveDocument(100000);
+        AssertSameIndex(durable_server, search_server);
+    }
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    AssertSameIndex(durable_server, search_server);
+}
+
+void TestRecoveryAfterTornTail()
+{
+    const auto directory = MakeTestDirectory("torn_segment"s);
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS);
+        AddDocuments(durable_server, search_server, 0, 200, generator);
+    }
+    {
+        ofstream out(ListSegmentPaths(directory).back(), ios::app | ios::binary);
+        out << "\x40\x00\x00\x00\x01\x02\x03"s;
+    }
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS);
+        AssertSameIndex(durable_server, search_server);
+        AddDocuments(durable_server, search_server, 200, 50, generator);
+    }
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    AssertSameIndex(durable_server, search_server);
+}
+
+void TestSnapshotAndReplay()
+{
+    const auto directory = MakeTestDirectory("snapshot"s);
+    mt19937 generator(3);
+    SearchServer search_server(STOP_WORDS);
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS);
+        AddDocuments(durable_server, search_server, 0, 300, generator);
+        durable_server.Compact();
+        ASSERT(filesystem::exists(directory + "/snapshot"s));
+        ASSERT_EQUAL(ListSegmentPaths(directory).size(), 1u);
+
+        // after the snapshot: replayed from the new segment on top of it
+        AddDocuments(durable_server, search_server, 300, 100, generator);
+        for (int document_id = 0; document_id < 400; document_id += 3)
+        {
+            durable_server.RemoveDocument(document_id);
+            search_server.RemoveDocument(document_id);
+        }
+    }
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    AssertSameIndex(durable_server, search_server);
+}
+
+void TestBackgroundCompaction()
+{
+    const auto directory = MakeTestDirectory("background"s);
+    mt19937 generator(4);
+    SearchServer search_server(STOP_WORDS);
+    {
+        // a small threshold makes the background thread compact several times
+        DurableSearchServer durable_server(directory, STOP_WORDS, 4096);
+        AddDocuments(durable_server, search_server, 0, 2000, generator);
+    }
+    ASSERT(filesystem::exists(directory + "/snapshot"s));
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    AssertSameIndex(durable_server, search_server);
+}
+
+void TestConcurrentWriters()
+{
+    const auto directory = MakeTestDirectory("concurrent"s);
+    mt19937 generator(5);
+    const auto texts = GenerateTexts(4000, VOCABULARY, 6, generator);
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS, 20000);
+        vector<thread> writers;
+        for (int writer = 0; writer < 8; ++writer)
+        {
+            writers.emplace_back([&durable_server, &texts, writer]
+                                 {
+                for (int document_id = writer; document_id < static_cast<int>(texts.size()); document_id += 8) {
+                    durable_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 10});
+                } });
+        }
+        for (auto &writer : writers)
+        {
+            writer.join();
+        }
+    }
+    SearchServer search_server(STOP_WORDS);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 10});
+    }
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    AssertSameIndex(durable_server, search_server);
+}
+
+void TestFailedLogRejectsChanges()
+{
+    const auto directory = MakeTestDirectory("failed"s);
+    // a write past the file size limit fails with EFBIG instead of killing the process
+    signal(SIGXFSZ, SIG_IGN);
+    rlimit limit{};
+    getrlimit(RLIMIT_FSIZE, &limit);
+    {
+        DurableSearchServer durable_server(directory, STOP_WORDS, 1 << 30);
+        durable_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+
+        rlimit small_limit = limit;
+        small_limit.rlim_cur = 64;
+        setrlimit(RLIMIT_FSIZE, &small_limit);
+        // visible before durable: the failed change stays in memory
+        ASSERT_THROWS(durable_server.AddDocument(2, "black dog with a long text that does not fit"s, DocumentStatus::ACTUAL, {1}),
+                      system_error);
+        ASSERT_EQUAL(durable_server.GetDocumentCount(), 2);
+        // later changes are refused untouched
+        ASSERT_THROWS(durable_server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, {1}), runtime_error);
+        ASSERT_THROWS(durable_server.RemoveDocument(1), runtime_error);
+        ASSERT_EQUAL(durable_server.GetDocumentCount(), 2);
+        ASSERT(!durable_server.FindTopDocuments("dog"s).empty());
+
+        setrlimit(RLIMIT_FSIZE, &limit);
+        // the snapshot persists what queries see and a fresh segment takes changes again
+        durable_server.Compact();
+        durable_server.AddDocument(3, "dog"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(durable_server.GetDocumentCount(), 3);
+    }
+    setrlimit(RLIMIT_FSIZE, &limit);
+    DurableSearchServer durable_server(directory, STOP_WORDS);
+    ASSERT_EQUAL(durable_server.GetDocumentCount(), 3);
+    ASSERT_EQUAL(durable_server.FindTopDocuments("dog"s).size(), 2u);
+}
+
+int main()
+{
+    RUN_TEST(TestWriteAheadLogCutsOffTornTail);
+    RUN_TEST(TestWriteAheadLogStopsAtCorruptRecord);
+    RUN_TEST(TestRecoveryReplaysTheLog);
+    RUN_TEST(TestRecoveryAfterTornTail);
+    RUN_TEST(TestSnapshotAndReplay);
+    RUN_TEST(TestBackgroundCompaction);
+    RUN_TEST(TestConcurrentWriters);
+    RUN_TEST(TestFailedLogRejectsChanges);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "../execution_cost_model.h"
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+// The threshold is pinned once per process, so every test below sees 100 postings
+void TestPinnedThreshold()
+{
+    ExecutionCostModel::Calibrate(100);
+    ExecutionCostModel::Calibrate(100);
+    ASSERT_THROWS(ExecutionCostModel::Calibrate(5), logic_error);
+    const auto &model = ExecutionCostModel::Instance();
+    ASSERT_EQUAL(model.GetParallelThreshold(), 100u);
+    ASSERT(!model.PreferParallel(99));
+    ASSERT(model.PreferParallel(100));
+}
+
+void TestParallelismGrowsWithPostings()
+{
+    const auto &model = ExecutionCostModel::Instance();
+    const size_t thread_count = max(2u, thread::hardware_concurrency());
+    ASSERT_EQUAL(model.ChooseParallelism(0), 1u);
+    ASSERT_EQUAL(model.ChooseParallelism(99), 1u);
+    ASSERT_EQUAL(model.ChooseParallelism(100), 2u);
+    size_t previous = 1;
+    for (size_t postings = 100; postings < 100000; postings += 37)
+    {
+        const size_t parallelism = model.ChooseParallelism(postings);
+        ASSERT(parallelism >= previous);
+        ASSERT(parallelism <= thread_count);
+        previous = parallelism;
+    }
+    ASSERT_EQUAL(model.ChooseParallelism(100 * thread_count), thread_count);
+}
+
+void TestAutomaticCallsMatchSequential()
+{
+    mt19937 generator(4);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    const auto texts = GenerateTexts(1000, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+        reference.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    // with a low threshold most removals and queries go parallel, with the number of ranges varying by query
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); document_id += 3)
+    {
+        search_server.RemoveDocument(automatic_execution, document_id);
+        reference.RemoveDocument(document_id);
+    }
+    for (const auto &query : {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s, "zzz"s, "cat dog hat tail curly nasty big eyes"s})
+    {
+        const auto expected = reference.FindTopDocuments(query, [](int, DocumentStatus, int)
+                                                         { return true; });
+        AssertSameRanking(search_server.FindTopDocuments(automatic_execution, query), expected, query);
+        AssertSameRanking(search_server.FindTopDocuments(automatic_execution, search_server.PrepareQuery(query), DocumentStatus::ACTUAL),
+                          expected, query);
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestPinnedThreshold);
+    RUN_TEST(TestParallelismGrowsWithPostings);
+    RUN_TEST(TestAutomaticCallsMatchSequential);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "../deletion_index.h"
+#include "../search_server.h"
+#include "test_framework.h"
+#include <set>
+
+using namespace std;
+
+namespace
+{
+    set<int> FindIds(const SearchServer &search_server, const string &query)
+    {
+        set<int> ids;
+        for (const auto &document : search_server.FindTopDocuments(query))
+        {
+            ids.insert(document.id);
+        }
+        return ids;
+    }
+
+    set<string> FindTerms(const DeletionIndex &index, const string &word)
+    {
+        set<string> terms;
+        for (const auto &[term, _] : index.FindCandidates(word))
+        {
+            terms.insert(string(term));
+        }
+        return terms;
+    }
+}
+
+void TestEditDistance()
+{
+    // substitution, insertion, deletion and an adjacent transposition each cost 1
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cut"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cart"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("cart"s, "cat"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "act"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("curly"s, "cruly"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("curly"s, "curly"s, 2), 0);
+    // past the cap the distance is max_distance + 1, whether the lengths or the letters differ
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "dog"s, 2), 3);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "catalog"s, 2), 3);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cut"s, 0), 1);
+    // a letter of two bytes is still one edit
+    ASSERT_EQUAL(ComputeEditDistance("ёж"s, "еж"s, 1), 1);
+    ASSERT_EQUAL(ComputeEditDistance("кот"s, "кто"s, 1), 1);
+    ASSERT_EQUAL(ComputeEditDistance("кошка"s, "кошк"s, 1), 1);
+    ASSERT_EQUAL(ComputeEditDistance("кошка"s, "мошки"s, 1), 2);
+}
+
+void TestDeletionIndexCandidates()
+{
+    const vector<string> terms = {"cat"s, "cut"s, "act"s, "cart"s, "dog"s, "кошка"s, "кошки"s, "ёжик"s};
+    DeletionIndex index(1);
+    for (const auto &term : terms)
+    {
+        index.AddTerm(term);
+    }
+    ASSERT(FindTerms(index, "cat"s) == (set<string>{"act"s, "cart"s, "cat"s, "cut"s}));
+    ASSERT(FindTerms(index, "dgo"s) == set<string>{"dog"s});
+    ASSERT(FindTerms(index, "dig"s) == set<string>{"dog"s});
+    ASSERT(FindTerms(index, "cow"s).empty());
+    // deletions drop whole letters, so a changed letter of two bytes is found within distance 1
+    ASSERT(FindTerms(index, "кошку"s) == (set<string>{"кошка"s, "кошки"s}));
+    ASSERT(FindTerms(index, "ежик"s) == set<string>{"ёжик"s});
+    const auto nearest = index.FindCandidates("cat"s);
+    ASSERT_EQUAL(nearest.front().first, "cat"s);
+    ASSERT_EQUAL(nearest.front().second, 0);
+
+    // a removed term is gone, and its deletions with it
+    const size_t memory = index.GetMemoryUsage();
+    index.RemoveTerm("dog"s);
+    ASSERT(FindTerms(index, "dgo"s).empty());
+    ASSERT(index.GetMemoryUsage() < memory);
+    index.RemoveTerm("cat"s);
+    ASSERT(FindTerms(index, "cat"s) == (set<string>{"act"s, "cart"s, "cut"s}));
+}
+
+void TestQueryCorrection()
+{
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(3, "big dog with hat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(4, "рыжий кот"s, DocumentStatus::ACTUAL, {1});
+    search_server.EnableFuzzySearch(1);
+
+    ASSERT(FindIds(search_server, "dig"s) == (set<int>{2, 3}));
+    ASSERT(FindIds(search_server, "dgo"s) == (set<int>{2, 3}));
+    ASSERT(FindIds(search_server, "curlyy"s) == set<int>{1});
+    ASSERT(FindIds(search_server, "кто"s) == set<int>{4});
+    // two edits away is beyond the distance the index was built for
+    ASSERT(FindIds(search_server, "dxx"s).empty());
+    // minus-words are taken as written
+    ASSERT(FindIds(search_server, "кит -рыжй"s) == set<int>{4});
+    ASSERT(FindIds(search_server, "кит -рыжий"s).empty());
+}
+
+void TestRemovedTermIsNotOffered()
+{
+    SearchServer search_server(""s);
+    search_server.EnableFuzzySearch(1);
+    search_server.AddDocument(1, "zebra hat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat hat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(FindIds(search_server, "zebr"s) == set<int>{1});
+    const size_t memory = search_server.GetMemoryStats(0).fuzzy_index;
+
+    search_server.RemoveDocument(1);
+    // "zebra" has no documents left, "hat" still has one
+    ASSERT(FindIds(search_server, "zebr"s).empty());
+    ASSERT(FindIds(search_server, "hta"s) == set<int>{2});
+    ASSERT(search_server.GetMemoryStats(0).fuzzy_index < memory);
+
+    // a term that comes back is offered again
+    search_server.AddDocument(3, "zebra"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(FindIds(search_server, "zebr"s) == set<int>{3});
+
+    // enabling the search later skips the terms left without documents
+    SearchServer late(""s);
+    late.AddDocument(1, "zebra"s, DocumentStatus::ACTUAL, {1});
+    late.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {1});
+    late.RemoveDocument(execution::par, 1);
+    late.EnableFuzzySearch(1);
+    ASSERT(FindIds(late, "zebr"s).empty());
+    ASSERT(FindIds(late, "cta"s) == set<int>{2});
+}
+
+int main()
+{
+    RUN_TEST(TestEditDistance);
+    RUN_TEST(TestDeletionIndexCandidates);
+    RUN_TEST(TestQueryCorrection);
+    RUN_TEST(TestRemovedTermIsNotOffered);
+    return 0;
+}
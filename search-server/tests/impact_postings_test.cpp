@@ -0,0 +1,86 @@
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <execution>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"cat"s, "curly cat -dog"s, "+cat tail"s, "+cat +tail -eyes big"s, "c*t"s, "zzz"s, "+zzz cat"s,
+                                    "nasty -n*y"s, "hat eyes big"s};
+}
+
+void TestImpactOrderNeedsToBeEnabled()
+{
+    SearchServer search_server(STOP_WORDS);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_THROWS(search_server.FindTopDocumentsByImpact("cat"s), logic_error);
+}
+
+void TestImpactOrderRanksLikeFullEvaluation()
+{
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    auto texts = GenerateTexts(4000, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        const auto status = static_cast<DocumentStatus>(generator() % 4);
+        const int rating = static_cast<int>(generator() % 10);
+        search_server.AddDocument(document_id, texts[document_id], status, {rating});
+        reference.AddDocument(document_id, texts[document_id], status, {rating});
+    }
+    search_server.EnableImpactOrderedPostings();
+
+    const auto is_actual = [](int, DocumentStatus status, int)
+    {
+        return status == DocumentStatus::ACTUAL;
+    };
+    const auto is_selected = [](int document_id, DocumentStatus, int rating)
+    {
+        return rating >= 5 && document_id % 3 != 0;
+    };
+    // the impact lists are kept up to date by later additions and removals
+    for (int round = 0; round < 3; ++round)
+    {
+        for (const auto &query : QUERIES)
+        {
+            AssertSameRanking(search_server.FindTopDocumentsByImpact(query), search_server.FindTopDocuments(query), query);
+            AssertSameRanking(search_server.FindTopDocumentsByImpact(query), reference.FindTopDocuments(query, is_actual), query);
+            AssertSameRanking(search_server.FindTopDocumentsByImpact(query, is_selected), search_server.FindTopDocuments(query, is_selected), query);
+            AssertSameRanking(search_server.FindTopDocumentsByImpact(query, DocumentStatus::BANNED),
+                              search_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        }
+        for (int i = 0; i < 300; ++i)
+        {
+            const int document_id = static_cast<int>(generator() % texts.size());
+            if (i % 2 == 0)
+            {
+                search_server.RemoveDocument(document_id);
+            }
+            else
+            {
+                search_server.RemoveDocument(execution::par, document_id);
+            }
+            reference.RemoveDocument(document_id);
+        }
+        for (int i = 0; i < 100; ++i)
+        {
+            const int document_id = 10000 + round * 1000 + i;
+            const auto text = "cat tail "s + VOCABULARY[generator() % 8];
+            const int rating = static_cast<int>(generator() % 10);
+            search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {rating});
+            reference.AddDocument(document_id, text, DocumentStatus::ACTUAL, {rating});
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestImpactOrderNeedsToBeEnabled);
+    RUN_TEST(TestImpactOrderRanksLikeFullEvaluation);
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "../latency_histogram.h"
+#include "test_framework.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+void TestSmallLatenciesAreExact()
+{
+    LatencyHistogram histogram;
+    ASSERT_EQUAL(histogram.GetPercentile(0.5), 0.0);
+    for (int latency = 1; latency <= 100; ++latency)
+    {
+        histogram.Record(chrono::nanoseconds(latency));
+    }
+    histogram.Record(chrono::nanoseconds(-5));
+    ASSERT_EQUAL(histogram.GetTotal(), 101u);
+    // the negative latency is counted as zero, so the median is the 51st value: 50 ns
+    ASSERT(abs(histogram.GetPercentile(0.5) - 0.050) < 1e-12);
+    ASSERT(abs(histogram.GetPercentile(0.0) - 0.0) < 1e-12);
+    ASSERT(abs(histogram.GetPercentile(0.99) - 0.099) < 1e-12);
+    ASSERT(abs(histogram.GetPercentile(1.0) - 0.100) < 1e-12);
+}
+
+void TestPercentilesStayWithinBucketError()
+{
+    mt19937_64 generator(1);
+    // latencies from 100 ns to about 10 s, spread evenly over the orders of magnitude
+    vector<int64_t> latencies(100000);
+    for (auto &latency : latencies)
+    {
+        latency = static_cast<int64_t>(pow(10.0, 2.0 + 8.0 * generate_canonical<double, 64>(generator)));
+    }
+    LatencyHistogram histogram;
+    for (const auto latency : latencies)
+    {
+        histogram.Record(chrono::nanoseconds(latency));
+    }
+    sort(latencies.begin(), latencies.end());
+    for (const double fraction : {0.001, 0.1, 0.5, 0.9, 0.99, 0.999, 0.9999})
+    {
+        const auto exact = latencies[static_cast<size_t>(ceil(fraction * latencies.size())) - 1] / 1000.0;
+        const auto estimate = histogram.GetPercentile(fraction);
+        // the upper edge of the bucket: never below the exact value, at most one sub-bucket above it
+        ASSERT_HINT(estimate >= exact, to_string(fraction));
+        ASSERT_HINT(estimate <= exact * (1.0 + 1.0 / 64), to_string(fraction));
+    }
+    ASSERT_EQUAL(histogram.GetPercentile(1.0), latencies.back() / 1000.0);
+}
+
+void TestMergeEqualsOneHistogram()
+{
+    mt19937_64 generator(2);
+    LatencyHistogram all;
+    LatencyHistogram first;
+    LatencyHistogram second;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const chrono::nanoseconds latency(generator() % 50'000'000);
+        all.Record(latency);
+        (i % 3 == 0 ? first : second).Record(latency);
+    }
+    first.Merge(second);
+    ASSERT_EQUAL(first.GetTotal(), all.GetTotal());
+    for (const double fraction : {0.1, 0.5, 0.99, 1.0})
+    {
+        ASSERT_EQUAL(first.GetPercentile(fraction), all.GetPercentile(fraction));
+    }
+}
+
+void TestRecordedScheduleRepeats()
+{
+    const vector<chrono::nanoseconds> offsets = {chrono::milliseconds(0), chrono::milliseconds(10), chrono::milliseconds(40)};
+    const auto schedule = BuildReplaySchedule(offsets, 0.0, 3);
+    ASSERT_EQUAL(schedule.size(), 9u);
+    // a pass spans the last offset plus one mean gap of 20 ms
+    const vector<chrono::nanoseconds> expected = {chrono::milliseconds(0), chrono::milliseconds(10), chrono::milliseconds(40),
+                                                  chrono::milliseconds(60), chrono::milliseconds(70), chrono::milliseconds(100),
+                                                  chrono::milliseconds(120), chrono::milliseconds(130), chrono::milliseconds(160)};
+    ASSERT(schedule == expected);
+    ASSERT(BuildReplaySchedule({}, 0.0, 3).empty());
+}
+
+void TestPoissonScheduleKeepsTheRate()
+{
+    const vector<chrono::nanoseconds> offsets(10000);
+    const double rate = 2000.0;
+    const auto schedule = BuildReplaySchedule(offsets, rate, 2);
+    ASSERT_EQUAL(schedule.size(), 20000u);
+    ASSERT(schedule.front() == chrono::nanoseconds(0));
+    ASSERT(is_sorted(schedule.begin(), schedule.end()));
+    // 20000 exponential gaps: the mean is within a few percent of 1 / rate
+    const double mean_gap = chrono::duration<double>(schedule.back()).count() / (schedule.size() - 1);
+    ASSERT_HINT(abs(mean_gap * rate - 1.0) < 0.05, to_string(mean_gap));
+    ASSERT(BuildReplaySchedule(offsets, rate, 2) == schedule);
+    ASSERT(BuildReplaySchedule(offsets, rate, 2, 7) != schedule);
+}
+
+int main()
+{
+    RUN_TEST(TestSmallLatenciesAreExact);
+    RUN_TEST(TestPercentilesStayWithinBucketError);
+    RUN_TEST(TestMergeEqualsOneHistogram);
+    RUN_TEST(TestRecordedScheduleRepeats);
+    RUN_TEST(TestPoissonScheduleKeepsTheRate);
+    return 0;
+}
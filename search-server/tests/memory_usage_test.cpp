@@ -0,0 +1,184 @@
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s};
+
+    void FillIndex(SearchServer &search_server, int first_id, int count, mt19937 &generator)
+    {
+        const auto texts = GenerateTexts(count, VOCABULARY, 8, generator);
+        for (int i = 0; i < count; ++i)
+        {
+            search_server.AddDocument(first_id + i, texts[i], static_cast<DocumentStatus>(i % 3), {i % 10});
+        }
+    }
+
+    // Every figure the index reports, without the largest terms
+    vector<size_t> GetFigures(const MemoryStats &stats)
+    {
+        return {stats.word_to_document_freqs, stats.ids_to_word_freq, stats.documents, stats.document_ids, stats.storage,
+                stats.word_to_document_ids, stats.status_to_documents, stats.rating_to_documents, stats.impact_postings,
+                stats.fuzzy_index, stats.term_dictionary, stats.positional_index, stats.standing_queries, stats.cold_tier, stats.stop_words};
+    }
+}
+
+void TestBudgetRejectsWithoutChanges()
+{
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    search_server.EnableFuzzySearch();
+    FillIndex(search_server, 0, 200, generator);
+    const size_t budget = search_server.GetMemoryStats(0).GetTotal() + 100000;
+    search_server.SetMemoryBudget(budget);
+
+    // long documents of words new to the dictionary, so every one costs a few kilobytes
+    int document_id = 1000;
+    while (true)
+    {
+        string text;
+        for (int i = 0; i < 20; ++i)
+        {
+            text += "w"s + to_string(document_id) + "x"s + to_string(i) + " "s;
+        }
+        const auto stats = search_server.GetMemoryStats(0);
+        const int document_count = search_server.GetDocumentCount();
+        vector<vector<Document>> results;
+        for (const auto &query : QUERIES)
+        {
+            results.push_back(search_server.FindTopDocuments(query));
+        }
+        try
+        {
+            search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {1});
+        }
+        catch (const MemoryBudgetExceeded &)
+        {
+            // nothing of the rejected document is left behind
+            ASSERT_EQUAL(search_server.GetDocumentCount(), document_count);
+            ASSERT(GetFigures(search_server.GetMemoryStats(0)) == GetFigures(stats));
+            for (size_t i = 0; i < QUERIES.size(); ++i)
+            {
+                const auto found = search_server.FindTopDocuments(QUERIES[i]);
+                ASSERT_EQUAL_HINT(found.size(), results[i].size(), QUERIES[i]);
+                for (size_t j = 0; j < found.size(); ++j)
+                {
+                    ASSERT_EQUAL_HINT(found[j].id, results[i][j].id, QUERIES[i]);
+                }
+            }
+            for (const auto &document : search_server.FindTopDocuments("w"s + to_string(document_id) + "x0"s))
+            {
+                ASSERT(document.id != document_id);
+            }
+            break;
+        }
+        ++document_id;
+        ASSERT(document_id < 10000);
+    }
+    // the running estimate never counts less than the index really holds
+    ASSERT(search_server.GetMemoryStats(0).GetTotal() <= budget);
+
+    // removing documents makes room again
+    for (int removed_id = 1000; removed_id < 1010; ++removed_id)
+    {
+        search_server.RemoveDocument(removed_id);
+    }
+    search_server.AddDocument(document_id, "cat dog"s, DocumentStatus::ACTUAL, {1});
+}
+
+void TestStatsAfterAddAndRemove()
+{
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    search_server.EnablePositionalIndex();
+    FillIndex(search_server, 0, 500, generator);
+    const auto before = search_server.GetMemoryStats(0);
+    ASSERT_EQUAL(before.GetTotal(), search_server.GetMemoryStats(5).GetTotal());
+
+    // the vocabulary is already in the dictionary, so everything but the texts goes away again
+    FillIndex(search_server, 500, 300, generator);
+    const auto grown = search_server.GetMemoryStats(0);
+    ASSERT(grown.documents > before.documents);
+    ASSERT(grown.ids_to_word_freq > before.ids_to_word_freq);
+    ASSERT(grown.positional_index > before.positional_index);
+    for (int document_id = 500; document_id < 800; ++document_id)
+    {
+        search_server.RemoveDocument(document_id);
+    }
+    const auto after = search_server.GetMemoryStats(0);
+    ASSERT_EQUAL(after.word_to_document_freqs, before.word_to_document_freqs);
+    ASSERT_EQUAL(after.ids_to_word_freq, before.ids_to_word_freq);
+    ASSERT_EQUAL(after.documents, before.documents);
+    ASSERT_EQUAL(after.document_ids, before.document_ids);
+    ASSERT_EQUAL(after.rating_to_documents, before.rating_to_documents);
+    ASSERT_EQUAL(after.stop_words, before.stop_words);
+    // the removed texts stay in storage, and buffers keep their capacity
+    ASSERT(after.storage > before.storage);
+    ASSERT(after.positional_index <= grown.positional_index);
+    ASSERT(after.GetTotal() < grown.GetTotal());
+
+    size_t term_bytes = 0;
+    const auto with_terms = search_server.GetMemoryStats(3);
+    ASSERT_EQUAL(with_terms.largest_terms.size(), 3u);
+    for (const auto &term : with_terms.largest_terms)
+    {
+        term_bytes += term.bytes;
+    }
+    ASSERT(term_bytes <= with_terms.word_to_document_freqs + with_terms.word_to_document_ids);
+}
+
+void TestPositionalIndexIsCounted()
+{
+    mt19937 generator(3);
+    SearchServer plain(STOP_WORDS);
+    SearchServer positional(STOP_WORDS);
+    const auto texts = GenerateTexts(300, VOCABULARY, 8, generator);
+    for (int document_id = 0; document_id < 300; ++document_id)
+    {
+        plain.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {1});
+        positional.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL(positional.GetMemoryStats(0).positional_index, 0u);
+    const size_t total_before = positional.GetMemoryStats(0).GetTotal();
+    positional.EnablePositionalIndex();
+    const auto stats = positional.GetMemoryStats(0);
+    ASSERT(stats.positional_index > 0);
+    ASSERT_EQUAL(stats.GetTotal(), total_before + stats.positional_index);
+
+    // the same budget admits fewer documents when each of them also brings its positions
+    const size_t positional_budget = positional.GetMemoryStats(0).GetTotal() + 50000;
+    plain.SetMemoryBudget(plain.GetMemoryStats(0).GetTotal() + 50000);
+    positional.SetMemoryBudget(positional_budget);
+    const auto count_admitted = [&texts](SearchServer &search_server)
+    {
+        int admitted = 0;
+        try
+        {
+            for (int document_id = 1000;; ++document_id)
+            {
+                search_server.AddDocument(document_id, texts[document_id % texts.size()], DocumentStatus::ACTUAL, {1});
+                ++admitted;
+            }
+        }
+        catch (const MemoryBudgetExceeded &)
+        {
+        }
+        return admitted;
+    };
+    const int plain_admitted = count_admitted(plain);
+    const int positional_admitted = count_admitted(positional);
+    ASSERT_HINT(positional_admitted < plain_admitted, to_string(positional_admitted) + " "s + to_string(plain_admitted));
+    ASSERT(positional.GetMemoryStats(0).GetTotal() <= positional_budget);
+}
+
+int main()
+{
+    RUN_TEST(TestBudgetRejectsWithoutChanges);
+    RUN_TEST(TestStatsAfterAddAndRemove);
+    RUN_TEST(TestPositionalIndexIsCounted);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "../paginator.h"
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <list>
+#include <random>
+#include <set>
+
+using namespace std;
+
+namespace
+{
+    const auto ANY_DOCUMENT = [](int, DocumentStatus, int)
+    {
+        return true;
+    };
+
+    // Every page of the query one after another, each checked to hold page_size documents but the last
+    template <typename ExecutionPolicy>
+    vector<Document> WalkPages(const SearchServer &search_server, ExecutionPolicy &policy, const string &query, size_t page_size,
+                               size_t &page_count)
+    {
+        vector<Document> documents;
+        optional<SearchCursor> cursor;
+        page_count = 0;
+        do
+        {
+            const auto page = search_server.FindDocumentsPage(policy, query, ANY_DOCUMENT, cursor, page_size);
+            ++page_count;
+            const auto hint = query + " "s + to_string(page_size) + " "s + to_string(page_count);
+            ASSERT_HINT(page.documents.size() <= page_size, hint);
+            ASSERT_HINT(!page.next_cursor || page.documents.size() == page_size, hint);
+            documents.insert(documents.end(), page.documents.begin(), page.documents.end());
+            cursor = page.next_cursor;
+        } while (cursor);
+        return documents;
+    }
+
+    void AssertWholeRanking(const vector<Document> &walked, const vector<Document> &expected, const string &hint)
+    {
+        AssertSameRanking(walked, expected, hint);
+        set<int> walked_ids;
+        for (size_t i = 0; i < walked.size(); ++i)
+        {
+            ASSERT_HINT(walked_ids.insert(walked[i].id).second, hint);
+            // ties come by id, so a cursor in the middle of them splits them in one place
+            if (i > 0 && abs(walked[i - 1].relevance - walked[i].relevance) < DIFF && walked[i - 1].rating == walked[i].rating)
+            {
+                ASSERT_HINT(walked[i - 1].id < walked[i].id, hint);
+            }
+        }
+        set<int> expected_ids;
+        for (const auto &document : expected)
+        {
+            expected_ids.insert(document.id);
+        }
+        ASSERT_HINT(walked_ids == expected_ids, hint);
+    }
+}
+
+void TestPagesMakeTheWholeRanking()
+{
+    mt19937 generator(11);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    const auto texts = GenerateTexts(700, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 4});
+        reference.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 4});
+    }
+    for (const auto &query : {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s, "ca*"s})
+    {
+        const auto expected = reference.FindAllDocuments(query, ANY_DOCUMENT);
+        ASSERT_HINT(expected.size() > 20, query);
+        for (const size_t page_size : {size_t{1}, size_t{3}, size_t{7}, size_t{20}, expected.size(), expected.size() + 1})
+        {
+            const auto hint = query + " "s + to_string(page_size);
+            size_t page_count = 0;
+            auto seq = execution::seq;
+            AssertWholeRanking(WalkPages(search_server, seq, query, page_size, page_count), expected, hint);
+            ASSERT_EQUAL_HINT(page_count, (expected.size() + page_size - 1) / page_size, hint);
+            auto par = execution::par;
+            AssertWholeRanking(WalkPages(search_server, par, query, page_size, page_count), expected, hint);
+        }
+        // the first page is the start of FindTopDocuments
+        const auto first_page = search_server.FindDocumentsPage(query, nullopt, MAX_RESULT_DOCUMENT_COUNT);
+        const auto top = search_server.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(first_page.documents.size(), top.size(), query);
+        for (size_t i = 0; i < top.size(); ++i)
+        {
+            ASSERT_EQUAL_HINT(first_page.documents[i].id, top[i].id, query);
+        }
+    }
+}
+
+void TestPageSizeDividingTheTotal()
+{
+    // 24 equal documents: every page size that divides 24 ends on a full page and no empty one follows
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < 24; ++document_id)
+    {
+        search_server.AddDocument(document_id, "cat"s, DocumentStatus::ACTUAL, {1});
+    }
+    search_server.AddDocument(100, "dog"s, DocumentStatus::ACTUAL, {1});
+    for (const size_t page_size : {1, 2, 3, 4, 6, 8, 12, 24})
+    {
+        const auto hint = to_string(page_size);
+        optional<SearchCursor> cursor;
+        for (size_t page_number = 1; page_number <= 24 / page_size; ++page_number)
+        {
+            const auto page = search_server.FindDocumentsPage("cat"s, cursor, page_size);
+            ASSERT_EQUAL_HINT(page.documents.size(), page_size, hint);
+            ASSERT_EQUAL_HINT(page.next_cursor.has_value(), page_number < 24 / page_size, hint);
+            cursor = page.next_cursor;
+        }
+    }
+}
+
+void TestTiesAtPageBoundaries()
+{
+    // groups of equal text and rating, ordered inside by id; the page sizes cut through the groups
+    SearchServer search_server(""s);
+    ReferenceSearch reference(""s);
+    for (int document_id = 0; document_id < 30; ++document_id)
+    {
+        const auto text = document_id % 3 == 0 ? "cat dog"s : "cat hat"s;
+        const int rating = document_id % 2;
+        search_server.AddDocument(document_id * 7 % 30, text, DocumentStatus::ACTUAL, {rating});
+        reference.AddDocument(document_id * 7 % 30, text, DocumentStatus::ACTUAL, {rating});
+    }
+    for (const size_t page_size : {1, 4, 5, 9})
+    {
+        const auto hint = to_string(page_size);
+        size_t page_count = 0;
+        auto seq = execution::seq;
+        AssertWholeRanking(WalkPages(search_server, seq, "cat dog"s, page_size, page_count), reference.FindAllDocuments("cat dog"s, ANY_DOCUMENT), hint);
+        AssertWholeRanking(WalkPages(search_server, seq, "cat"s, page_size, page_count), reference.FindAllDocuments("cat"s, ANY_DOCUMENT), hint);
+    }
+
+    // a cursor on a tie skips exactly the tied documents with smaller ids
+    SearchServer tied(""s);
+    for (int document_id = 5; document_id >= 0; --document_id)
+    {
+        tied.AddDocument(document_id, "cat"s, DocumentStatus::ACTUAL, {1});
+    }
+    tied.AddDocument(6, "dog"s, DocumentStatus::ACTUAL, {1});
+    const auto first = tied.FindDocumentsPage("cat"s, nullopt, 2);
+    ASSERT_EQUAL(first.documents[0].id, 0);
+    ASSERT_EQUAL(first.documents[1].id, 1);
+    const auto second = tied.FindDocumentsPage("cat"s, first.next_cursor, 2);
+    ASSERT_EQUAL(second.documents[0].id, 2);
+    ASSERT_EQUAL(second.documents[1].id, 3);
+
+    ASSERT_THROWS(search_server.FindDocumentsPage("cat"s, nullopt, 0), invalid_argument);
+    // a cursor past the last document gives an empty last page
+    const auto past_end = tied.FindDocumentsPage("cat"s, SearchCursor{0.0, -1, 1000}, 4);
+    ASSERT(past_end.documents.empty());
+    ASSERT(!past_end.next_cursor);
+}
+
+void TestPaginator()
+{
+    const vector<int> numbers = {1, 2, 3, 4, 5, 6, 7};
+    const list<int> linked(numbers.begin(), numbers.end());
+    vector<vector<int>> pages;
+    for (const auto page : Paginate(numbers, 3))
+    {
+        pages.emplace_back(page.begin(), page.end());
+        ASSERT_EQUAL(page.size(), pages.back().size());
+    }
+    ASSERT(pages == (vector<vector<int>>{{1, 2, 3}, {4, 5, 6}, {7}}));
+    pages.clear();
+    for (const auto page : Paginate(linked, 7))
+    {
+        pages.emplace_back(page.begin(), page.end());
+    }
+    ASSERT(pages == (vector<vector<int>>{{1, 2, 3, 4, 5, 6, 7}}));
+
+    // an empty range has no pages
+    const vector<int> empty;
+    const auto paginator = Paginate(empty, 2);
+    ASSERT(paginator.begin() == paginator.end());
+    ASSERT_THROWS(Paginate(numbers, 0), invalid_argument);
+}
+
+int main()
+{
+    RUN_TEST(TestPagesMakeTheWholeRanking);
+    RUN_TEST(TestPageSizeDividingTheTotal);
+    RUN_TEST(TestTiesAtPageBoundaries);
+    RUN_TEST(TestPaginator);
+    return 0;
+}
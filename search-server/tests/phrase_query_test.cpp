@@ -0,0 +1,152 @@
+#include "../search_server.h"
+#include "test_framework.h"
+#include <cmath>
+#include <execution>
+#include <set>
+
+using namespace std;
+
+namespace
+{
+    set<int> FindIds(const SearchServer &search_server, const string &query)
+    {
+        set<int> ids;
+        for (const auto &document : search_server.FindTopDocuments(query))
+        {
+            ids.insert(document.id);
+        }
+        return ids;
+    }
+
+    double FindRelevance(const SearchServer &search_server, const string &query, int document_id)
+    {
+        for (const auto &document : search_server.FindTopDocuments(query))
+        {
+            if (document.id == document_id)
+            {
+                return document.relevance;
+            }
+        }
+        return -1.0;
+    }
+
+    void AddCorpus(SearchServer &search_server)
+    {
+        search_server.AddDocument(1, "big curly cat"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(2, "cat curly big"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(3, "big nasty curly cat"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(4, "curly cat and big"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(5, "big and curly cat"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(6, "dog with hat"s, DocumentStatus::ACTUAL, {1});
+    }
+}
+
+void TestPhraseNeedsOrderAndAdjacency()
+{
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server);
+    search_server.EnablePositionalIndex();
+
+    // exact order only: the reordered document 2 and the gapped documents 3 and 5 do not match
+    ASSERT(FindIds(search_server, "\"big curly cat\""s) == set<int>{1});
+    ASSERT(FindIds(search_server, "\"curly cat\""s) == (set<int>{1, 3, 4, 5}));
+    ASSERT(FindIds(search_server, "\"cat curly\""s) == set<int>{2});
+    // a stop word in the phrase stands for any one token of the document, as it is not indexed
+    ASSERT(FindIds(search_server, "\"big and curly cat\""s) == (set<int>{3, 5}));
+    ASSERT(FindIds(search_server, "\"cat and big\""s) == (set<int>{2, 4}));
+    // a phrase and a minus-word, a phrase with a one-word phrase
+    ASSERT(FindIds(search_server, "\"curly cat\" -nasty"s) == (set<int>{1, 4, 5}));
+    ASSERT(FindIds(search_server, "\"curly cat\" \"big\""s) == (set<int>{1, 3, 4, 5}));
+    ASSERT(FindIds(search_server, "\"cat big\""s).empty());
+
+    ASSERT_THROWS(search_server.FindTopDocuments("\"curly cat"s), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("\"curly -cat\""s), invalid_argument);
+}
+
+void TestPhraseInMatchDocument()
+{
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server);
+    search_server.EnablePositionalIndex();
+    const auto words = [](const tuple<vector<string_view>, DocumentStatus> &match)
+    {
+        return vector<string>(get<0>(match).begin(), get<0>(match).end());
+    };
+    for (const auto &[document_id, expected] : vector<pair<int, vector<string>>>{{1, {"big"s, "cat"s, "curly"s}}, {2, {}}, {3, {}}, {4, {}}, {5, {}}})
+    {
+        const auto query = "\"big curly cat\""s;
+        const auto hint = to_string(document_id);
+        ASSERT_HINT(words(search_server.MatchDocument(query, document_id)) == expected, hint);
+        ASSERT_HINT(words(search_server.MatchDocument(execution::seq, query, document_id)) == expected, hint);
+        ASSERT_HINT(words(search_server.MatchDocument(execution::par, query, document_id)) == expected, hint);
+    }
+    // the plus-word outside the phrase is matched as usual once the phrase holds
+    ASSERT(words(search_server.MatchDocument(execution::par, "\"curly cat\" big dog"s, 4)) == (vector<string>{"big"s, "cat"s, "curly"s}));
+    ASSERT(words(search_server.MatchDocument(execution::par, "\"cat curly\" big"s, 4)).empty());
+}
+
+void TestPhraseNeedsPositionalIndex()
+{
+    SearchServer search_server("and with"s);
+    AddCorpus(search_server);
+    ASSERT_THROWS(search_server.FindTopDocuments("\"curly cat\""s), logic_error);
+    ASSERT_THROWS(search_server.FindTopDocuments(execution::par, "\"curly cat\""s), logic_error);
+    ASSERT_THROWS(search_server.MatchDocument("\"curly cat\""s, 1), logic_error);
+    ASSERT_THROWS(search_server.MatchDocument(execution::par, "\"curly cat\""s, 1), logic_error);
+    // a one-word phrase is a plain word and needs no positions
+    ASSERT(FindIds(search_server, "\"nasty\""s) == set<int>{3});
+    search_server.EnablePositionalIndex();
+    ASSERT(FindIds(search_server, "\"curly cat\""s) == (set<int>{1, 3, 4, 5}));
+}
+
+void TestProximityBoostOrdersRequiredWords()
+{
+    // the same words in every candidate, only their distance differs; the other documents give the words an IDF > 0
+    SearchServer plain(""s);
+    SearchServer positional(""s);
+    for (auto *search_server : {&plain, &positional})
+    {
+        search_server->AddDocument(1, "curly x y cat"s, DocumentStatus::ACTUAL, {1});
+        search_server->AddDocument(2, "curly cat x y"s, DocumentStatus::ACTUAL, {1});
+        search_server->AddDocument(3, "curly x cat y"s, DocumentStatus::ACTUAL, {1});
+        search_server->AddDocument(4, "cat y x curly"s, DocumentStatus::ACTUAL, {1});
+        for (int document_id = 10; document_id < 20; ++document_id)
+        {
+            search_server->AddDocument(document_id, "dog hat x"s, DocumentStatus::ACTUAL, {1});
+        }
+    }
+    positional.EnablePositionalIndex();
+
+    const auto query = "+curly +cat"s;
+    const auto found = positional.FindTopDocuments(query);
+    ASSERT_EQUAL(found.size(), 4u);
+    ASSERT_EQUAL(found[0].id, 2);
+    ASSERT_EQUAL(found[1].id, 3);
+    // equal spans of 3, the tie is broken by id
+    ASSERT_EQUAL(found[2].id, 1);
+    ASSERT_EQUAL(found[3].id, 4);
+    ASSERT(found[0].relevance > found[1].relevance);
+    ASSERT(found[1].relevance > found[2].relevance);
+
+    // adjacent words get exactly 1 + PROXIMITY_WEIGHT, a span of d gets 1 + PROXIMITY_WEIGHT / d
+    const double base = FindRelevance(plain, query, 2);
+    ASSERT(base > 0.0);
+    for (const auto &[document_id, span] : vector<pair<int, int>>{{2, 1}, {3, 2}, {1, 3}, {4, 3}})
+    {
+        ASSERT_EQUAL(FindRelevance(plain, query, document_id), base);
+        ASSERT_HINT(abs(FindRelevance(positional, query, document_id) - base * (1.0 + PROXIMITY_WEIGHT / span)) < 1e-12, to_string(document_id));
+    }
+    // a word required twice does not raise the boost past its maximum
+    ASSERT(abs(FindRelevance(positional, "+curly +cat +cat"s, 2) - base * (1.0 + PROXIMITY_WEIGHT)) < 1e-12);
+    // only required words are boosted, and plain plus-words rank as without positions
+    ASSERT_EQUAL(FindRelevance(positional, "curly cat"s, 1), FindRelevance(plain, "curly cat"s, 1));
+}
+
+int main()
+{
+    RUN_TEST(TestPhraseNeedsOrderAndAdjacency);
+    RUN_TEST(TestPhraseInMatchDocument);
+    RUN_TEST(TestPhraseNeedsPositionalIndex);
+    RUN_TEST(TestProximityBoostOrdersRequiredWords);
+    return 0;
+}
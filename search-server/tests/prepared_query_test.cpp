@@ -0,0 +1,113 @@
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <random>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+    const vector<string> QUERIES = {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s, "ca* -dog"s};
+
+    const auto ANY_DOCUMENT = [](int, DocumentStatus, int)
+    {
+        return true;
+    };
+}
+
+void TestPreparedQueryFollowsIndexChanges()
+{
+    mt19937 generator(7);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    const auto texts = GenerateTexts(600, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < 300; ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+        reference.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    vector<SearchServer::PreparedQuery> prepared_queries;
+    for (const auto &query : QUERIES)
+    {
+        prepared_queries.push_back(search_server.PrepareQuery(query));
+    }
+
+    for (int round = 0; round < 6; ++round)
+    {
+        // additions and removals alternate, each one changes the postings and the minus-word exclusions
+        for (int i = 0; i < 50; ++i)
+        {
+            const int document_id = 300 + round * 50 + i;
+            if (round % 2 == 0)
+            {
+                search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+                reference.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+            }
+            else
+            {
+                search_server.RemoveDocument(document_id - 50);
+                reference.RemoveDocument(document_id - 50);
+            }
+        }
+        for (size_t i = 0; i < QUERIES.size(); ++i)
+        {
+            const auto &prepared_query = prepared_queries[i];
+            const auto hint = QUERIES[i] + " "s + to_string(round);
+            ASSERT_HINT(!search_server.IsPreparedQueryCurrent(prepared_query), hint);
+            const auto expected = reference.FindTopDocuments(QUERIES[i], ANY_DOCUMENT);
+            // the first run binds the query again, the later ones and the copies reuse that binding
+            AssertSameRanking(search_server.FindTopDocuments(prepared_query), expected, hint);
+            ASSERT_HINT(search_server.IsPreparedQueryCurrent(prepared_query), hint);
+            const auto copy = prepared_query;
+            ASSERT_HINT(search_server.IsPreparedQueryCurrent(copy), hint);
+            AssertSameRanking(search_server.FindTopDocuments(execution::par, copy, DocumentStatus::ACTUAL), expected, hint);
+            AssertSameRanking(search_server.FindTopDocuments(prepared_query, ANY_DOCUMENT), expected, hint);
+            ASSERT_EQUAL_HINT(copy.GetRawQuery(), QUERIES[i], hint);
+        }
+    }
+}
+
+void TestConcurrentRunsBindAgain()
+{
+    mt19937 generator(8);
+    SearchServer search_server(STOP_WORDS);
+    const auto texts = GenerateTexts(1000, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {1});
+    }
+    const auto prepared_query = search_server.PrepareQuery("curly cat -dog"s);
+    search_server.RemoveDocument(0);
+    const auto expected = search_server.FindTopDocuments("curly cat -dog"s);
+
+    // the runs race to bind the stale query; each sees a complete binding and the result is the same
+    vector<vector<Document>> results(8);
+    vector<thread> threads;
+    for (auto &result : results)
+    {
+        threads.emplace_back([&]
+                             { result = search_server.FindTopDocuments(prepared_query); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    for (const auto &result : results)
+    {
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+        }
+    }
+    ASSERT(search_server.IsPreparedQueryCurrent(prepared_query));
+}
+
+int main()
+{
+    RUN_TEST(TestPreparedQueryFollowsIndexChanges);
+    RUN_TEST(TestConcurrentRunsBindAgain);
+    return 0;
+}
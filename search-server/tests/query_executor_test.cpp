@@ -0,0 +1,261 @@
+#include "../query_executor.h"
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <limits>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    // Keeps every worker of an executor busy until Open, so the tasks submitted meanwhile stay queued
+    class Gate
+    {
+    public:
+        Gate(QueryExecutor &executor)
+        {
+            for (size_t i = 0; i < executor.GetThreadCount(); ++i)
+            {
+                blocked_.push_back(executor.Submit([this]
+                                                   { WaitOpen(); },
+                                                   {numeric_limits<int>::max(), nullopt, nullptr}));
+            }
+            unique_lock lock(mutex_);
+            started_changed_.wait(lock, [this, &executor]
+                                  { return started_ == executor.GetThreadCount(); });
+        }
+
+        ~Gate()
+        {
+            Open();
+        }
+
+        void Open()
+        {
+            {
+                lock_guard guard(mutex_);
+                open_ = true;
+            }
+            opened_.notify_all();
+            for (auto &blocked : blocked_)
+            {
+                if (blocked.valid())
+                {
+                    blocked.get();
+                }
+            }
+        }
+
+    private:
+        mutex mutex_;
+        condition_variable opened_;
+        condition_variable started_changed_;
+        size_t started_ = 0;
+        bool open_ = false;
+        vector<future<void>> blocked_;
+
+        void WaitOpen()
+        {
+            unique_lock lock(mutex_);
+            ++started_;
+            started_changed_.notify_all();
+            opened_.wait(lock, [this]
+                         { return open_; });
+        }
+    };
+
+    template <typename Result>
+    bool IsRejected(future<Result> &result)
+    {
+        try
+        {
+            result.get();
+        }
+        catch (const QueryRejected &)
+        {
+            return true;
+        }
+        return false;
+    }
+}
+
+void TestPriorityIsGlobal()
+{
+    const size_t thread_count = 4;
+    QueryExecutor executor(thread_count);
+    mutex order_mutex;
+    vector<int> started_priorities;
+    vector<future<void>> results;
+    {
+        Gate gate(executor);
+        mt19937 generator(1);
+        for (int i = 0; i < 200; ++i)
+        {
+            const int priority = static_cast<int>(generator() % 50);
+            results.push_back(executor.Submit([&, priority]
+                                              {
+                lock_guard guard(order_mutex);
+                started_priorities.push_back(priority); },
+                                              {priority, nullopt, nullptr}));
+        }
+        ASSERT_EQUAL(executor.GetQueueSize(), 200u);
+    }
+    for (auto &result : results)
+    {
+        result.get();
+    }
+    // the workers take the tasks in priority order; only the ones taken at about the same time
+    // may record their start out of order
+    ASSERT_EQUAL(started_priorities.size(), 200u);
+    for (size_t i = 0; i < started_priorities.size(); ++i)
+    {
+        for (size_t j = i + thread_count; j < started_priorities.size(); ++j)
+        {
+            ASSERT_HINT(started_priorities[i] >= started_priorities[j], to_string(i) + " "s + to_string(j));
+        }
+    }
+    ASSERT_EQUAL(executor.GetQueueSize(), 0u);
+}
+
+void TestFullQueueRejects()
+{
+    QueryExecutor executor(1, 2);
+    vector<future<int>> results;
+    {
+        Gate gate(executor);
+        for (int i = 0; i < 5; ++i)
+        {
+            results.push_back(executor.Submit([i]
+                                              { return i; },
+                                              {}));
+        }
+        ASSERT_EQUAL(executor.GetQueueSize(), 2u);
+        for (int i = 2; i < 5; ++i)
+        {
+            ASSERT(IsRejected(results[i]));
+        }
+    }
+    ASSERT_EQUAL(results[0].get(), 0);
+    ASSERT_EQUAL(results[1].get(), 1);
+    // the rejections gave their places back
+    ASSERT_EQUAL(executor.GetQueueSize(), 0u);
+    auto accepted = executor.Submit([]
+                                    { return 7; },
+                                    {});
+    ASSERT_EQUAL(accepted.get(), 7);
+}
+
+void TestCancelledAndLateQueriesDoNotRun()
+{
+    QueryExecutor executor(2);
+    atomic<int> runs = 0;
+    const auto count_run = [&runs]
+    {
+        ++runs;
+    };
+    auto cancelled = make_shared<atomic<bool>>(false);
+    auto kept = make_shared<atomic<bool>>(false);
+    vector<future<void>> rejected;
+    vector<future<void>> accepted;
+    {
+        Gate gate(executor);
+        rejected.push_back(executor.Submit(count_run, {0, nullopt, cancelled}));
+        rejected.push_back(executor.Submit(count_run, {0, chrono::steady_clock::now() - chrono::milliseconds(1), nullptr}));
+        accepted.push_back(executor.Submit(count_run, {0, nullopt, kept}));
+        accepted.push_back(executor.Submit(count_run, {0, chrono::steady_clock::now() + chrono::hours(1), nullptr}));
+        *cancelled = true;
+    }
+    for (auto &result : rejected)
+    {
+        ASSERT(IsRejected(result));
+    }
+    for (auto &result : accepted)
+    {
+        result.get();
+    }
+    ASSERT_EQUAL(runs.load(), 2);
+
+    // an exception of the query itself reaches the future unchanged
+    auto failing = executor.Submit([]() -> int
+                                   { throw invalid_argument("bad query"s); },
+                                   {});
+    ASSERT_THROWS(failing.get(), invalid_argument);
+}
+
+void TestStoppedExecutorRejectsQueued()
+{
+    auto executor = make_unique<QueryExecutor>(1);
+    vector<future<int>> results;
+    Gate gate(*executor);
+    for (int i = 0; i < 3; ++i)
+    {
+        results.push_back(executor->Submit([i]
+                                           { return i; },
+                                           {}));
+    }
+    // the worker is released only once the destructor waits for it, so the queued tasks never start
+    thread opener([&gate]
+                  {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        gate.Open(); });
+    executor.reset();
+    opener.join();
+    for (auto &result : results)
+    {
+        ASSERT(IsRejected(result));
+    }
+}
+
+void TestAsyncSearch()
+{
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    const auto texts = GenerateTexts(500, VOCABULARY, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], static_cast<DocumentStatus>(document_id % 2), {document_id % 7});
+    }
+    ASSERT_THROWS(search_server.FindTopDocumentsAsync("cat"s), logic_error);
+    search_server.ConfigureExecutor(3, 100);
+
+    vector<pair<string, future<vector<Document>>>> results;
+    for (const auto &query : {"cat"s, "curly cat -dog"s, "+nasty tail"s, "big eyes -hat"s})
+    {
+        results.emplace_back(query, search_server.FindTopDocumentsAsync(query, DocumentStatus::IRRELEVANT));
+    }
+    const auto is_even = [](int document_id, DocumentStatus, int)
+    {
+        return document_id % 2 == 0;
+    };
+    auto by_predicate = search_server.FindTopDocumentsAsync("cat hat"s, is_even);
+    for (auto &[query, result] : results)
+    {
+        const auto found = result.get();
+        const auto expected = search_server.FindTopDocuments(query, DocumentStatus::IRRELEVANT);
+        ASSERT_EQUAL_HINT(found.size(), expected.size(), query);
+        for (size_t i = 0; i < found.size(); ++i)
+        {
+            ASSERT_EQUAL_HINT(found[i].id, expected[i].id, query);
+        }
+    }
+    ASSERT_EQUAL(by_predicate.get().size(), search_server.FindTopDocuments("cat hat"s, is_even).size());
+
+    auto cancelled = make_shared<atomic<bool>>(true);
+    auto dropped = search_server.FindTopDocumentsAsync("cat"s, DocumentStatus::ACTUAL, {0, nullopt, cancelled});
+    ASSERT(IsRejected(dropped));
+    auto late = search_server.FindTopDocumentsAsync("cat"s, DocumentStatus::ACTUAL, {0, chrono::steady_clock::now() - chrono::seconds(1), nullptr});
+    ASSERT(IsRejected(late));
+    auto invalid = search_server.FindTopDocumentsAsync("cat --dog"s);
+    ASSERT_THROWS(invalid.get(), invalid_argument);
+}
+
+int main()
+{
+    RUN_TEST(TestPriorityIsGlobal);
+    RUN_TEST(TestFullQueueRejects);
+    RUN_TEST(TestCancelledAndLateQueriesDoNotRun);
+    RUN_TEST(TestStoppedExecutorRejectsQueued);
+    RUN_TEST(TestAsyncSearch);
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include "../query_server.h"
+#include "test_framework.h"
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    // Runs the server loop in a thread for the lifetime of the object
+    class ServerRunner
+    {
+    public:
+        ServerRunner(SearchServer &search_server, size_t max_batch_size)
+            : server_(search_server, max_batch_size),
+              path_((filesystem::temp_directory_path() / ("query_server_test_"s + to_string(getpid()))).string())
+        {
+            server_.ListenUnix(path_);
+            thread_ = thread([this]
+                             { server_.Run(); });
+        }
+
+        ~ServerRunner()
+        {
+            server_.Stop();
+            thread_.join();
+        }
+
+        const string &GetPath() const
+        {
+            return path_;
+        }
+
+    private:
+        QueryServer server_;
+        string path_;
+        thread thread_;
+    };
+
+    class Client
+    {
+    public:
+        explicit Client(const string &path)
+        {
+            fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            if (fd_ < 0 || connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+            {
+                throw system_error(errno, generic_category(), "connect");
+            }
+        }
+
+        ~Client()
+        {
+            close(fd_);
+        }
+
+        Client(const Client &) = delete;
+        Client &operator=(const Client &) = delete;
+
+        void Send(const string &data)
+        {
+            size_t sent_total = 0;
+            while (sent_total < data.size())
+            {
+                const ssize_t sent = send(fd_, data.data() + sent_total, data.size() - sent_total, MSG_NOSIGNAL);
+                if (sent <= 0)
+                {
+                    throw system_error(errno, generic_category(), "send");
+                }
+                sent_total += sent;
+            }
+        }
+
+        string ReadLine()
+        {
+            size_t line_end = input_.find('\n');
+            while (line_end == string::npos)
+            {
+                char buffer[4096];
+                const ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+                if (received <= 0)
+                {
+                    throw runtime_error("Connection closed"s);
+                }
+                input_.append(buffer, received);
+                line_end = input_.find('\n');
+            }
+            auto line = input_.substr(0, line_end);
+            input_.erase(0, line_end + 1);
+            return line;
+        }
+
+    private:
+        int fd_ = -1;
+        string input_;
+    };
+
+    bool StartsWith(const string &line, const string &prefix)
+    {
+        return line.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+void TestRequestsAreAnswered()
+{
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(2, "black dog"s, DocumentStatus::BANNED, {1});
+    const auto expected = FormatDocuments(search_server.FindTopDocuments("cat"s));
+    ServerRunner runner(search_server, 256);
+    Client client(runner.GetPath());
+
+    client.Send("FIND cat\n"s);
+    ASSERT_EQUAL(client.ReadLine(), expected);
+    client.Send("MATCH 2 black cat\n"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK BANNED black"s);
+    client.Send("ADD 3 ACTUAL 4,6 cat and dog\r\n"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    client.Send("MATCH 3 cat dog\n"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK ACTUAL cat dog"s);
+    client.Send("REMOVE 3\n"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    client.Send("FIND cat\n"s);
+    ASSERT_EQUAL(client.ReadLine(), expected);
+}
+
+void TestPartialLinesAreJoined()
+{
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {5});
+    ServerRunner runner(search_server, 256);
+    Client client(runner.GetPath());
+
+    // nothing is answered until the line is complete
+    client.Send("FIND wh"s);
+    this_thread::sleep_for(chrono::milliseconds(50));
+    client.Send("ite\nMATCH 1 "s);
+    ASSERT_EQUAL(client.ReadLine(), FormatDocuments(search_server.FindTopDocuments("white"s)));
+    this_thread::sleep_for(chrono::milliseconds(50));
+    client.Send("cat\n"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK ACTUAL cat"s);
+}
+
+void TestErrorsAreAnsweredInPlace()
+{
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {5});
+    ServerRunner runner(search_server, 256);
+    Client client(runner.GetPath());
+
+    // one pipelined write: a failing request answers ERR and the others still get their responses in order
+    const auto found = FormatDocuments(search_server.FindTopDocuments("cat"s));
+    client.Send("FIND cat -\nFIND cat\nJUMP\nADD x ACTUAL 1 cat\nADD 1 ACTUAL 1 cat\nADD 2 SLEEPY 1 cat\nMATCH 9 cat\nREMOVE\nFIND cat\n"s);
+    ASSERT(StartsWith(client.ReadLine(), "ERR "s));
+    ASSERT_EQUAL(client.ReadLine(), found);
+    for (int i = 0; i < 6; ++i)
+    {
+        const auto line = client.ReadLine();
+        ASSERT_HINT(StartsWith(line, "ERR "s), line);
+    }
+    ASSERT_EQUAL(client.ReadLine(), found);
+}
+
+void TestMutationsSplitBatches()
+{
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {5});
+    ServerRunner runner(search_server, 2);
+    Client client(runner.GetPath());
+
+    // the queries before a mutation must not see it, the ones after it must;
+    // MATCH is not a barrier, and five FINDs in a row span several batches of two
+    string requests = "FIND parrot\nFIND parrot\nMATCH 1 cat\nFIND parrot\nADD 3 ACTUAL 7 green parrot\n"s;
+    for (int i = 0; i < 5; ++i)
+    {
+        requests += "FIND parrot\n"s;
+    }
+    requests += "REMOVE 3\nFIND parrot\n"s;
+    client.Send(requests);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    }
+    ASSERT_EQUAL(client.ReadLine(), "OK ACTUAL cat"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT(StartsWith(client.ReadLine(), "OK 3 "s));
+    }
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+    ASSERT_EQUAL(client.ReadLine(), "OK"s);
+}
+
+void TestClientsAreServedTogether()
+{
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < 100; ++document_id)
+    {
+        search_server.AddDocument(document_id, "word"s + to_string(document_id), DocumentStatus::ACTUAL, {1});
+    }
+    ServerRunner runner(search_server, 256);
+    deque<Client> clients;
+    for (int i = 0; i < 8; ++i)
+    {
+        clients.emplace_back(runner.GetPath());
+    }
+    for (size_t i = 0; i < clients.size(); ++i)
+    {
+        string requests;
+        for (int j = 0; j < 50; ++j)
+        {
+            requests += "FIND word"s + to_string((i * 50 + j) % 100) + "\n"s;
+        }
+        clients[i].Send(requests);
+    }
+    for (size_t i = 0; i < clients.size(); ++i)
+    {
+        for (int j = 0; j < 50; ++j)
+        {
+            ASSERT(StartsWith(clients[i].ReadLine(), "OK "s + to_string((i * 50 + j) % 100) + " "s));
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestRequestsAreAnswered);
+    RUN_TEST(TestPartialLinesAreJoined);
+    RUN_TEST(TestErrorsAreAnsweredInPlace);
+    RUN_TEST(TestMutationsSplitBatches);
+    RUN_TEST(TestClientsAreServedTogether);
+    return 0;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "../search_server.h"
+#include "../string_processing.h"
+#include "test_framework.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <vector>
+
+// Brute-force ranking over the raw texts, the yardstick the index structures are checked against.
+// Understands plus-, minus- and +required words and "pre*" wildcards, no correction, no phrases
+class ReferenceSearch
+{
+public:
+    explicit ReferenceSearch(const std::string &stop_words_text)
+    {
+        for (const auto word : SplitIntoWords(stop_words_text))
+        {
+            stop_words_.insert(std::string{word});
+        }
+    }
+
+    void AddDocument(int document_id, const std::string &text, DocumentStatus status, const std::vector<int> &ratings)
+    {
+        Entry entry;
+        for (const auto word : SplitIntoWords(text))
+        {
+            if (stop_words_.count(std::string{word}) == 0)
+            {
+                entry.words.push_back(std::string{word});
+            }
+        }
+        entry.status = status;
+        entry.rating = ratings.empty() ? 0 : std::accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
+        documents_[document_id] = std::move(entry);
+    }
+
+    void RemoveDocument(int document_id)
+    {
+        documents_.erase(document_id);
+    }
+
+    // Every matching document, best first
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const std::string &raw_query, DocumentPredicate document_predicate) const
+    {
+        std::set<std::string> plus_words;
+        std::set<std::string> minus_words;
+        std::set<std::string> required_words;
+        for (const auto word : SplitIntoWords(raw_query))
+        {
+            if (word[0] == '-')
+            {
+                minus_words.insert(std::string{word.substr(1)});
+            }
+            else if (word[0] == '+')
+            {
+                plus_words.insert(std::string{word.substr(1)});
+                required_words.insert(std::string{word.substr(1)});
+            }
+            else if (stop_words_.count(std::string{word}) == 0)
+            {
+                plus_words.insert(std::string{word});
+            }
+        }
+
+        std::map<int, double> document_to_relevance;
+        for (const auto &word : plus_words)
+        {
+            const auto document_freq = std::count_if(documents_.begin(), documents_.end(), [&word](const auto &document)
+                                                     { return CountMatches(document.second.words, word) > 0; });
+            if (document_freq == 0)
+            {
+                continue;
+            }
+            const double inverse_document_freq = std::log(documents_.size() * 1.0 / document_freq);
+            for (const auto &[document_id, entry] : documents_)
+            {
+                const int matches = CountMatches(entry.words, word);
+                if (matches > 0 && document_predicate(document_id, entry.status, entry.rating))
+                {
+                    document_to_relevance[document_id] += matches * 1.0 / entry.words.size() * inverse_document_freq;
+                }
+            }
+        }
+
+        std::vector<Document> matched_documents;
+        for (const auto &[document_id, relevance] : document_to_relevance)
+        {
+            const auto &words = documents_.at(document_id).words;
+            const bool is_excluded = std::any_of(minus_words.begin(), minus_words.end(), [&words](const std::string &word)
+                                                 { return CountMatches(words, word) > 0; }) ||
+                                     std::any_of(required_words.begin(), required_words.end(), [&words](const std::string &word)
+                                                 { return CountMatches(words, word) == 0; });
+            if (!is_excluded)
+            {
+                matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+            }
+        }
+        std::sort(matched_documents.begin(), matched_documents.end(), [](const Document &lhs, const Document &rhs)
+                  { return std::abs(lhs.relevance - rhs.relevance) < DIFF ? lhs.rating > rhs.rating : lhs.relevance > rhs.relevance; });
+        return matched_documents;
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string &raw_query, DocumentPredicate document_predicate) const
+    {
+        auto documents = FindAllDocuments(raw_query, document_predicate);
+        documents.resize(std::min(documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)));
+        return documents;
+    }
+
+private:
+    struct Entry
+    {
+        std::vector<std::string> words;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        int rating = 0;
+    };
+
+    std::set<std::string> stop_words_;
+    std::map<int, Entry> documents_;
+
+    static bool MatchesPattern(const char *pattern, const char *word)
+    {
+        if (*pattern == '\0')
+        {
+            return *word == '\0';
+        }
+        if (*pattern == '*')
+        {
+            return MatchesPattern(pattern + 1, word) || (*word != '\0' && MatchesPattern(pattern, word + 1));
+        }
+        return *word == *pattern && MatchesPattern(pattern + 1, word + 1);
+    }
+
+    static int CountMatches(const std::vector<std::string> &words, const std::string &pattern)
+    {
+        return static_cast<int>(std::count_if(words.begin(), words.end(), [&pattern](const std::string &word)
+                                              { return MatchesPattern(pattern.c_str(), word.c_str()); }));
+    }
+};
+
+// Documents with equal relevance and rating may come in any order, so ids are not compared
+inline void AssertSameRanking(const std::vector<Document> &actual, const std::vector<Document> &expected, const std::string &hint)
+{
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < actual.size(); ++i)
+    {
+        ASSERT_HINT(std::abs(actual[i].relevance - expected[i].relevance) < 1e-9, hint);
+        ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+    }
+}
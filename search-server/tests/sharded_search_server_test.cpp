@@ -0,0 +1,107 @@
+#include "../sharded_search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <execution>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    // The same documents in a single server and spread over four shards
+    void FillBoth(SearchServer &search_server, ShardedSearchServer &sharded_server, int document_count, mt19937 &generator)
+    {
+        for (int document_id = 0; document_id < document_count; ++document_id)
+        {
+            // 200 terms under "pre", more than one wildcard expands to
+            const auto text = "pre"s + to_string(generator() % 200) + " pre"s + to_string(generator() % 200) + " x"s + to_string(generator() % 5);
+            const auto status = static_cast<DocumentStatus>(document_id % 2);
+            const int rating = static_cast<int>(generator() % 10);
+            search_server.AddDocument(document_id, text, status, {rating});
+            sharded_server.AddDocument(document_id, text, status, {rating});
+        }
+    }
+}
+
+void TestShardsRankLikeOneServer()
+{
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    ShardedSearchServer sharded_server(4, STOP_WORDS);
+    FillBoth(search_server, sharded_server, 4000, generator);
+    for (int document_id = 0; document_id < 4000; document_id += 9)
+    {
+        search_server.RemoveDocument(document_id);
+        sharded_server.RemoveDocument(document_id);
+    }
+    ASSERT_EQUAL(sharded_server.GetDocumentCount(), search_server.GetDocumentCount());
+    for (const auto &query : {"pre7"s, "pre12 x1 -x2"s, "+pre3 x4"s, "x0 x1 -pre5"s})
+    {
+        AssertSameRanking(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        AssertSameRanking(sharded_server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED),
+                          search_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+    }
+}
+
+void TestShardsExpandWildcardsGlobally()
+{
+    // each shard alone would keep a different set of the most frequent "pre" terms
+    mt19937 generator(2);
+    SearchServer search_server(STOP_WORDS);
+    ShardedSearchServer sharded_server(4, STOP_WORDS);
+    FillBoth(search_server, sharded_server, 5000, generator);
+    for (const auto &query : {"pre*"s, "+pre* x1"s, "x1 -pre1*"s, "pre1* x2"s, "pre1*"s})
+    {
+        AssertSameRanking(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+        for (int document_id = 1; document_id < 5000; document_id += 7)
+        {
+            const auto [sharded_words, sharded_status] = sharded_server.MatchDocument(query, document_id);
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            ASSERT_HINT(sharded_words == words, query + " "s + to_string(document_id));
+            ASSERT_HINT(sharded_status == status, query + " "s + to_string(document_id));
+        }
+    }
+}
+
+void TestParallelIngest()
+{
+    mt19937 generator(3);
+    SearchServer search_server(STOP_WORDS);
+    ShardedSearchServer sharded_server(4, STOP_WORDS);
+    const auto texts = GenerateTexts(3000, VOCABULARY, 6, generator);
+    vector<ShardedSearchServer::NewDocument> batch;
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        const auto status = static_cast<DocumentStatus>(document_id % 2);
+        search_server.AddDocument(document_id, texts[document_id], status, {document_id % 9});
+        batch.push_back({document_id, texts[document_id], status, {document_id % 9}});
+    }
+    sharded_server.AddDocuments(execution::par, batch);
+    ASSERT_EQUAL(sharded_server.GetDocumentCount(), search_server.GetDocumentCount());
+    for (const auto &query : {"cat"s, "curly cat -dog"s, "+nasty tail"s, "ca* -hat"s})
+    {
+        AssertSameRanking(sharded_server.FindTopDocuments(query), search_server.FindTopDocuments(query), query);
+    }
+
+    // a failing document is reported after the other shards are filled, the rest of its shard is not added
+    ShardedSearchServer failing(4, STOP_WORDS);
+    failing.AddDocument(5, "cat"s, DocumentStatus::ACTUAL, {1});
+    vector<ShardedSearchServer::NewDocument> with_duplicate;
+    for (int document_id = 0; document_id < 100; ++document_id)
+    {
+        with_duplicate.push_back({document_id, texts[document_id], DocumentStatus::ACTUAL, {1}});
+    }
+    ASSERT_THROWS(failing.AddDocuments(execution::par, with_duplicate), invalid_argument);
+    ASSERT(failing.GetDocumentCount() > 50);
+    ASSERT(failing.GetDocumentCount() < 100);
+    ASSERT_THROWS(failing.AddDocuments(execution::par, {{-1, "cat"s, DocumentStatus::ACTUAL, {1}}}), invalid_argument);
+}
+
+int main()
+{
+    RUN_TEST(TestShardsRankLikeOneServer);
+    RUN_TEST(TestShardsExpandWildcardsGlobally);
+    RUN_TEST(TestParallelIngest);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <cmath>
+#include <map>
+#include <random>
+
+using namespace std;
+
+void TestStandingQueriesScoreLikeSearch()
+{
+    mt19937 generator(11);
+    SearchServer search_server(STOP_WORDS);
+    for (const auto &text : GenerateTexts(500, VOCABULARY, 6, generator))
+    {
+        search_server.AddDocument(search_server.GetDocumentCount(), text, DocumentStatus::ACTUAL, {1});
+    }
+    search_server.EnablePositionalIndex();
+
+    const vector<string> queries = {"cat"s, "curly cat -dog"s, "+cat tail"s, "+cat +tail -eyes big"s, "nasty hat"s, "+zzz cat"s,
+                                    "\"big cat\""s, "+hat +eyes"s};
+    const auto status_of = [](size_t query_index)
+    {
+        return query_index % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+    };
+    map<pair<int, int>, double> notified;
+    const auto record = [&notified](int query_id, const Document &document)
+    {
+        notified[{query_id, document.id}] = document.relevance;
+    };
+    vector<int> query_ids;
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        query_ids.push_back(search_server.AddStandingQuery(queries[i], status_of(i), record));
+    }
+    for (const auto &invalid_query : {"c*t"s, "-cat"s, ""s})
+    {
+        ASSERT_THROWS(search_server.AddStandingQuery(invalid_query, record), invalid_argument);
+    }
+    // a callback may remove its own query
+    int removed_query_id = -1;
+    const int dog_query_id = search_server.AddStandingQuery("dog"s, [&](int query_id, const Document &)
+                                                            {
+                                                                search_server.RemoveStandingQuery(query_id);
+                                                                removed_query_id = query_id;
+                                                            });
+
+    for (int document_id = 1000; document_id < 2500; ++document_id)
+    {
+        const auto text = GenerateTexts(1, VOCABULARY, 6, generator).front();
+        const auto status = static_cast<DocumentStatus>(generator() % 2);
+        search_server.AddDocument(document_id, text, status, {static_cast<int>(generator() % 10)});
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            const auto hint = queries[i] + " "s + to_string(document_id);
+            // the relevance the callback saw is the one a search right after the addition gives
+            const auto found = search_server.FindTopDocuments(queries[i], [document_id, status = status_of(i)](int id, DocumentStatus document_status, int)
+                                                              { return id == document_id && document_status == status; });
+            const auto notification = notified.find({query_ids[i], document_id});
+            ASSERT_EQUAL_HINT(notification != notified.end(), !found.empty(), hint);
+            if (!found.empty())
+            {
+                ASSERT_HINT(abs(notification->second - found.front().relevance) < 1e-9, hint);
+            }
+        }
+    }
+    ASSERT_EQUAL(removed_query_id, dog_query_id);
+
+    search_server.RemoveStandingQuery(query_ids[0]);
+    search_server.AddDocument(5000, "cat"s, DocumentStatus::BANNED, {1});
+    ASSERT(notified.count({query_ids[0], 5000}) == 0);
+}
+
+void TestStandingQueriesAreNotCorrected()
+{
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "iphone case"s, DocumentStatus::ACTUAL, {1});
+    search_server.EnableFuzzySearch();
+    // with correction "iphone15" would turn into "iphone" and fire on every iphone document
+    vector<int> notified;
+    search_server.AddStandingQuery("iphone15"s, [&notified](int, const Document &document)
+                                   { notified.push_back(document.id); });
+    search_server.AddDocument(2, "iphone charger"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(notified.empty());
+    search_server.AddDocument(3, "new iphone15"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(notified == vector<int>{3});
+}
+
+int main()
+{
+    RUN_TEST(TestStandingQueriesScoreLikeSearch);
+    RUN_TEST(TestStandingQueriesAreNotCorrected);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "../term_dictionary.h"
+#include "test_framework.h"
+#include <algorithm>
+#include <map>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+    vector<pair<size_t, string>> FindFrequentTermsBruteForce(const map<string, size_t> &document_freqs, string_view pattern, size_t limit)
+    {
+        vector<pair<size_t, string>> terms;
+        for (const auto &[term, document_freq] : document_freqs)
+        {
+            if (document_freq > 0 && MatchesWildcard(pattern, term))
+            {
+                terms.emplace_back(document_freq, term);
+            }
+        }
+        sort(terms.begin(), terms.end(), [](const auto &lhs, const auto &rhs)
+             { return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second); });
+        terms.resize(min(terms.size(), limit));
+        return terms;
+    }
+
+    void AssertSameTerms(const TermDictionary &dictionary, const map<string, size_t> &document_freqs, const string &hint)
+    {
+        for (const auto &pattern : {"a*"s, "ab*"s, "abc*"s, "*bca"s, "*cab*"s, "a*c"s, "*abc*ba*"s, "b*ac*c"s, "zz*"s, "*zzz"s})
+        {
+            const auto pattern_hint = hint + " "s + pattern;
+            for (const size_t limit : {size_t{1}, size_t{7}, size_t{64}, size_t{100000}})
+            {
+                ASSERT_HINT(dictionary.FindFrequentTerms(pattern, limit) == FindFrequentTermsBruteForce(document_freqs, pattern, limit),
+                            pattern_hint + " "s + to_string(limit));
+            }
+            auto expected = FindFrequentTermsBruteForce(document_freqs, pattern, document_freqs.size());
+            for (const size_t max_count : {expected.size(), expected.size() + 1})
+            {
+                auto all = dictionary.FindAllTerms(pattern, max_count);
+                ASSERT_HINT(all.has_value(), pattern_hint);
+                sort(all->begin(), all->end());
+                vector<string> expected_terms;
+                for (const auto &[_, term] : expected)
+                {
+                    expected_terms.push_back(term);
+                }
+                sort(expected_terms.begin(), expected_terms.end());
+                ASSERT_HINT(*all == expected_terms, pattern_hint);
+            }
+            if (!expected.empty())
+            {
+                ASSERT_HINT(!dictionary.FindAllTerms(pattern, expected.size() - 1), pattern_hint);
+            }
+        }
+    }
+}
+
+void TestTermsMatchBruteForce()
+{
+    // words over a small alphabet, so the patterns match many of them and the trigram lists are long
+    mt19937 generator(5);
+    TermDictionary dictionary;
+    map<string, size_t> document_freqs;
+    const auto random_term = [&generator]()
+    {
+        string term(3 + generator() % 6, ' ');
+        for (auto &letter : term)
+        {
+            letter = static_cast<char>('a' + generator() % 3);
+        }
+        return term;
+    };
+    // more new terms than stay pending, so several merges run on the way
+    for (int step = 0; step < 40000; ++step)
+    {
+        const auto term = random_term();
+        if (generator() % 4 == 0 && document_freqs[term] > 0)
+        {
+            dictionary.RemoveDocument(term);
+            --document_freqs[term];
+        }
+        else
+        {
+            dictionary.AddDocument(term);
+            ++document_freqs[term];
+        }
+        if (step % 10000 == 9999)
+        {
+            AssertSameTerms(dictionary, document_freqs, to_string(step));
+        }
+    }
+    // terms taken down to no documents are not found
+    for (auto &[term, document_freq] : document_freqs)
+    {
+        if (term[0] == 'a')
+        {
+            for (; document_freq > 0; --document_freq)
+            {
+                dictionary.RemoveDocument(term);
+            }
+        }
+    }
+    ASSERT(dictionary.FindFrequentTerms("a*"s, 10).empty());
+    AssertSameTerms(dictionary, document_freqs, "removed"s);
+}
+
+void TestMemoryEstimateBoundsGrowth()
+{
+    TermDictionary dictionary;
+    size_t estimate = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        const auto term = "term"s + to_string(i * 7919);
+        estimate += dictionary.EstimateTermMemory(term);
+        dictionary.AddDocument(term);
+        ASSERT_HINT(dictionary.GetMemoryUsage() <= estimate, to_string(i));
+    }
+    ASSERT(dictionary.FindFrequentTerms("term*"s, 10).size() == 10u);
+    ASSERT(!TermDictionary::HasTrigram("*ab"s));
+    ASSERT(!TermDictionary::HasTrigram("*ab*cd"s));
+    ASSERT(TermDictionary::HasTrigram("*abc"s));
+    ASSERT(TermDictionary::HasTrigram("x*abc*"s));
+}
+
+int main()
+{
+    RUN_TEST(TestTermsMatchBruteForce);
+    RUN_TEST(TestMemoryEstimateBoundsGrowth);
+    return 0;
+}
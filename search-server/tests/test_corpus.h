@@ -0,0 +1,26 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+
+// The corpus most tests index: few words, so every query matches many documents and ties are common
+
+inline const std::string STOP_WORDS = "and with";
+
+inline const std::vector<std::string> VOCABULARY = {"cat", "dog", "hat", "tail", "curly", "nasty", "big", "eyes", "and", "with"};
+
+// Texts of 1..max_length words drawn from the vocabulary
+inline std::vector<std::string> GenerateTexts(size_t count, const std::vector<std::string> &vocabulary, size_t max_length, std::mt19937 &generator)
+{
+    using namespace std::string_literals;
+    std::vector<std::string> texts(count);
+    for (auto &text : texts)
+    {
+        const size_t length = 1 + generator() % max_length;
+        for (size_t i = 0; i < length; ++i)
+        {
+            text += vocabulary[generator() % vocabulary.size()] + " "s;
+        }
+    }
+    return texts;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// A failed check prints where it failed and ends the test binary with a non-zero code
+
+template <typename T, typename U>
+void AssertEqualImpl(const T &t, const U &u, const std::string &t_str, const std::string &u_str, const std::string &file,
+                     const std::string &func, unsigned line, const std::string &hint)
+{
+    using namespace std::string_literals;
+    if (t != u)
+    {
+        std::cerr << std::boolalpha;
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        std::cerr << t << " != "s << u << "."s;
+        if (!hint.empty())
+        {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+inline void AssertImpl(bool value, const std::string &expr_str, const std::string &file, const std::string &func, unsigned line,
+                       const std::string &hint)
+{
+    using namespace std::string_literals;
+    if (!value)
+    {
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty())
+        {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc &func, const std::string &test_name)
+{
+    using namespace std::string_literals;
+    func();
+    std::cerr << test_name << " OK"s << std::endl;
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+#define ASSERT_THROWS(expr, exception_type)                                                          \
+    do                                                                                               \
+    {                                                                                                \
+        bool is_thrown = false;                                                                      \
+        try                                                                                          \
+        {                                                                                            \
+            expr;                                                                                    \
+        }                                                                                            \
+        catch (const exception_type &)                                                               \
+        {                                                                                            \
+            is_thrown = true;                                                                        \
+        }                                                                                            \
+        AssertImpl(is_thrown, #expr " throws " #exception_type, __FILE__, __FUNCTION__, __LINE__, ""); \
+    } while (false)
+
+#define RUN_TEST(func) RunTestImpl((func), #func)
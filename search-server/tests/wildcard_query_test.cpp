@@ -0,0 +1,141 @@
+#include "../search_server.h"
+#include "reference_search.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+#include <execution>
+#include <random>
+#include <set>
+
+using namespace std;
+
+void TestWildcardsMatchReference()
+{
+    // fewer terms than MAX_WILDCARD_EXPANSION, so every pattern expands in full
+    const vector<string> vocabulary = {"cat"s, "cats"s, "catalog"s, "car"s, "cart"s, "dog"s, "dots"s, "tail"s, "and"s, "with"s};
+    mt19937 generator(1);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    const auto texts = GenerateTexts(2000, vocabulary, 6, generator);
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id)
+    {
+        search_server.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 10});
+        reference.AddDocument(document_id, texts[document_id], DocumentStatus::ACTUAL, {document_id % 10});
+    }
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); document_id += 6)
+    {
+        search_server.RemoveDocument(document_id);
+        reference.RemoveDocument(document_id);
+    }
+    const auto any_document = [](int, DocumentStatus, int)
+    {
+        return true;
+    };
+    for (const auto &query : {"cat*"s, "ca*t dog"s, "c*t -dog"s, "+cat* +do*"s, "dog -cat*"s, "ca*s*"s, "c*g tail"s, "zz* cat"s, "+zz* cat"s, "d*s"s,
+                              "*cat"s, "*ail dog"s, "dog -*ots"s, "*tal*"s})
+    {
+        const auto expected = reference.FindTopDocuments(query, any_document);
+        AssertSameRanking(search_server.FindTopDocuments(query), expected, query);
+        AssertSameRanking(search_server.FindTopDocuments(execution::par, query), expected, query);
+    }
+    // without a prefix the pattern needs a literal run the trigram index can look up
+    for (const auto &invalid_query : {"*ca"s, "-*"s, "*c*t"s})
+    {
+        ASSERT_THROWS(search_server.FindTopDocuments(invalid_query), invalid_argument);
+    }
+}
+
+void TestCappedExpansionIsSharedByMatching()
+{
+    // 200 terms under "pre": the expansion keeps the MAX_WILDCARD_EXPANSION most frequent ones,
+    // and matching has to agree with search on which documents those are
+    mt19937 generator(2);
+    SearchServer search_server("and"s);
+    const int document_count = 3000;
+    for (int document_id = 0; document_id < document_count; ++document_id)
+    {
+        const auto text = "pre"s + to_string(generator() % 200) + " x"s + to_string(generator() % 5);
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {1});
+    }
+    vector<int> document_ids(document_count);
+    for (int document_id = 0; document_id < document_count; ++document_id)
+    {
+        document_ids[document_id] = document_id;
+    }
+    for (const auto &query : {"pre*"s, "+pre* x1"s, "x1 -pre1*"s, "pre1* x2"s})
+    {
+        const auto page = search_server.FindDocumentsPage(query, nullopt, document_count);
+        set<int> found;
+        for (const auto &document : page.documents)
+        {
+            found.insert(document.id);
+        }
+        ASSERT_HINT(found.size() < static_cast<size_t>(document_count), query);
+        const auto matches = search_server.MatchDocuments(query, document_ids);
+        for (int document_id = 0; document_id < document_count; ++document_id)
+        {
+            const auto hint = query + " "s + to_string(document_id);
+            const bool is_found = found.count(document_id) > 0;
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            const auto [parallel_words, parallel_status] = search_server.MatchDocument(execution::par, query, document_id);
+            ASSERT_EQUAL_HINT(!words.empty(), is_found, hint);
+            ASSERT_EQUAL_HINT(!parallel_words.empty(), is_found, hint);
+            ASSERT_EQUAL_HINT(matches.GetWords(document_id).begin() != matches.GetWords(document_id).end(), is_found, hint);
+        }
+    }
+}
+
+void TestLargeVocabulary()
+{
+    // 3000 terms, enough to leave the pending terms of the dictionary for its front-coded blocks, and more terms
+    // under "pre" than a minus-wildcard expands, so those are matched against the candidates' words
+    mt19937 generator(3);
+    SearchServer search_server(STOP_WORDS);
+    ReferenceSearch reference(STOP_WORDS);
+    vector<string> texts;
+    for (int document_id = 0; document_id < 6000; ++document_id)
+    {
+        const auto &text = texts.emplace_back("pre"s + to_string(generator() % 3000) + " "s + to_string(generator() % 3000) + "post x"s + to_string(generator() % 5));
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 10});
+        reference.AddDocument(document_id, text, DocumentStatus::ACTUAL, {document_id % 10});
+    }
+    for (int document_id = 0; document_id < 6000; document_id += 5)
+    {
+        search_server.RemoveDocument(document_id);
+        reference.RemoveDocument(document_id);
+    }
+    ASSERT(search_server.GetMemoryStats(0).term_dictionary > 0);
+    const auto any_document = [](int, DocumentStatus, int)
+    {
+        return true;
+    };
+    // the expansion of a plus-wildcard is capped, so only minus-wildcards and narrow patterns are compared in full
+    for (const auto &query : {"x1 -pre*"s, "x2 -pre1*"s, "x3 -*post"s, "x4 -*7post"s, "pre12 pre13 -*99post"s, "pre2999 *99post"s, "x0 -*777*"s})
+    {
+        const auto expected = reference.FindTopDocuments(query, any_document);
+        AssertSameRanking(search_server.FindTopDocuments(query), expected, query);
+        AssertSameRanking(search_server.FindTopDocuments(execution::par, query), expected, query);
+    }
+    for (int document_id = 1; document_id < 6000; document_id += 97)
+    {
+        if (document_id % 5 == 0)
+        {
+            continue;
+        }
+        const bool excluded = texts[document_id].rfind("pre1"s, 0) == 0;
+        const auto [words, status] = search_server.MatchDocument("x0 x1 x2 x3 x4 -pre1*"s, document_id);
+        const auto [parallel_words, parallel_status] = search_server.MatchDocument(execution::par, "x0 x1 x2 x3 x4 -pre1*"s, document_id);
+        ASSERT_EQUAL_HINT(words.size(), excluded ? 0u : 1u, to_string(document_id));
+        ASSERT_EQUAL_HINT(parallel_words.size(), words.size(), to_string(document_id));
+    }
+    // a capped expansion keeps the most frequent terms
+    const auto top = search_server.FindTopDocuments("pre*"s);
+    ASSERT_EQUAL(top.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+}
+
+int main()
+{
+    RUN_TEST(TestWildcardsMatchReference);
+    RUN_TEST(TestCappedExpansionIsSharedByMatching);
+    RUN_TEST(TestLargeVocabulary);
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+    int Connect(const string &endpoint)
+    {
+        if (endpoint.find_first_not_of("0123456789"s) == string::npos)
+        {
+            const int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(stoi(endpoint)));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+            {
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, endpoint.c_str(), sizeof(address.sun_path) - 1);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool SendAll(int fd, const string &data)
+    {
+        size_t sent_total = 0;
+        while (sent_total < data.size())
+        {
+            const ssize_t sent = send(fd, data.data() + sent_total, data.size() - sent_total, MSG_NOSIGNAL);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            sent_total += sent;
+        }
+        return true;
+    }
+
+    // One connection keeps up to pipeline_depth requests in flight and records the latency of each
+    void RunClient(const string &endpoint, const vector<string> &queries, size_t first_query, int request_count,
+                   int pipeline_depth, vector<chrono::nanoseconds> &latencies, atomic<int> &errors)
+    {
+        using Clock = chrono::steady_clock;
+        const int fd = Connect(endpoint);
+        if (fd < 0)
+        {
+            errors += request_count;
+            return;
+        }
+        deque<Clock::time_point> in_flight;
+        string input;
+        char buffer[1 << 16];
+        int sent = 0;
+        int received = 0;
+        while (received < request_count)
+        {
+            string batch;
+            while (sent < request_count && static_cast<int>(in_flight.size()) < pipeline_depth)
+            {
+                batch += "FIND "s + queries[(first_query + sent) % queries.size()] + '\n';
+                in_flight.push_back(Clock::now());
+                ++sent;
+            }
+            if (!batch.empty() && !SendAll(fd, batch))
+            {
+                break;
+            }
+            const ssize_t read_size = recv(fd, buffer, sizeof(buffer), 0);
+            if (read_size <= 0)
+            {
+                break;
+            }
+            input.append(buffer, read_size);
+            size_t line_start = 0;
+            for (size_t line_end = input.find('\n'); line_end != string::npos; line_end = input.find('\n', line_start))
+            {
+                if (input.compare(line_start, 3, "ERR"s) == 0)
+                {
+                    ++errors;
+                }
+                latencies.push_back(Clock::now() - in_flight.front());
+                in_flight.pop_front();
+                ++received;
+                line_start = line_end + 1;
+            }
+            input.erase(0, line_start);
+        }
+        errors += request_count - received;
+        close(fd);
+    }
+
+    double Percentile(const vector<chrono::nanoseconds> &sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        const size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        return chrono::duration<double, micro>(sorted[index]).count();
+    }
+}
+
+// load_generator <port | unix socket path> <queries file> [connections] [requests per connection] [pipeline depth]
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: "s << argv[0] << " <port | unix socket path> <queries file> [connections] [requests per connection] [pipeline depth]"s << endl;
+        return 1;
+    }
+    const string endpoint = argv[1];
+    ifstream queries_file(argv[2]);
+    vector<string> queries;
+    for (string line; getline(queries_file, line);)
+    {
+        if (!line.empty())
+        {
+            queries.push_back(line);
+        }
+    }
+    if (queries.empty())
+    {
+        cerr << "No queries in "s << argv[2] << endl;
+        return 1;
+    }
+    const int connections = argc > 3 ? stoi(argv[3]) : 4;
+    const int requests_per_connection = argc > 4 ? stoi(argv[4]) : 10000;
+    const int pipeline_depth = argc > 5 ? stoi(argv[5]) : 16;
+
+    vector<vector<chrono::nanoseconds>> latencies(connections);
+    atomic<int> errors = 0;
+    const auto start = chrono::steady_clock::now();
+    {
+        vector<thread> clients;
+        for (int i = 0; i < connections; ++i)
+        {
+            clients.emplace_back(RunClient, cref(endpoint), cref(queries), static_cast<size_t>(i) * requests_per_connection,
+                                 requests_per_connection, pipeline_depth, ref(latencies[i]), ref(errors));
+        }
+        for (auto &client : clients)
+        {
+            client.join();
+        }
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    vector<chrono::nanoseconds> all_latencies;
+    for (const auto &client_latencies : latencies)
+    {
+        all_latencies.insert(all_latencies.end(), client_latencies.begin(), client_latencies.end());
+    }
+    sort(all_latencies.begin(), all_latencies.end());
+
+    cout << "requests: "s << all_latencies.size() << ", errors: "s << errors << endl;
+    cout << "throughput: "s << all_latencies.size() / elapsed.count() << " req/s"s << endl;
+    cout << "latency us: p50 = "s << Percentile(all_latencies, 0.5)
+         << ", p99 = "s << Percentile(all_latencies, 0.99)
+         << ", p999 = "s << Percentile(all_latencies, 0.999)
+         << ", max = "s << Percentile(all_latencies, 1.0) << endl;
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "../latency_histogram.h"
+#include "../search_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+    struct LoggedQuery
+    {
+        chrono::nanoseconds offset;
+        string text;
+        // empty: any status
+        optional<DocumentStatus> status;
+        optional<pair<int, int>> rating_range;
+    };
+
+    DocumentStatus ParseStatus(const string &name)
+    {
+        if (name == "ACTUAL"s)
+        {
+            return DocumentStatus::ACTUAL;
+        }
+        if (name == "IRRELEVANT"s)
+        {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (name == "BANNED"s)
+        {
+            return DocumentStatus::BANNED;
+        }
+        if (name == "REMOVED"s)
+        {
+            return DocumentStatus::REMOVED;
+        }
+        throw invalid_argument("Unknown status "s + name);
+    }
+
+    // <document_id> <STATUS> <r1,r2,...|-> <text>, the format of the query server's ADD request
+    void LoadCorpus(const string &path, SearchServer &search_server)
+    {
+        ifstream input(path);
+        if (!input)
+        {
+            throw invalid_argument("Cannot open "s + path);
+        }
+        for (string line; getline(input, line);)
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            istringstream fields(line);
+            int document_id = 0;
+            string status;
+            string ratings_field;
+            fields >> document_id >> status >> ratings_field;
+            vector<int> ratings;
+            if (ratings_field != "-"s)
+            {
+                istringstream ratings_stream(ratings_field);
+                for (string rating; getline(ratings_stream, rating, ',');)
+                {
+                    ratings.push_back(stoi(rating));
+                }
+            }
+            string text;
+            getline(fields >> ws, text);
+            search_server.AddDocument(document_id, text, ParseStatus(status), ratings);
+        }
+    }
+
+    // <timestamp ms> <ALL | STATUS | STATUS:MIN_RATING:MAX_RATING> <query>
+    vector<LoggedQuery> LoadQueryLog(const string &path)
+    {
+        ifstream input(path);
+        if (!input)
+        {
+            throw invalid_argument("Cannot open "s + path);
+        }
+        vector<LoggedQuery> queries;
+        for (string line; getline(input, line);)
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            istringstream fields(line);
+            double timestamp_ms = 0;
+            string filter;
+            fields >> timestamp_ms >> filter;
+            LoggedQuery query;
+            query.offset = chrono::nanoseconds(static_cast<int64_t>(timestamp_ms * 1e6));
+            getline(fields >> ws, query.text);
+            if (filter != "ALL"s)
+            {
+                const auto first_colon = filter.find(':');
+                query.status = ParseStatus(filter.substr(0, first_colon));
+                if (first_colon != string::npos)
+                {
+                    const auto second_colon = filter.find(':', first_colon + 1);
+                    query.rating_range = pair{stoi(filter.substr(first_colon + 1, second_colon - first_colon - 1)),
+                                              stoi(filter.substr(second_colon + 1))};
+                }
+            }
+            queries.push_back(move(query));
+        }
+        sort(queries.begin(), queries.end(), [](const LoggedQuery &lhs, const LoggedQuery &rhs)
+             { return lhs.offset < rhs.offset; });
+        if (!queries.empty())
+        {
+            const auto first_offset = queries.front().offset;
+            for (auto &query : queries)
+            {
+                query.offset -= first_offset;
+            }
+        }
+        return queries;
+    }
+
+    template <typename ExecutionPolicy>
+    vector<Document> RunQuery(const SearchServer &search_server, ExecutionPolicy &policy, const LoggedQuery &query)
+    {
+        if (!query.status)
+        {
+            return search_server.FindTopDocuments(policy, query.text, [](int, DocumentStatus, int)
+                                                  { return true; });
+        }
+        if (query.rating_range)
+        {
+            return search_server.FindTopDocuments(policy, query.text, *query.status, query.rating_range->first, query.rating_range->second);
+        }
+        return search_server.FindTopDocuments(policy, query.text, *query.status);
+    }
+
+    vector<Document> RunQuery(const SearchServer &search_server, const string &policy_name, const LoggedQuery &query)
+    {
+        if (policy_name == "par"s)
+        {
+            auto policy = execution::par;
+            return RunQuery(search_server, policy, query);
+        }
+        if (policy_name == "auto"s)
+        {
+            auto policy = automatic_execution;
+            return RunQuery(search_server, policy, query);
+        }
+        auto policy = execution::seq;
+        return RunQuery(search_server, policy, query);
+    }
+
+    // Open loop: every query has a start time fixed in advance, whether or not the previous ones are done.
+    // Response time is measured from that time, so a stall is charged to every query that queued behind it
+    // (coordinated omission correction); service time is measured from the actual start
+    void RunWorker(const SearchServer &search_server, const vector<LoggedQuery> &queries, const vector<chrono::nanoseconds> &schedule,
+                   const string &policy_name, Clock::time_point start, atomic<size_t> &next_query, atomic<int> &errors,
+                   LatencyHistogram &service_times, LatencyHistogram &response_times)
+    {
+        for (size_t index = next_query++; index < schedule.size(); index = next_query++)
+        {
+            const auto intended_start = start + schedule[index];
+            this_thread::sleep_until(intended_start);
+            const auto actual_start = Clock::now();
+            try
+            {
+                RunQuery(search_server, policy_name, queries[index % queries.size()]);
+            }
+            catch (const exception &)
+            {
+                ++errors;
+            }
+            const auto end = Clock::now();
+            service_times.Record(end - actual_start);
+            response_times.Record(end - intended_start);
+        }
+    }
+
+    void PrintSummary(const string &name, const LatencyHistogram &histogram)
+    {
+        cout << name << " us: p50 = "s << histogram.GetPercentile(0.5)
+             << ", p99 = "s << histogram.GetPercentile(0.99)
+             << ", p999 = "s << histogram.GetPercentile(0.999)
+             << ", max = "s << histogram.GetPercentile(1.0) << endl;
+    }
+}
+
+// query_replay <corpus file> <query log> [threads] [seq | par | auto] [rate] [repeat] [stop words]
+// rate is the mean number of queries per second with Poisson arrivals; 0 keeps the recorded timestamps.
+// Exits with 2 when any query failed
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: "s << argv[0] << " <corpus file> <query log> [threads] [seq | par | auto] [rate] [repeat] [stop words]"s << endl;
+        return 1;
+    }
+    const int thread_count = argc > 3 ? stoi(argv[3]) : 4;
+    const string policy_name = argc > 4 ? argv[4] : "seq"s;
+    const double rate = argc > 5 ? stod(argv[5]) : 0.0;
+    const int repeat = argc > 6 ? stoi(argv[6]) : 1;
+    if (policy_name != "seq"s && policy_name != "par"s && policy_name != "auto"s)
+    {
+        cerr << "Unknown policy "s << policy_name << endl;
+        return 1;
+    }
+
+    SearchServer search_server(argc > 7 ? string{argv[7]} : ""s);
+    vector<LoggedQuery> queries;
+    try
+    {
+        LOG_DURATION("index build"s);
+        LoadCorpus(argv[1], search_server);
+        queries = LoadQueryLog(argv[2]);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if (queries.empty())
+    {
+        cerr << "No queries in "s << argv[2] << endl;
+        return 1;
+    }
+
+    vector<chrono::nanoseconds> offsets;
+    for (const auto &query : queries)
+    {
+        offsets.push_back(query.offset);
+    }
+    const auto schedule = BuildReplaySchedule(offsets, rate, repeat);
+    if (policy_name == "auto"s)
+    {
+        // the measurement would otherwise stall the first queries of the replay
+        ExecutionCostModel::Calibrate();
+        cout << "parallel threshold: "s << ExecutionCostModel::Instance().GetParallelThreshold() << " postings"s << endl;
+    }
+
+    vector<LatencyHistogram> service_times(thread_count);
+    vector<LatencyHistogram> response_times(thread_count);
+    atomic<size_t> next_query = 0;
+    atomic<int> errors = 0;
+    const auto start = Clock::now();
+    {
+        vector<thread> workers;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            workers.emplace_back(RunWorker, cref(search_server), cref(queries), cref(schedule), cref(policy_name), start,
+                                 ref(next_query), ref(errors), ref(service_times[i]), ref(response_times[i]));
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+    const chrono::duration<double> elapsed = Clock::now() - start;
+
+    LatencyHistogram service_time;
+    LatencyHistogram response_time;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        service_time.Merge(service_times[i]);
+        response_time.Merge(response_times[i]);
+    }
+
+    const chrono::duration<double> scheduled = schedule.back();
+    cout << "documents: "s << search_server.GetDocumentCount() << ", queries: "s << response_time.GetTotal() << ", errors: "s << errors << endl;
+    cout << "throughput: "s << response_time.GetTotal() / elapsed.count() << " q/s, offered: "s
+         << (scheduled.count() > 0 ? schedule.size() / scheduled.count() : 0.0) << " q/s"s << endl;
+    PrintSummary("service time"s, service_time);
+    PrintSummary("response time"s, response_time);
+    cout << "response time distribution, corrected for coordinated omission:"s << endl;
+    for (const double fraction : {0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 1.0})
+    {
+        cout << "  "s << fraction * 100 << "% <= "s << response_time.GetPercentile(fraction) << " us"s << endl;
+    }
+    // a failed query would be timed too, the numbers are not trusted then
+    return errors > 0 ? 2 : 0;
+}
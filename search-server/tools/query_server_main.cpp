@@ -0,0 +1,54 @@
+#include "../query_server.h"
+#include <csignal>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    QueryServer *running_server = nullptr;
+
+    void HandleSignal(int)
+    {
+        if (running_server != nullptr)
+        {
+            running_server->Stop();
+        }
+    }
+}
+
+// query_server <port | unix socket path> [stop words]
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: "s << argv[0] << " <port | unix socket path> [stop words]"s << endl;
+        return 1;
+    }
+    const string endpoint = argv[1];
+    SearchServer search_server(argc > 2 ? string{argv[2]} : ""s);
+    QueryServer query_server(search_server);
+    try
+    {
+        if (endpoint.find_first_not_of("0123456789"s) == string::npos)
+        {
+            query_server.ListenTcp(static_cast<uint16_t>(stoi(endpoint)));
+        }
+        else
+        {
+            query_server.ListenUnix(endpoint);
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Cannot listen on "s << endpoint << ": "s << e.what() << endl;
+        return 1;
+    }
+
+    running_server = &query_server;
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+    query_server.Run();
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "write_ahead_log.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    void ThrowSystemError(const char *what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    // FNV-1a
+    uint32_t ComputeChecksum(std::string_view data)
+    {
+        uint32_t hash = 2166136261u;
+        for (const char c : data)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    bool WriteAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            const auto written = write(fd, data.data(), data.size());
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(written);
+        }
+        return true;
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string &path)
+    : fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644))
+{
+    if (fd_ < 0)
+    {
+        ThrowSystemError("open");
+    }
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) < 0)
+    {
+        const int error = errno;
+        close(fd_);
+        errno = error;
+        ThrowSystemError("fstat");
+    }
+    size_ = file_stat.st_size;
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+        // the records were never acknowledged
+    }
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::Append(std::string_view record)
+{
+    const uint32_t record_size = record.size();
+    const uint32_t checksum = ComputeChecksum(record);
+    std::lock_guard guard(mutex_);
+    pending_.append(reinterpret_cast<const char *>(&record_size), sizeof(record_size));
+    pending_.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    pending_.append(record);
+    size_ += HEADER_SIZE + record.size();
+    return ++appended_;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence)
+{
+    using namespace std::string_literals;
+    std::unique_lock lock(mutex_);
+    while (durable_ < sequence)
+    {
+        if (failed_)
+        {
+            throw std::runtime_error("Write-ahead log failed earlier, the record is not durable"s);
+        }
+        if (syncing_)
+        {
+            synced_.wait(lock);
+            continue;
+        }
+        // this thread leads: one write and one fsync for everything appended until now
+        syncing_ = true;
+        std::string batch;
+        batch.swap(pending_);
+        const uint64_t batch_end = appended_;
+        lock.unlock();
+        const bool is_written = WriteAll(fd_, batch) && fdatasync(fd_) == 0;
+        const int error = errno;
+        lock.lock();
+        syncing_ = false;
+        synced_.notify_all();
+        if (!is_written)
+        {
+            failed_ = true;
+            throw std::system_error(error, std::generic_category(), "write-ahead log");
+        }
+        durable_ = batch_end;
+    }
+}
+
+void WriteAheadLog::Flush()
+{
+    uint64_t last_sequence = 0;
+    {
+        std::lock_guard guard(mutex_);
+        last_sequence = appended_;
+    }
+    WaitDurable(last_sequence);
+}
+
+uint64_t WriteAheadLog::GetSize() const
+{
+    std::lock_guard guard(mutex_);
+    return size_;
+}
+
+bool WriteAheadLog::HasFailed() const
+{
+    std::lock_guard guard(mutex_);
+    return failed_;
+}
+
+void WriteAheadLog::Replay(const std::string &path, const std::function<void(std::string_view)> &handle_record)
+{
+    std::string data;
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (!input)
+        {
+            return;
+        }
+        data.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+
+    size_t offset = 0;
+    while (data.size() - offset >= HEADER_SIZE)
+    {
+        uint32_t record_size = 0;
+        uint32_t checksum = 0;
+        std::memcpy(&record_size, data.data() + offset, sizeof(record_size));
+        std::memcpy(&checksum, data.data() + offset + sizeof(record_size), sizeof(checksum));
+        if (data.size() - offset - HEADER_SIZE < record_size)
+        {
+            break;
+        }
+        const std::string_view record(data.data() + offset + HEADER_SIZE, record_size);
+        if (ComputeChecksum(record) != checksum)
+        {
+            break;
+        }
+        handle_record(record);
+        offset += HEADER_SIZE + record_size;
+    }
+    if (offset < data.size() && truncate(path.c_str(), offset) < 0)
+    {
+        ThrowSystemError("truncate");
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Append-only file of length-prefixed, checksummed records. Any number of threads may append;
+// a thread in WaitDurable writes and fsyncs the records of every thread waiting at that moment (group commit)
+class WriteAheadLog
+{
+public:
+    explicit WriteAheadLog(const std::string &path);
+
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    // Only buffers the record, returns its sequence number for WaitDurable
+    uint64_t Append(std::string_view record);
+
+    // Returns once the record with this sequence number is on disk
+    void WaitDurable(uint64_t sequence);
+
+    void Flush();
+
+    // File size including the buffered records
+    uint64_t GetSize() const;
+
+    // True once a write or fsync failed; WaitDurable throws from then on
+    bool HasFailed() const;
+
+    // Calls handle_record for every intact record. A torn tail left by a crash in the middle of a write is cut off
+    static void Replay(const std::string &path, const std::function<void(std::string_view)> &handle_record);
+
+private:
+    int fd_;
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    std::string pending_;
+    uint64_t size_ = 0;
+    uint64_t appended_ = 0;
+    uint64_t durable_ = 0;
+    bool syncing_ = false;
+    bool failed_ = false;
+};